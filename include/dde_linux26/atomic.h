@@ -0,0 +1,193 @@
+/*
+ * \brief  Lock-free atomic operations and bit operations
+ * \date   2026-10-18
+ *
+ * The operations are based on the GCC __sync builtins, which compile to
+ * LOCK-prefixed instructions on x86. Bit searches use __builtin_ctzl(),
+ * i.e., bsf/tzcnt. All read-modify-write operations are full memory
+ * barriers.
+ *
+ * The header depends on the compiler only and is shared by DDE Linux 2.6
+ * and the i915 Linux emulation.
+ */
+
+#ifndef _DDE_LINUX26__ATOMIC_H_
+#define _DDE_LINUX26__ATOMIC_H_
+
+enum { DDE_LINUX26_BITS_PER_LONG = sizeof(unsigned long) * 8 };
+
+
+/***********************
+ ** Atomic operations **
+ ***********************/
+
+static inline int dde_linux26_atomic_read(const volatile int *v)
+{
+	return *v;
+}
+
+
+static inline void dde_linux26_atomic_set(volatile int *v, int i)
+{
+	*v = i;
+}
+
+
+/**
+ * Add 'i' to 'v'
+ *
+ * \return  new value of 'v'
+ */
+static inline int dde_linux26_atomic_add_return(int i, volatile int *v)
+{
+	return __sync_add_and_fetch(v, i);
+}
+
+
+static inline int dde_linux26_atomic_sub_return(int i, volatile int *v)
+{
+	return __sync_sub_and_fetch(v, i);
+}
+
+
+/**
+ * Replace 'v' by 'new_val' if it equals 'old_val'
+ *
+ * \return  value of 'v' before the operation
+ */
+static inline int dde_linux26_atomic_cmpxchg(volatile int *v, int old_val, int new_val)
+{
+	return __sync_val_compare_and_swap(v, old_val, new_val);
+}
+
+
+/**
+ * Replace 'v' by 'new_val'
+ *
+ * \return  value of 'v' before the operation
+ */
+static inline int dde_linux26_atomic_xchg(volatile int *v, int new_val)
+{
+	/* compiles to 'xchg', which is a full barrier on x86 */
+	return __sync_lock_test_and_set(v, new_val);
+}
+
+
+/********************
+ ** Bit operations **
+ ********************/
+
+static inline volatile unsigned long *
+dde_linux26_bit_word(int nr, volatile unsigned long *addr)
+{
+	return addr + nr / DDE_LINUX26_BITS_PER_LONG;
+}
+
+
+static inline unsigned long dde_linux26_bit_mask(int nr)
+{
+	return 1UL << (nr % DDE_LINUX26_BITS_PER_LONG);
+}
+
+
+static inline void dde_linux26_set_bit(int nr, volatile unsigned long *addr)
+{
+	__sync_fetch_and_or(dde_linux26_bit_word(nr, addr), dde_linux26_bit_mask(nr));
+}
+
+
+static inline void dde_linux26_clear_bit(int nr, volatile unsigned long *addr)
+{
+	__sync_fetch_and_and(dde_linux26_bit_word(nr, addr), ~dde_linux26_bit_mask(nr));
+}
+
+
+static inline void dde_linux26_change_bit(int nr, volatile unsigned long *addr)
+{
+	__sync_fetch_and_xor(dde_linux26_bit_word(nr, addr), dde_linux26_bit_mask(nr));
+}
+
+
+static inline int dde_linux26_test_bit(int nr, const volatile unsigned long *addr)
+{
+	return (addr[nr / DDE_LINUX26_BITS_PER_LONG] & dde_linux26_bit_mask(nr)) != 0;
+}
+
+
+static inline int dde_linux26_test_and_set_bit(int nr, volatile unsigned long *addr)
+{
+	unsigned long mask = dde_linux26_bit_mask(nr);
+
+	return (__sync_fetch_and_or(dde_linux26_bit_word(nr, addr), mask) & mask) != 0;
+}
+
+
+static inline int dde_linux26_test_and_clear_bit(int nr, volatile unsigned long *addr)
+{
+	unsigned long mask = dde_linux26_bit_mask(nr);
+
+	return (__sync_fetch_and_and(dde_linux26_bit_word(nr, addr), ~mask) & mask) != 0;
+}
+
+
+/**
+ * Find first set bit in 'x'
+ *
+ * \return  bit index + 1, or 0 if 'x' is 0
+ */
+static inline int dde_linux26_ffs(int x)
+{
+	return __builtin_ffs(x);
+}
+
+
+/**
+ * Find first set bit in memory region
+ *
+ * \param size  region size in bits
+ * \return      bit index, or 'size' if no bit is set
+ */
+static inline unsigned long
+dde_linux26_find_first_bit(const unsigned long *addr, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i * DDE_LINUX26_BITS_PER_LONG < size; i++) {
+		unsigned long bit;
+
+		if (!addr[i])
+			continue;
+
+		bit = i * DDE_LINUX26_BITS_PER_LONG + __builtin_ctzl(addr[i]);
+		return bit < size ? bit : size;
+	}
+
+	return size;
+}
+
+
+/**
+ * Find first zero bit in memory region
+ *
+ * \param size  region size in bits
+ * \return      bit index, or 'size' if all bits are set
+ */
+static inline unsigned long
+dde_linux26_find_first_zero_bit(const unsigned long *addr, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = 0; i * DDE_LINUX26_BITS_PER_LONG < size; i++) {
+		unsigned long bit;
+
+		if (!~addr[i])
+			continue;
+
+		bit = i * DDE_LINUX26_BITS_PER_LONG + __builtin_ctzl(~addr[i]);
+		return bit < size ? bit : size;
+	}
+
+	return size;
+}
+
+#endif /* _DDE_LINUX26__ATOMIC_H_ */
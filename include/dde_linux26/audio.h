@@ -10,12 +10,27 @@
 #ifndef _DDE_LINUX26__AUDIO_H_
 #define _DDE_LINUX26__AUDIO_H_
 
+/**
+ * PCM configuration
+ *
+ * The driver negotiates the nearest configuration supported by the device.
+ */
+struct dde_linux26_audio_params
+{
+	const char *format;       /* SALSA format name, e.g., "S16_LE" */
+	unsigned    rate;         /* frames per second */
+	unsigned    channels;
+	unsigned    period_size;  /* frames */
+	unsigned    periods;      /* per hardware buffer */
+};
+
 /**
  * Initialize audio subsystem
  *
- * \return number of pcm devices
+ * \param params  in: requested configuration, out: negotiated configuration
+ * \return        0 on success
  */
-extern int dde_linux26_audio_init(void);
+extern int dde_linux26_audio_init(struct dde_linux26_audio_params *params);
 
 extern int dde_linux26_audio_init_devices(void);
 
@@ -24,6 +39,42 @@ extern int dde_linux26_audio_play(void *data, int frame_cnt);
 extern void dde_linux26_audio_stop(void);
 extern void dde_linux26_audio_start(void);
 
+/**
+ * Return true if playback writes directly into the hardware buffer
+ *
+ * In this mode, frames must be written via dde_linux26_audio_mmap_begin()
+ * and dde_linux26_audio_mmap_commit() instead of dde_linux26_audio_play().
+ */
+extern int dde_linux26_audio_mmap(void);
+
+/**
+ * Get writable region of the hardware buffer at the application pointer
+ *
+ * Blocks until buffer space is available.
+ *
+ * \param frame_cnt  in: frames to write, out: contiguous frames available,
+ *                   which may be fewer than requested
+ * \return           address of interleaved frames or 0 on error
+ */
+extern void *dde_linux26_audio_mmap_begin(int *frame_cnt);
+
+/**
+ * Commit frames written to the region returned by
+ * dde_linux26_audio_mmap_begin()
+ *
+ * \return 0 on success
+ */
+extern int dde_linux26_audio_mmap_commit(int frame_cnt);
+
+/**
+ * Get playback delay
+ *
+ * The delay is the time in frames until a frame written now is audible.
+ *
+ * \return  delay in frames, or negative error code
+ */
+extern long dde_linux26_audio_delay(void);
+
 /**
  * Return hardware-audio buffer for given file handle
  */
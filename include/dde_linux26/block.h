@@ -19,6 +19,9 @@ enum Block_errors {
 /** 
  * Device registered callback
  *
+ * Each logical unit of a USB storage device is registered as a device of
+ * its own. Device identifiers are assigned in ascending order.
+ *
  * \param usb_index device identifier
  */
 typedef void (*dde_linux26_block_plugin_cb)(int usb_index);
@@ -57,7 +60,7 @@ extern int dde_linux26_block_dev_add(struct scsi_device *sdev);
  *
  *  \return number of blocks
  */
-extern int dde_linux26_block_count(int usb_index);
+extern long long dde_linux26_block_count(int usb_index);
 
 /**
  * Retrieve block size in bytes
@@ -68,6 +71,15 @@ extern int dde_linux26_block_count(int usb_index);
  */
 extern int dde_linux26_block_size(int usb_index);
 
+/**
+ * Retrieve SCSI logical unit number of device
+ *
+ * \param usb_index device identifier
+ *
+ * \return LUN
+ */
+extern int dde_linux26_block_lun(int usb_index);
+
 /** Read one block from device
  *
  * \param usb_index device identifier
@@ -89,6 +101,159 @@ extern int dde_linux26_block_read(int usb_index, unsigned long block_nr, void *b
  */
 extern int dde_linux26_block_write(int usb_index, unsigned long block_nr, void *buffer);
 
+/**
+ * Read a range of blocks from device
+ *
+ * The request is split into as few SCSI commands as the host driver's
+ * 'max_sectors' limit permits. READ_16 is used for LBAs beyond 32 bit.
+ *
+ * \param usb_index device identifier
+ * \param block_nr  first block number to read
+ * \param count     number of blocks to read
+ * \param buffer    request buffer for data
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_read_range(int usb_index, unsigned long long block_nr,
+                                        unsigned long count, void *buffer);
+
+/**
+ * Write a range of blocks to device
+ *
+ * \param usb_index device identifier
+ * \param block_nr  first block number to write
+ * \param count     number of blocks to write
+ * \param buffer    request buffer containing the data
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_write_range(int usb_index, unsigned long long block_nr,
+                                         unsigned long count, void *buffer);
+
+/**
+ * Block request completion callback
+ *
+ * Called from the device's request dispatcher thread. Requests may complete
+ * in a different order than they were submitted.
+ *
+ * \param priv  private pointer passed to 'dde_linux26_block_submit'
+ * \param error 0 on success; negative value otherwise
+ */
+typedef void (*dde_linux26_block_complete_cb)(void *priv, int error);
+
+/**
+ * Queue block request at device
+ *
+ * Requests are passed to the host as soon as the host's queue depth
+ * ('can_queue') permits, so this function does not block on the device.
+ *
+ * \param usb_index device identifier
+ * \param block_nr  first block number
+ * \param count     number of blocks
+ * \param buffer    request buffer, must stay valid until completion
+ * \param write     1 for writing to the device; 0 for reading
+ * \param complete  completion callback
+ * \param priv      private pointer passed to 'complete'
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_submit(int usb_index, unsigned long long block_nr,
+                                    unsigned long count, void *buffer, int write,
+                                    dde_linux26_block_complete_cb complete,
+                                    void *priv);
+
+/**
+ * Check if buffer can be used for DMA by the device directly
+ *
+ * The buffer must be registered in the DDE kit page table, physically
+ * contiguous, and meet the DMA alignment of the device's request queue.
+ * Otherwise, the caller has to use a buffer from 'dde_linux26_block_malloc'.
+ *
+ * \param usb_index device identifier
+ * \param buffer    request buffer
+ * \param size      size of buffer in bytes
+ *
+ * \return 1 if buffer is usable; 0 otherwise
+ */
+extern int dde_linux26_block_dma_capable(int usb_index, void *buffer, unsigned long size);
+
+/**
+ * Block cache statistics
+ */
+struct dde_linux26_block_cache_stats
+{
+	unsigned long hits;        /* reads served without device access */
+	unsigned long misses;      /* reads that had to fetch blocks */
+	unsigned long readahead;   /* blocks fetched by read-ahead */
+	unsigned long writes;      /* writes absorbed by the cache */
+	unsigned long writebacks;  /* WRITE commands issued by the cache */
+};
+
+/**
+ * Enable block cache for device
+ *
+ * Calling this function for a device with enabled cache has no effect.
+ *
+ * \param usb_index device identifier
+ * \param size      cache size in bytes
+ * \param readahead number of blocks to read ahead of sequential streams
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_cache_init(int usb_index, unsigned long size, unsigned readahead);
+
+/**
+ * Check if block cache is enabled for device
+ *
+ * \param usb_index device identifier
+ *
+ * \return 1 if enabled; 0 otherwise
+ */
+extern int dde_linux26_block_cache_enabled(int usb_index);
+
+/**
+ * Read range of blocks through the cache
+ *
+ * Falls back to 'dde_linux26_block_read_range' if no cache is enabled.
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_cache_read(int usb_index, unsigned long long block_nr,
+                                        unsigned long count, void *buffer);
+
+/**
+ * Write range of blocks to the cache
+ *
+ * The blocks are written back on 'dde_linux26_block_cache_flush', on
+ * eviction, or if too many cache extents are dirty. Falls back to
+ * 'dde_linux26_block_write_range' if no cache is enabled.
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_cache_write(int usb_index, unsigned long long block_nr,
+                                         unsigned long count, void *buffer);
+
+/**
+ * Write back all dirty blocks and wait for completion
+ *
+ * \param usb_index device identifier
+ *
+ * \return 0 on success; negative value if a write-back failed since the
+ *         last flush
+ */
+extern int dde_linux26_block_cache_flush(int usb_index);
+
+/**
+ * Retrieve block cache statistics
+ *
+ * \param usb_index device identifier
+ * \param stats     destination of statistics
+ *
+ * \return 0 on success; negative value otherwise
+ */
+extern int dde_linux26_block_cache_stats(int usb_index,
+                                         struct dde_linux26_block_cache_stats *stats);
+
 /**
  * Allocate memory for block I/O
  * 
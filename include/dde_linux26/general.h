@@ -42,4 +42,70 @@ int dde_linux26_process_from_dde_kit(struct dde_kit_thread *thread);
  */
 void dde_linux26_init(void);
 
+/**
+ * Softirq statistics
+ */
+struct dde_linux26_softirq_stats
+{
+	unsigned long      raised;   /* raise requests */
+	unsigned long      run;      /* handler invocations */
+	unsigned long long time_us;  /* time spent in the handler */
+};
+
+/**
+ * Get statistics of softirq
+ *
+ * \param nr     softirq number, e.g., HI_SOFTIRQ or TASKLET_SOFTIRQ
+ * \param stats  destination
+ *
+ * \return 0 on success, -1 if 'nr' is invalid
+ */
+int dde_linux26_softirq_stats(unsigned nr, struct dde_linux26_softirq_stats *stats);
+
+enum { DDE_LINUX26_IRQ_HIST_SIZE = 12 };
+
+/**
+ * Statistics of one interrupt handler
+ *
+ * The dispatch delay is measured from the call of the DDE interrupt handler
+ * by the IRQ thread to the entry of the Linux handler. It is the time spent
+ * in the handlers of a shared line that ran before and is about zero for the
+ * first handler. The wakeup latency of the IRQ thread is not covered.
+ */
+struct dde_linux26_irq_stats
+{
+	unsigned       irq;
+	const char    *name;            /* device name passed to request_irq() */
+	unsigned long  count;           /* invocations */
+	unsigned long  unhandled;       /* invocations returning IRQ_NONE */
+	unsigned long  time_min_ns;     /* handler runtime */
+	unsigned long  time_avg_ns;
+	unsigned long  time_max_ns;
+	unsigned long  delay_min_ns;    /* dispatch to handler entry */
+	unsigned long  delay_avg_ns;
+	unsigned long  delay_max_ns;
+
+	/* runtime histogram, bucket i counts runtimes below 2^i us */
+	unsigned long  hist[DDE_LINUX26_IRQ_HIST_SIZE];
+};
+
+/**
+ * Get statistics of all handlers of interrupt
+ *
+ * \param irq    interrupt number
+ * \param stats  array of at least 'max' elements
+ * \param max    maximum number of handlers to report
+ *
+ * \return number of handlers reported, or -1 if the interrupt is not used
+ */
+int dde_linux26_irq_stats(unsigned irq, struct dde_linux26_irq_stats *stats,
+                          unsigned max);
+
+/**
+ * Log statistics of all interrupt handlers periodically
+ *
+ * \param period_ms  log period, 0 stops logging
+ */
+void dde_linux26_irq_stats_log(unsigned period_ms);
+
 #endif /* _DDE_LINUX26__GENERAL_H_ */
@@ -290,24 +290,16 @@ extern int _atomic_dec_and_lock(atomic_t *atomic, spinlock_t *lock);
  */
 #define spin_can_lock(lock)	(!spin_is_locked(lock))
 
-#define spin_lock_init(l) \
-	do { \
-		dde_kit_spin_lock_init(&(l)->dde_kit_spin_lock); \
-		(l)->need_init = 0; \
-	} while (0);
+#define spin_lock_init(l) dde_linux26_spin_lock_init(&(l)->raw_lock)
 
 #define rwlock_init(l) spin_lock_init(l)
 
-#define COND_INIT_LOCK(l) \
-	do { \
-		if ((l)->need_init) spin_lock_init(l); \
-	} while (0);
+#define spin_is_locked(l) dde_linux26_spin_lock_is_locked(&(l)->raw_lock)
 
 #define spin_lock(lock) \
 	do { \
-		COND_INIT_LOCK(lock); \
 		preempt_disable(); \
-		dde_kit_spin_lock_lock(&(lock)->dde_kit_spin_lock); \
+		dde_linux26_spin_lock_lock(&(lock)->raw_lock); \
 	} while (0)
 
 #define read_lock(lock) spin_lock(lock)
@@ -321,8 +313,7 @@ extern int _atomic_dec_and_lock(atomic_t *atomic, spinlock_t *lock);
 
 #define spin_unlock(lock) \
 	do { \
-		COND_INIT_LOCK(lock); \
-		dde_kit_spin_lock_unlock(&(lock)->dde_kit_spin_lock); \
+		dde_linux26_spin_lock_unlock(&(lock)->raw_lock); \
 		preempt_enable(); \
 	} while (0)
 
@@ -356,8 +347,7 @@ extern int _atomic_dec_and_lock(atomic_t *atomic, spinlock_t *lock);
 
 static int __lockfunc spin_trylock(spinlock_t *lock)
 {
-	COND_INIT_LOCK(lock);
-	return dde_kit_spin_lock_try_lock(&lock->dde_kit_spin_lock) == 0;
+	return dde_linux26_spin_lock_try_lock(&lock->raw_lock) == 0;
 }
 
 #define _raw_spin_unlock(l) spin_unlock(l)
@@ -95,17 +95,19 @@ typedef struct {
 
 #else
 
-#include <dde_kit/spin_lock.h>
+#include <dde_linux26/spin_lock.h>
 
+/*
+ * Readers and writers are not distinguished, every lock is exclusive.
+ */
 typedef struct {
-	dde_kit_spin_lock dde_kit_spin_lock;
-	char              need_init;
+	struct dde_linux26_spin_lock raw_lock;
 } spinlock_t;
 
 typedef spinlock_t rwlock_t;
 
-#define SPIN_LOCK_UNLOCKED (spinlock_t) { .dde_kit_spin_lock = DDE_KIT_SPIN_LOCK_UNLOCKED, .need_init = 1 }
-#define RW_LOCK_UNLOCKED   (spinlock_t) { .dde_kit_spin_lock = DDE_KIT_SPIN_LOCK_UNLOCKED, .need_init = 1 }
+#define SPIN_LOCK_UNLOCKED (spinlock_t) { .raw_lock = DDE_LINUX26_SPIN_LOCK_UNLOCKED }
+#define RW_LOCK_UNLOCKED   (spinlock_t) { .raw_lock = DDE_LINUX26_SPIN_LOCK_UNLOCKED }
 
 #define __SPIN_LOCK_UNLOCKED(name)   SPIN_LOCK_UNLOCKED
 #define __RW_LOCK_UNLOCKED(name)     RW_LOCK_UNLOCKED
@@ -14,30 +14,17 @@ struct timer_list {
 	void (*function)(unsigned long);
 	unsigned long data;
 
-#ifndef DDE_LINUX
 	struct tvec_t_base_s *base;
-#else /* DDE_LINUX */
-	void *dde_kit_timer;
-#endif /* DDE_LINUX */
 };
 
 extern struct tvec_t_base_s boot_tvec_bases;
 
-#ifndef DDE_LINUX
 #define TIMER_INITIALIZER(_function, _expires, _data) {		\
 		.function = (_function),			\
 		.expires = (_expires),				\
 		.data = (_data),				\
 		.base = &boot_tvec_bases,			\
 	}
-#else
-#define TIMER_INITIALIZER(_function, _expires, _data) {		\
-		.function = (_function),			\
-		.expires = (_expires),				\
-		.data = (_data),				\
-		.dde_kit_timer = 0,			\
-	}
-#endif /* DDE_LINUX */
 
 #define DEFINE_TIMER(_name, _function, _expires, _data)		\
 	struct timer_list _name =				\
@@ -54,7 +41,6 @@ static inline void setup_timer(struct timer_list * timer,
 	init_timer(timer);
 }
 
-#ifndef DDE_LINUX
 /**
  * timer_pending - is a timer pending?
  * @timer: the timer in question
@@ -69,9 +55,6 @@ static inline int timer_pending(const struct timer_list * timer)
 {
 	return timer->entry.next != NULL;
 }
-#else
-int timer_pending(const struct timer_list *timer);
-#endif /* DDE_LINUX */
 
 extern void add_timer_on(struct timer_list *timer, int cpu);
 extern int del_timer(struct timer_list * timer);
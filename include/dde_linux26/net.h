@@ -17,6 +17,30 @@
  */
 typedef void (*dde_linux26_net_rx_cb)(unsigned if_index, const unsigned char *packet, unsigned packet_len);
 
+enum { DDE_LINUX26_NET_BURST_MAX = 32 };
+
+/**
+ * Packet buffer of a burst
+ */
+struct dde_linux26_net_iovec
+{
+	const unsigned char *packet;
+	unsigned             packet_len;
+};
+
+/**
+ * Burst packet reception callback
+ *
+ * \param   if_index  index of the receiving network interface
+ * \param   iov       packets
+ * \param   n         number of packets (at most DDE_LINUX26_NET_BURST_MAX)
+ *
+ * The packet buffers are valid during the callback only.
+ */
+typedef void (*dde_linux26_net_rx_burst_cb)(unsigned if_index,
+                                            const struct dde_linux26_net_iovec *iov,
+                                            unsigned n);
+
 /**
  * Register packet reception callback
  *
@@ -31,6 +55,54 @@ typedef void (*dde_linux26_net_rx_cb)(unsigned if_index, const unsigned char *pa
  */
 extern dde_linux26_net_rx_cb dde_linux26_net_register_rx_callback(dde_linux26_net_rx_cb cb);
 
+/**
+ * Register burst packet reception callback
+ *
+ * \param   cb   new callback function, or 0 to return to the per-packet callback
+ *
+ * \return  old callback function pointer
+ *
+ * If registered, the burst callback supersedes the per-packet callback.
+ * Packets received during one interrupt or tasklet are collected and handed
+ * out in bursts afterwards.
+ */
+extern dde_linux26_net_rx_burst_cb dde_linux26_net_register_rx_burst_callback(dde_linux26_net_rx_burst_cb cb);
+
+/**
+ * Link-state callback
+ *
+ * \param   if_index  index of the network interface
+ * \param   up        1 if the device has carrier, 0 otherwise
+ *
+ * The callback is called on every carrier change, e.g., on association
+ * and disassociation of wireless devices.
+ */
+typedef void (*dde_linux26_net_link_cb)(unsigned if_index, int up);
+
+/**
+ * Register link-state callback
+ *
+ * \return  old callback function pointer
+ */
+extern dde_linux26_net_link_cb dde_linux26_net_register_link_callback(dde_linux26_net_link_cb cb);
+
+/**
+ * Get link state of device
+ *
+ * \return  1 if the device has carrier, 0 if not, -1 if the device is unknown
+ */
+extern int dde_linux26_net_link_state(unsigned if_index);
+
+/**
+ * Wait until device has carrier
+ *
+ * \param   if_index    index of the network interface
+ * \param   timeout_ms  maximum time to wait
+ *
+ * \return  0 if the link is up, negative error code otherwise
+ */
+extern int dde_linux26_net_wait_for_link(unsigned if_index, unsigned timeout_ms);
+
 /**
  * Send packet
  *
@@ -39,9 +111,174 @@ extern dde_linux26_net_rx_cb dde_linux26_net_register_rx_callback(dde_linux26_ne
  * \param   packet_len  packet length
  *
  * \return  0 on success, -1 otherwise
+ *
+ * If the transmit queue of the device is full, the function blocks until the
+ * driver restarts the queue.
  */
 extern int dde_linux26_net_tx(unsigned if_index, const unsigned char *packet, unsigned packet_len);
 
+/**
+ * Send packet if the transmit queue of the device is not full
+ *
+ * \param   if_index    index of the network interface to be used for sending
+ * \param   packet      buffer containing the packet
+ * \param   packet_len  packet length
+ *
+ * \return  0 on success, -EAGAIN if the transmit queue is full, -1 otherwise
+ */
+extern int dde_linux26_net_tx_try(unsigned if_index, const unsigned char *packet, unsigned packet_len);
+
+/**
+ * Send burst of packets
+ *
+ * \param   if_index  index of the network interface to be used for sending
+ * \param   iov       packets
+ * \param   n         number of packets
+ *
+ * \return  number of packets sent, or -1 if the device is unknown
+ *
+ * Like dde_linux26_net_tx(), the function blocks while the transmit queue of
+ * the device is full.
+ */
+extern int dde_linux26_net_tx_burst(unsigned if_index,
+                                    const struct dde_linux26_net_iovec *iov,
+                                    unsigned n);
+
+/**
+ * Socket-buffer pool statistics
+ */
+struct dde_linux26_net_skb_pool_stats
+{
+	unsigned long hits;      /* transmissions served from the pool */
+	unsigned long misses;    /* transmissions that allocated a new skb */
+	unsigned long recycled;  /* skb data areas returned to the pool */
+	unsigned long dropped;   /* skb data areas freed because not recyclable or pool full */
+};
+
+/**
+ * Enable or disable recycling of socket buffers
+ *
+ * The pool is enabled by default. Disabling frees all pooled buffers.
+ */
+extern void dde_linux26_net_skb_pool_enable(int enable);
+
+/**
+ * Get socket-buffer pool statistics
+ */
+extern void dde_linux26_net_skb_pool_stats(struct dde_linux26_net_skb_pool_stats *stats);
+
+/**
+ * Allocator of client-provided receive buffers
+ */
+struct dde_linux26_net_rx_buffer_alloc
+{
+	void          *base;  /* region containing all buffers */
+	unsigned long  size;
+
+	/**
+	 * Allocate buffer of 'size' bytes, return 0 if exhausted
+	 */
+	void *(*alloc)(void *priv, unsigned size);
+
+	/**
+	 * Free buffer, called once the driver released it
+	 */
+	void  (*free)(void *priv, void *buf);
+
+	/**
+	 * Called once the region was released after unregistering, may be 0
+	 *
+	 * Neither buffers nor the region are accessed afterwards.
+	 */
+	void  (*release)(void *priv);
+
+	void  *priv;
+};
+
+/**
+ * Register allocator of receive buffers for device
+ *
+ * \param   if_index  index of the network interface
+ * \param   alloc     allocator, copied on registration
+ *
+ * \return  0 on success, negative error code otherwise
+ *
+ * Drivers supporting it (currently ath) receive directly into these
+ * buffers. Packets passed to the rx callbacks then point into the buffer
+ * region, which permits delivering them without copying. The buffer is
+ * freed after the rx callback returned.
+ *
+ * The region must be registered in the DDE kit page table until it is
+ * released after dde_linux26_net_unregister_rx_buffer_alloc(). Buffer
+ * allocation falls back to kmalloc() if the allocator is exhausted.
+ */
+extern int dde_linux26_net_register_rx_buffer_alloc(unsigned if_index,
+                                                    const struct dde_linux26_net_rx_buffer_alloc *alloc);
+
+/**
+ * Unregister receive-buffer allocator of network device
+ *
+ * \param   if_index  index of the network interface
+ *
+ * \return  0 if the region was released, -EBUSY if the driver still holds
+ *          buffers, -EINVAL if no allocator is registered
+ *
+ * No further buffers are allocated. While the driver holds buffers, the
+ * allocator and its region must stay valid. The region is released when
+ * the last buffer is freed, which is reported via 'alloc->release', from
+ * within this function if no buffer is held.
+ */
+extern int dde_linux26_net_unregister_rx_buffer_alloc(unsigned if_index);
+
+struct net_device;
+struct sk_buff;
+
+/**
+ * Allocate socket buffer for reception by driver
+ *
+ * Like dev_alloc_skb() but uses the rx buffer allocator of the device if
+ * registered.
+ */
+extern struct sk_buff *dde_linux26_net_alloc_rx_skb(struct net_device *dev, unsigned size);
+
+/**
+ * Set budget of packets received per softnet poll round
+ *
+ * Packet reception runs in a dedicated softnet thread. After each round of
+ * at most 'budget' packets (default 300), other threads get the chance to
+ * run.
+ */
+extern void dde_linux26_net_set_budget(int budget);
+
+/**
+ * Set weight of device within a softnet poll round
+ *
+ * \param   if_index  index of the network interface
+ * \param   weight    packets received from the device before the next
+ *                    device is polled (default 64)
+ *
+ * \return  0 on success, negative error code otherwise
+ */
+extern int dde_linux26_net_set_weight(unsigned if_index, int weight);
+
+/**
+ * Softnet statistics
+ */
+struct dde_linux26_net_softnet_stats
+{
+	unsigned long received;    /* packets queued by drivers without ->poll */
+	unsigned long dropped;     /* packets dropped because of a full backlog */
+	unsigned long throttled;   /* backlog overflows, dropping until drained */
+	unsigned long polls;       /* poll rounds */
+	unsigned long squeezed;    /* rounds ended by budget or time limit */
+	unsigned long poll_us;     /* time spent in polling, wraps around */
+};
+
+/**
+ * Get softnet statistics
+ */
+extern void dde_linux26_net_softnet_stats(struct dde_linux26_net_softnet_stats *stats);
+
 /**
  * Get MAC address of device
  *
@@ -69,6 +69,7 @@ struct Scsi_Host {
 
 	struct scsi_host_template *hostt;
 	unsigned int max_id;
+	unsigned int max_lun;
 
 	unsigned short host_no;  /* Used for IOCTL_GET_IDLUN, /proc/scsi et al. */
 	/*
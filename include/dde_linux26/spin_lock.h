@@ -0,0 +1,107 @@
+/*
+ * \brief  Adaptive spin-then-block lock
+ * \date   2026-10-18
+ *
+ * The critical sections guarded by Linux spinlocks are mostly a few dozen
+ * instructions long, so a contender spins for a bounded number of rounds
+ * before it blocks. The lock word has three states (unlocked, locked,
+ * locked with blocked waiters), which limits the uncontended path to one
+ * atomic operation for lock and unlock each. Only unlocking a lock with
+ * blocked waiters enters the slow path.
+ *
+ * The header depends on DDE kit only and is shared by DDE Linux 2.6 and
+ * the i915 Linux emulation.
+ */
+
+#ifndef _DDE_LINUX26__SPIN_LOCK_H_
+#define _DDE_LINUX26__SPIN_LOCK_H_
+
+#include <dde_linux26/atomic.h>
+
+enum {
+	DDE_LINUX26_SPIN_LOCK_SPINS = 1000,  /* spin rounds before blocking */
+};
+
+enum {
+	DDE_LINUX26_SPIN_LOCK_FREE    = 0,
+	DDE_LINUX26_SPIN_LOCK_LOCKED  = 1,
+	DDE_LINUX26_SPIN_LOCK_WAITERS = 2,  /* locked, waiters may be blocked */
+};
+
+struct dde_linux26_spin_lock
+{
+	volatile int state;
+};
+
+#define DDE_LINUX26_SPIN_LOCK_UNLOCKED { DDE_LINUX26_SPIN_LOCK_FREE }
+
+/**
+ * Block until lock is acquired (slow path)
+ */
+void dde_linux26_spin_lock_wait(struct dde_linux26_spin_lock *lock);
+
+/**
+ * Wake threads blocked in dde_linux26_spin_lock_wait() (slow path)
+ */
+void dde_linux26_spin_lock_wake(struct dde_linux26_spin_lock *lock);
+
+
+static inline void dde_linux26_spin_lock_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("rep; nop" : : : "memory");
+#else
+	__asm__ __volatile__("" : : : "memory");
+#endif
+}
+
+
+static inline void dde_linux26_spin_lock_init(struct dde_linux26_spin_lock *lock)
+{
+	lock->state = DDE_LINUX26_SPIN_LOCK_FREE;
+}
+
+
+/**
+ * Try to acquire lock
+ *
+ * \return  0 if lock was acquired, -1 otherwise
+ */
+static inline int dde_linux26_spin_lock_try_lock(struct dde_linux26_spin_lock *lock)
+{
+	return dde_linux26_atomic_cmpxchg(&lock->state, DDE_LINUX26_SPIN_LOCK_FREE,
+	                                  DDE_LINUX26_SPIN_LOCK_LOCKED)
+	       == DDE_LINUX26_SPIN_LOCK_FREE ? 0 : -1;
+}
+
+
+static inline void dde_linux26_spin_lock_lock(struct dde_linux26_spin_lock *lock)
+{
+	int i;
+
+	for (i = 0; i < DDE_LINUX26_SPIN_LOCK_SPINS; i++) {
+		/* read before the atomic to keep the cache line shared */
+		if (dde_linux26_atomic_read(&lock->state) == DDE_LINUX26_SPIN_LOCK_FREE &&
+		    dde_linux26_spin_lock_try_lock(lock) == 0)
+			return;
+		dde_linux26_spin_lock_relax();
+	}
+
+	dde_linux26_spin_lock_wait(lock);
+}
+
+
+static inline void dde_linux26_spin_lock_unlock(struct dde_linux26_spin_lock *lock)
+{
+	if (dde_linux26_atomic_xchg(&lock->state, DDE_LINUX26_SPIN_LOCK_FREE)
+	    == DDE_LINUX26_SPIN_LOCK_WAITERS)
+		dde_linux26_spin_lock_wake(lock);
+}
+
+
+static inline int dde_linux26_spin_lock_is_locked(struct dde_linux26_spin_lock *lock)
+{
+	return dde_linux26_atomic_read(&lock->state) != DDE_LINUX26_SPIN_LOCK_FREE;
+}
+
+#endif /* _DDE_LINUX26__SPIN_LOCK_H_ */
@@ -14,9 +14,9 @@ include $(REP_DIR)/lib/mk/dde_linux26-common.inc
 
 INC_DIR += $(REP_DIR)/src/linux26/drivers/pci
 
-SRC_C = cli_sti.c fs.c hw-helpers.c init.c init_task.c irq.c kmalloc.c \
-        kmem_cache.c page_alloc.c param.c pci.c power.c process.c res.c \
-        sched.c signal.c smp.c softirq.c timer.c vmalloc.c vmstat.c \
+SRC_C = cli_sti.c fs.c hrtimer.c hw-helpers.c init.c init_task.c irq.c \
+        kmalloc.c kmem_cache.c page_alloc.c param.c pci.c power.c process.c res.c \
+        sched.c signal.c smp.c softirq.c spin_lock.c timer.c vmalloc.c vmstat.c \
         printk.c \
         dummies.c
 
@@ -20,8 +20,8 @@ INC_DIR += $(REP_DIR)/src/madwifi/include \
 
 # DDEKit + DDELinux26
 SRC_C  = dev.c dev_mcast.c dummies.c eth.c ethtool.c link_watch.c mii.c neighbour.c \
-         net.c netevent.c rtnetlink.c sch_generic.c skbuff.c sysctl.c utils.c \
-         wifi.c wireless.c
+         net.c netevent.c rtnetlink.c sch_generic.c skbuff.c softnet.c sysctl.c \
+         utils.c wifi.c wireless.c
 
 # Madwifi driver
 SRC_C += ah_os.c \
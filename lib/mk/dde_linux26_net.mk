@@ -0,0 +1,30 @@
+#
+# DDE Linux 2.6 network library
+#
+# This library is used by the DDE Linux 2.6 NET test program in
+# linux_drivers/src/test/dde_linux26_net and the DDE Linux 2.6 test program.
+#
+LIBS = dde_linux26
+
+#
+# Include local configuration of library sources
+#
+include $(REP_DIR)/lib/mk/dde_linux26-common.inc
+
+# DDEKit + DDELinux26
+SRC_C = dev.c dev_mcast.c eth.c ethtool.c link_watch.c mii.c neighbour.c \
+        net.c netevent.c rtnetlink.c sch_generic.c skbuff.c softnet.c utils.c
+
+# Network drivers
+SRC_C += 8390.c ne2k-pci.c pcnet32.c
+
+# Let pcnet32 receive via its ->poll function (NAPI)
+CC_OPT_pcnet32 += -DCONFIG_PCNET32_NAPI
+
+vpath net.c     $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
+vpath softnet.c $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
+vpath %         $(REP_DIR)/src/lib/dde_linux26/net/core
+vpath %         $(REP_DIR)/src/lib/dde_linux26/net/sched
+vpath %         $(REP_DIR)/src/linux26/drivers/net
+vpath %         $(REP_DIR)/src/linux26/net/core
+vpath %         $(REP_DIR)/src/linux26/net/ethernet
@@ -5,13 +5,16 @@
 # linux_drivers/src/test/dde_linux26.
 #
 
-LIBS = dde_linux26
+LIBS = dde_linux26 dde_linux26_net
 
 #
 # Include local configuration of library sources
 #
 include $(REP_DIR)/lib/mk/dde_linux26-common.inc
 
-SRC_C = test.c
+SRC_C = test.c scsi.c usb_storage.c block_cache.c
 
 vpath % $(REP_DIR)/src/test/dde_linux26
+vpath scsi.c        $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
+vpath usb_storage.c $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
+vpath block_cache.c $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
@@ -17,7 +17,7 @@ include $(REP_DIR)/lib/mk/dde_linux26-common.inc
 INC_DIR += $(REP_DIR)/src/linux26/drivers/usb/storage
 
 SRC_C = scsiglue.c protocol.c transport.c usb.c initializers.c \
-        scsi.c debug.c constants.c usb_storage.c
+        scsi.c debug.c constants.c usb_storage.c block_cache.c
 
 ifneq ($(DEBUG),0)
 D_OPTS = -DCONFIG_USB_STORAGE_DEBUG
@@ -11,7 +11,7 @@ INC_DIR     += $(REP_DIR)/src/drivers/gpu/i915/ \
                $(CONTRIB_DIR)/include/drm \
                $(CONTRIB_DIR)/include
 CC_OPT      += -U__linux__ -D__KERNEL__ -D__OS_HAS_AGP
-SRC_C       += dummies.c probe.c
+SRC_C       += dummies.c probe.c spin_lock.c
 SRC_CC      += driver.cc lx_emul.cc lx_pci.c
 LIBS        += dde_kit
 
@@ -35,6 +35,7 @@ vpath driver.cc  $(REP_DIR)/src/drivers/gpu/i915
 vpath probe.c    $(REP_DIR)/src/drivers/gpu/i915
 vpath lx_emul.cc $(REP_DIR)/src/drivers/gpu/i915
 vpath lx_pci.c   $(REP_DIR)/src/drivers/gpu/i915
+vpath spin_lock.c $(REP_DIR)/src/lib/dde_linux26/arch/dde_kit
 
 #
 # Determine the header files included by the contrib code. For each
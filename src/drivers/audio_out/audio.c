@@ -67,36 +67,23 @@ void do_initcalls(void)
  ** Driver interface **
  **********************/
 
-enum { PERIOD_SIZE = 1024, PERIODS = 8 };
+enum { START_PERIODS = 2 };  /* periods queued before mmap playback starts */
 
-static snd_pcm_t *pcm_handle;
+static snd_pcm_t        *pcm_handle;
+static int               mmap_mode;
+static snd_pcm_uframes_t mmap_offset;  /* of region returned by mmap_begin */
 
-int dde_linux26_audio_init(void)
-{
-	dde_linux26_init();
-	do_initcalls();
-
-	int count = dde_linux26_audio_init_devices();
-	dde_kit_printf("found %d PCM devices\n", count);
-
-	snd_pcm_stream_t stream = SND_PCM_STREAM_PLAYBACK;
 
+/**
+ * Negotiate hardware parameters nearest to 'params'
+ */
+static int set_hw_params(snd_pcm_access_t access,
+                         struct dde_linux26_audio_params *params)
+{
 	struct sndrv_pcm_hw_params _hwparams;
 	snd_pcm_hw_params_t *hwparams = &_hwparams;
 	memset(hwparams, 0, sizeof(*hwparams));
 
-	const char *pcm_name = "hw:0,0";
-
-	snd_output_t *output;
-	snd_output_stdio_attach(&output, stdout, 0);
-
-	int err;
-
-	if ((err = snd_pcm_open(&pcm_handle, pcm_name, stream, 0)) < 0) {
-		dde_kit_printf("Error %d opening PCM device %s\n", err, pcm_name);
-		return -1;
-	}
-
 	if (snd_pcm_hw_params_any(pcm_handle, hwparams) < 0) {
 		dde_kit_printf("Can not configure this PCM device.\n");
 		return -2;
@@ -105,44 +92,41 @@ int dde_linux26_audio_init(void)
 //	dde_kit_printf("initial hw_params\n");
 //	snd_pcm_hw_params_dump(hwparams, output);
 
-	int              rate      = 44100;
-	int              channels  = 2;
-	snd_pcm_access_t access    = SND_PCM_ACCESS_RW_INTERLEAVED;
-	snd_pcm_format_t format    = SND_PCM_FORMAT_S16_LE;
+	snd_pcm_format_t  format      = snd_pcm_format_value(params->format);
+	unsigned          rate        = params->rate;
+	unsigned          channels    = params->channels;
+	unsigned          periods     = params->periods;
+	snd_pcm_uframes_t period_size = params->period_size;
 
 	if (snd_pcm_hw_params_set_access(pcm_handle, hwparams, access) < 0) {
 		dde_kit_printf("Error setting access.\n");
 		return -3;
 	}
 
-	if (snd_pcm_hw_params_set_format(pcm_handle, hwparams, format) < 0) {
-		dde_kit_printf("Error setting format.\n");
+	if (format == SND_PCM_FORMAT_UNKNOWN ||
+	    snd_pcm_hw_params_set_format(pcm_handle, hwparams, format) < 0) {
+		dde_kit_printf("Error setting format %s.\n", params->format);
 		return -4;
 	}
 
-	if (snd_pcm_hw_params_set_rate(pcm_handle, hwparams, rate, 0) < 0) {
+	if (snd_pcm_hw_params_set_rate_near(pcm_handle, hwparams, &rate, 0) < 0) {
 		dde_kit_printf("Error setting rate.\n");
 		return -5;
 	}
 
-	if (snd_pcm_hw_params_set_channels(pcm_handle, hwparams, channels) < 0) {
+	if (snd_pcm_hw_params_set_channels_near(pcm_handle, hwparams, &channels) < 0) {
 		dde_kit_printf("Error setting channels.\n");
 		return -6;
 	}
 
-	if (snd_pcm_hw_params_set_periods(pcm_handle, hwparams, PERIODS, 0) < 0) {
-		dde_kit_printf("Error setting periods.\n");
-		return -7;
-	}
-
-	if (snd_pcm_hw_params_set_period_size(pcm_handle, hwparams, PERIOD_SIZE, 0) < 0) {
+	if (snd_pcm_hw_params_set_period_size_near(pcm_handle, hwparams, &period_size, 0) < 0) {
 		dde_kit_printf("Error setting period size.\n");
 		return -8;
 	}
 
-	if (snd_pcm_hw_params_set_buffer_size(pcm_handle, hwparams, PERIOD_SIZE * PERIODS) < 0) {
-		dde_kit_printf("Error setting buffersize.\n");
-		return -9;
+	if (snd_pcm_hw_params_set_periods_near(pcm_handle, hwparams, &periods, 0) < 0) {
+		dde_kit_printf("Error setting periods.\n");
+		return -7;
 	}
 
 	if (snd_pcm_hw_params(pcm_handle, hwparams) < 0) {
@@ -150,9 +134,51 @@ int dde_linux26_audio_init(void)
 		return -10;
 	}
 
+	params->rate        = pcm_handle->rate;
+	params->channels    = pcm_handle->channels;
+	params->period_size = pcm_handle->period_size;
+	params->periods     = pcm_handle->buffer_size / pcm_handle->period_size;
+
 //	dde_kit_printf("final hw_params\n");
 //	snd_pcm_hw_params_dump(hwparams, output);
 
+	return 0;
+}
+
+
+int dde_linux26_audio_init(struct dde_linux26_audio_params *params)
+{
+	dde_linux26_init();
+	do_initcalls();
+
+	int count = dde_linux26_audio_init_devices();
+	dde_kit_printf("found %d PCM devices\n", count);
+
+	snd_pcm_stream_t stream = SND_PCM_STREAM_PLAYBACK;
+
+	const char *pcm_name = "hw:0,0";
+
+	snd_output_t *output;
+	snd_output_stdio_attach(&output, stdout, 0);
+
+	int err;
+
+	if ((err = snd_pcm_open(&pcm_handle, pcm_name, stream, 0)) < 0) {
+		dde_kit_printf("Error %d opening PCM device %s\n", err, pcm_name);
+		return -1;
+	}
+
+	/* prefer writing directly into the DMA buffer */
+	struct dde_linux26_audio_params requested = *params;
+
+	mmap_mode = !set_hw_params(SND_PCM_ACCESS_MMAP_INTERLEAVED, params);
+	if (!mmap_mode) {
+		dde_kit_printf("mmap access unsupported, using read/write access\n");
+		*params = requested;
+		if ((err = set_hw_params(SND_PCM_ACCESS_RW_INTERLEAVED, params)))
+			return err;
+	}
+
 	snd_pcm_prepare(pcm_handle);
 
 	/*
@@ -228,7 +254,7 @@ static void flush_hw(void)
 	 */
 	char *hwbuf =  dde_linux26_get_hwbuf_by_fd(pcm_handle->fd);
 	if (hwbuf)
-		memset(hwbuf, 0, PERIOD_SIZE * PERIODS * 4);
+		memset(hwbuf, 0, snd_pcm_frames_to_bytes(pcm_handle, pcm_handle->buffer_size));
 }
 
 
@@ -254,3 +280,79 @@ int dde_linux26_audio_play(void *data, int frame_cnt)
 
 	return 0;
 }
+
+
+int dde_linux26_audio_mmap(void)
+{
+	return mmap_mode;
+}
+
+
+void *dde_linux26_audio_mmap_begin(int *frame_cnt)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t frames = *frame_cnt;
+	snd_pcm_uframes_t wanted = frames < pcm_handle->period_size ? frames
+	                                                            : pcm_handle->period_size;
+
+	for (;;) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm_handle);
+		int err;
+
+		if (avail < 0) {
+			flush_hw();
+			dde_linux26_audio_start();
+			continue;
+		}
+
+		if ((snd_pcm_uframes_t)avail >= wanted)
+			break;
+
+		/* buffer filled up before playback was started */
+		if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED) {
+			snd_pcm_start(pcm_handle);
+			continue;
+		}
+
+		err = snd_pcm_wait(pcm_handle, 1000);
+		if (err == 0) {
+			dde_kit_printf("timeout waiting for PCM buffer space\n");
+			return 0;
+		}
+		if (err < 0 && err != -EPIPE) {
+			dde_kit_printf("Error %d waiting for PCM buffer space\n", err);
+			return 0;
+		}
+	}
+
+	snd_pcm_mmap_begin(pcm_handle, &areas, &mmap_offset, &frames);
+	*frame_cnt = frames;
+
+	return (char *)areas[0].addr + (areas[0].first + mmap_offset * areas[0].step) / 8;
+}
+
+
+int dde_linux26_audio_mmap_commit(int frame_cnt)
+{
+	snd_pcm_sframes_t avail;
+
+	if (snd_pcm_mmap_commit(pcm_handle, mmap_offset, frame_cnt) != frame_cnt)
+		return -1;
+
+	/* start playback once enough frames are queued */
+	avail = snd_pcm_avail_update(pcm_handle);
+	if (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED && avail >= 0 &&
+	    pcm_handle->buffer_size - avail >= START_PERIODS * pcm_handle->period_size)
+		snd_pcm_start(pcm_handle);
+
+	return 0;
+}
+
+
+long dde_linux26_audio_delay(void)
+{
+	snd_pcm_sframes_t delay;
+	int err = snd_pcm_delay(pcm_handle, &delay);
+
+	return err < 0 ? err : delay;
+}
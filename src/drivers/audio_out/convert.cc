@@ -0,0 +1,464 @@
+/*
+ * \brief  Mixing and conversion of float samples to interleaved S16 frames
+ * \date   2026-10-18
+ *
+ * The SSE2 and AVX2 kernels are compiled with function-specific target
+ * attributes and selected at runtime via CPUID. This file must not depend
+ * on Genode to be usable by host benchmarks.
+ */
+
+#include "convert.h"
+
+/*
+ * Intrinsics in functions with target attributes require GCC 4.9 or newer.
+ * The immintrin.h of the compiler pulls in mm_malloc.h, which is replaced by
+ * the local version without libc dependency.
+ */
+#if defined(__i386__) || defined(__x86_64__)
+#if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#define CONVERT_SIMD 1
+#include <cpuid.h>
+#include "mm_malloc.h"
+#include <immintrin.h>
+#else
+#warning "GCC older than 4.9, SIMD kernels are compiled as scalar code"
+#endif
+#endif
+
+using namespace Audio_out;
+
+enum { S16_MAX = 32767, S16_MIN = -32768 };
+
+static const float SCALE      = 32767.0f;
+static const float DITHER_LSB = 1.0f / (1 << 24);  /* 24-bit noise to LSB */
+
+
+Dither::Dither(unsigned seed)
+{
+	for (unsigned c = 0; c < MAX_CONVERT_CHANNELS; c++)
+		for (unsigned l = 0; l < DITHER_LANES; l++)
+			/* xorshift must not start at zero */
+			state[c][l] = (seed + c * DITHER_LANES + l) * 2654435761u | 1;
+}
+
+
+/************
+ ** Scalar **
+ ************/
+
+static inline unsigned xorshift(unsigned &s)
+{
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+
+/**
+ * Triangular noise in (-1, 1) LSB from the difference of two uniform values
+ */
+static inline float tpdf(unsigned &s)
+{
+	int a = xorshift(s) >> 8;
+	int b = xorshift(s) >> 8;
+	return (float)(a - b) * DITHER_LSB;
+}
+
+
+static inline short convert_sample(float x, float d)
+{
+	float v = x * SCALE + d;
+
+	/* the operand order matches minps/maxps, NaN saturates to S16_MAX */
+	v = v < (float)S16_MAX ? v : (float)S16_MAX;
+	v = v > (float)S16_MIN ? v : (float)S16_MIN;
+
+	return (short)(int)(v + (v < 0 ? -0.5f : 0.5f));
+}
+
+
+static inline void convert_tail(short *dst, float const * const *src,
+                                unsigned channels, unsigned from, unsigned frames,
+                                Dither *dither)
+{
+	for (unsigned f = from; f < frames; f++)
+		for (unsigned c = 0; c < channels; c++) {
+			float d = dither ? tpdf(dither->state[c][f % DITHER_LANES]) : 0;
+			dst[f * channels + c] = convert_sample(src[c][f], d);
+		}
+}
+
+
+void Audio_out::convert_scalar(short *dst, float const * const *src,
+                               unsigned channels, unsigned frames, Dither *dither)
+{
+	convert_tail(dst, src, channels, 0, frames, dither);
+}
+
+
+void Audio_out::mix_scalar(float *dst, float const *src, float gain, unsigned frames)
+{
+	for (unsigned f = 0; f < frames; f++)
+		dst[f] += gain * src[f];
+}
+
+
+float Audio_out::dot_scalar(float const *a, float const *b, unsigned n)
+{
+	float sum = 0;
+	for (unsigned i = 0; i < n; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+
+#ifdef CONVERT_SIMD
+
+/**********
+ ** SSE2 **
+ **********/
+
+__attribute__((target("sse2")))
+static inline __m128i xorshift_sse2(__m128i &s)
+{
+	s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+	s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+	s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+	return s;
+}
+
+
+/**
+ * Convert four samples to saturated 32-bit integers
+ */
+__attribute__((target("sse2")))
+static inline __m128i convert4_sse2(float const *src, __m128i *state)
+{
+	__m128 v = _mm_mul_ps(_mm_loadu_ps(src), _mm_set1_ps(SCALE));
+
+	if (state) {
+		__m128i a = _mm_srli_epi32(xorshift_sse2(*state), 8);
+		__m128i b = _mm_srli_epi32(xorshift_sse2(*state), 8);
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(a, b)),
+		                             _mm_set1_ps(DITHER_LSB)));
+	}
+
+	v = _mm_min_ps(v, _mm_set1_ps((float)S16_MAX));
+	v = _mm_max_ps(v, _mm_set1_ps((float)S16_MIN));
+
+	/* add 0.5 with the sign of v and truncate */
+	__m128 half = _mm_or_ps(_mm_and_ps(v, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+	return _mm_cvttps_epi32(_mm_add_ps(v, half));
+}
+
+
+/**
+ * Convert eight samples of one channel to S16
+ */
+__attribute__((target("sse2")))
+static inline __m128i convert8_sse2(float const *src, unsigned *state)
+{
+	if (!state)
+		return _mm_packs_epi32(convert4_sse2(src, 0), convert4_sse2(src + 4, 0));
+
+	__m128i s0 = _mm_loadu_si128((__m128i *)state);
+	__m128i s1 = _mm_loadu_si128((__m128i *)(state + 4));
+	__m128i r  = _mm_packs_epi32(convert4_sse2(src, &s0), convert4_sse2(src + 4, &s1));
+	_mm_storeu_si128((__m128i *)state, s0);
+	_mm_storeu_si128((__m128i *)(state + 4), s1);
+	return r;
+}
+
+
+__attribute__((target("sse2")))
+void Audio_out::convert_sse2(short *dst, float const * const *src,
+                             unsigned channels, unsigned frames, Dither *dither)
+{
+	unsigned const blocks = frames & ~7u;
+	unsigned f;
+
+	if (channels == 2) {
+		unsigned *sl = dither ? dither->state[0] : 0;
+		unsigned *sr = dither ? dither->state[1] : 0;
+
+		for (f = 0; f < blocks; f += 8) {
+			__m128i l = convert8_sse2(src[0] + f, sl);
+			__m128i r = convert8_sse2(src[1] + f, sr);
+			_mm_storeu_si128((__m128i *)(dst + 2*f),     _mm_unpacklo_epi16(l, r));
+			_mm_storeu_si128((__m128i *)(dst + 2*f + 8), _mm_unpackhi_epi16(l, r));
+		}
+	} else {
+		for (f = 0; f < blocks; f += 8)
+			for (unsigned c = 0; c < channels; c++) {
+				short s[8] __attribute__((aligned(16)));
+				_mm_store_si128((__m128i *)s,
+				                convert8_sse2(src[c] + f, dither ? dither->state[c] : 0));
+				for (unsigned i = 0; i < 8; i++)
+					dst[(f + i) * channels + c] = s[i];
+			}
+	}
+
+	convert_tail(dst, src, channels, blocks, frames, dither);
+}
+
+
+__attribute__((target("sse2")))
+void Audio_out::mix_sse2(float *dst, float const *src, float gain, unsigned frames)
+{
+	unsigned const blocks = frames & ~3u;
+	__m128 const   g      = _mm_set1_ps(gain);
+
+	for (unsigned f = 0; f < blocks; f += 4)
+		_mm_storeu_ps(dst + f, _mm_add_ps(_mm_loadu_ps(dst + f),
+		                                  _mm_mul_ps(g, _mm_loadu_ps(src + f))));
+
+	mix_scalar(dst + blocks, src + blocks, gain, frames - blocks);
+}
+
+
+__attribute__((target("sse2")))
+float Audio_out::dot_sse2(float const *a, float const *b, unsigned n)
+{
+	/* two accumulators hide the latency of the adds */
+	__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+
+	for (unsigned i = 0; i < n; i += 8) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i),     _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+	}
+
+	__m128 s = _mm_add_ps(s0, s1);
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+
+/**********
+ ** AVX2 **
+ **********/
+
+__attribute__((target("avx2")))
+static inline __m256i xorshift_avx2(__m256i &s)
+{
+	s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 13));
+	s = _mm256_xor_si256(s, _mm256_srli_epi32(s, 17));
+	s = _mm256_xor_si256(s, _mm256_slli_epi32(s, 5));
+	return s;
+}
+
+
+/**
+ * Convert eight samples of one channel to S16
+ */
+__attribute__((target("avx2")))
+static inline __m128i convert8_avx2(float const *src, unsigned *state)
+{
+	__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_set1_ps(SCALE));
+
+	if (state) {
+		__m256i s = _mm256_loadu_si256((__m256i *)state);
+		__m256i a = _mm256_srli_epi32(xorshift_avx2(s), 8);
+		__m256i b = _mm256_srli_epi32(xorshift_avx2(s), 8);
+		_mm256_storeu_si256((__m256i *)state, s);
+		v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(a, b)),
+		                                   _mm256_set1_ps(DITHER_LSB)));
+	}
+
+	v = _mm256_min_ps(v, _mm256_set1_ps((float)S16_MAX));
+	v = _mm256_max_ps(v, _mm256_set1_ps((float)S16_MIN));
+
+	__m256 half = _mm256_or_ps(_mm256_and_ps(v, _mm256_set1_ps(-0.0f)),
+	                           _mm256_set1_ps(0.5f));
+	__m256i i = _mm256_cvttps_epi32(_mm256_add_ps(v, half));
+
+	return _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+}
+
+
+__attribute__((target("avx2")))
+void Audio_out::convert_avx2(short *dst, float const * const *src,
+                             unsigned channels, unsigned frames, Dither *dither)
+{
+	unsigned const blocks = frames & ~7u;
+	unsigned f;
+
+	if (channels == 2) {
+		unsigned *sl = dither ? dither->state[0] : 0;
+		unsigned *sr = dither ? dither->state[1] : 0;
+
+		for (f = 0; f < blocks; f += 8) {
+			__m128i l = convert8_avx2(src[0] + f, sl);
+			__m128i r = convert8_avx2(src[1] + f, sr);
+			_mm_storeu_si128((__m128i *)(dst + 2*f),     _mm_unpacklo_epi16(l, r));
+			_mm_storeu_si128((__m128i *)(dst + 2*f + 8), _mm_unpackhi_epi16(l, r));
+		}
+	} else {
+		for (f = 0; f < blocks; f += 8)
+			for (unsigned c = 0; c < channels; c++) {
+				short s[8] __attribute__((aligned(16)));
+				_mm_store_si128((__m128i *)s,
+				                convert8_avx2(src[c] + f, dither ? dither->state[c] : 0));
+				for (unsigned i = 0; i < 8; i++)
+					dst[(f + i) * channels + c] = s[i];
+			}
+	}
+
+	convert_tail(dst, src, channels, blocks, frames, dither);
+}
+
+
+__attribute__((target("avx2")))
+void Audio_out::mix_avx2(float *dst, float const *src, float gain, unsigned frames)
+{
+	unsigned const blocks = frames & ~7u;
+	__m256 const   g      = _mm256_set1_ps(gain);
+
+	/* separate multiply and add, FMA would round differently than scalar */
+	for (unsigned f = 0; f < blocks; f += 8)
+		_mm256_storeu_ps(dst + f, _mm256_add_ps(_mm256_loadu_ps(dst + f),
+		                                        _mm256_mul_ps(g, _mm256_loadu_ps(src + f))));
+
+	mix_scalar(dst + blocks, src + blocks, gain, frames - blocks);
+}
+
+
+__attribute__((target("avx2")))
+float Audio_out::dot_avx2(float const *a, float const *b, unsigned n)
+{
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+		                                     _mm256_loadu_ps(b + i)));
+		s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+		                                     _mm256_loadu_ps(b + i + 8)));
+	}
+	if (i < n)
+		s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+		                                     _mm256_loadu_ps(b + i)));
+
+	__m256 s8 = _mm256_add_ps(s0, s1);
+	__m128 s  = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+
+static bool cpu_has_sse2()
+{
+	unsigned a, b, c, d;
+	return __get_cpuid(1, &a, &b, &c, &d) && (d & bit_SSE2);
+}
+
+
+static bool cpu_has_avx2()
+{
+	unsigned a, b, c, d;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_OSXSAVE) || !(c & bit_AVX))
+		return false;
+
+	/* the OS must save the YMM state */
+	unsigned xcr0_lo, xcr0_hi;
+	asm volatile (".byte 0x0f, 0x01, 0xd0" /* xgetbv */
+	              : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+	if ((xcr0_lo & 6) != 6)
+		return false;
+
+	if (__get_cpuid_max(0, 0) < 7)
+		return false;
+
+	__cpuid_count(7, 0, a, b, c, d);
+	return b & bit_AVX2;
+}
+
+#else /* CONVERT_SIMD */
+
+void Audio_out::convert_sse2(short *dst, float const * const *src,
+                             unsigned channels, unsigned frames, Dither *dither)
+{
+	convert_scalar(dst, src, channels, frames, dither);
+}
+
+
+void Audio_out::convert_avx2(short *dst, float const * const *src,
+                             unsigned channels, unsigned frames, Dither *dither)
+{
+	convert_scalar(dst, src, channels, frames, dither);
+}
+
+
+void Audio_out::mix_sse2(float *dst, float const *src, float gain, unsigned frames)
+{
+	mix_scalar(dst, src, gain, frames);
+}
+
+
+void Audio_out::mix_avx2(float *dst, float const *src, float gain, unsigned frames)
+{
+	mix_scalar(dst, src, gain, frames);
+}
+
+
+float Audio_out::dot_sse2(float const *a, float const *b, unsigned n)
+{
+	return dot_scalar(a, b, n);
+}
+
+
+float Audio_out::dot_avx2(float const *a, float const *b, unsigned n)
+{
+	return dot_scalar(a, b, n);
+}
+
+
+static bool cpu_has_sse2() { return false; }
+static bool cpu_has_avx2() { return false; }
+
+#endif /* CONVERT_SIMD */
+
+
+Convert_kernel Audio_out::convert_kernel()
+{
+	if (cpu_has_avx2()) return convert_avx2;
+	if (cpu_has_sse2()) return convert_sse2;
+	return convert_scalar;
+}
+
+
+Mix_kernel Audio_out::mix_kernel()
+{
+	if (cpu_has_avx2()) return mix_avx2;
+	if (cpu_has_sse2()) return mix_sse2;
+	return mix_scalar;
+}
+
+
+Dot_kernel Audio_out::dot_kernel()
+{
+	if (cpu_has_avx2()) return dot_avx2;
+	if (cpu_has_sse2()) return dot_sse2;
+	return dot_scalar;
+}
+
+
+bool Audio_out::convert_simd_compiled()
+{
+#ifdef CONVERT_SIMD
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+const char *Audio_out::convert_kernel_name(Convert_kernel kernel)
+{
+	if (kernel == convert_avx2) return "AVX2";
+	if (kernel == convert_sse2) return "SSE2";
+	return "scalar";
+}
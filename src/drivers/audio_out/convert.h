@@ -0,0 +1,99 @@
+/*
+ * \brief  Mixing and conversion of float samples to interleaved S16 frames
+ * \date   2026-10-18
+ *
+ * The conversion kernels scale samples by 32767, optionally add TPDF dither of
+ * +/-1 LSB, saturate to the S16 range, round half away from zero, and
+ * interleave the channels into frames in one pass. All kernels produce
+ * bit-identical output, given that the scalar kernel is compiled with
+ * single-precision float arithmetic (SSE math).
+ *
+ * The mixing kernels accumulate scaled samples of one channel in float.
+ * Sums beyond full scale are saturated by the subsequent conversion.
+ *
+ * The dot-product kernels compute the FIR filter taps of the resampler.
+ * Their results differ from the scalar kernel in summation order only.
+ */
+
+#ifndef _AUDIO_OUT__CONVERT_H_
+#define _AUDIO_OUT__CONVERT_H_
+
+namespace Audio_out {
+
+	enum { MAX_CONVERT_CHANNELS = 8, DITHER_LANES = 8 };
+
+	/**
+	 * TPDF dither generator state
+	 *
+	 * Sample 'frame' of channel 'c' takes its dither from xorshift generator
+	 * 'frame % DITHER_LANES' of the channel. Vector kernels thereby advance
+	 * all generators of a channel at once.
+	 */
+	struct Dither
+	{
+		unsigned state[MAX_CONVERT_CHANNELS][DITHER_LANES];
+
+		explicit Dither(unsigned seed = 1);
+	};
+
+	/**
+	 * Conversion kernel
+	 *
+	 * \param dst       interleaved output of 'channels * frames' samples
+	 * \param src       one input buffer of 'frames' samples per channel
+	 * \param channels  number of channels, at most MAX_CONVERT_CHANNELS
+	 * \param dither    dither state, or 0 to convert without dither
+	 */
+	typedef void (*Convert_kernel)(short *dst, float const * const *src,
+	                               unsigned channels, unsigned frames,
+	                               Dither *dither);
+
+	void convert_scalar(short *, float const * const *, unsigned, unsigned, Dither *);
+	void convert_sse2  (short *, float const * const *, unsigned, unsigned, Dither *);
+	void convert_avx2  (short *, float const * const *, unsigned, unsigned, Dither *);
+
+	/**
+	 * Return fastest kernel supported by the CPU
+	 */
+	Convert_kernel convert_kernel();
+
+	const char *convert_kernel_name(Convert_kernel kernel);
+
+	/**
+	 * Return false if the SIMD kernels were compiled as scalar code
+	 */
+	bool convert_simd_compiled();
+
+	/**
+	 * Mixing kernel, computes 'dst[i] += gain * src[i]'
+	 */
+	typedef void (*Mix_kernel)(float *dst, float const *src, float gain,
+	                           unsigned frames);
+
+	void mix_scalar(float *, float const *, float, unsigned);
+	void mix_sse2  (float *, float const *, float, unsigned);
+	void mix_avx2  (float *, float const *, float, unsigned);
+
+	/**
+	 * Return fastest mixing kernel supported by the CPU
+	 */
+	Mix_kernel mix_kernel();
+
+	/**
+	 * Dot-product kernel
+	 *
+	 * \param n  number of elements, a multiple of 8
+	 */
+	typedef float (*Dot_kernel)(float const *a, float const *b, unsigned n);
+
+	float dot_scalar(float const *, float const *, unsigned);
+	float dot_sse2  (float const *, float const *, unsigned);
+	float dot_avx2  (float const *, float const *, unsigned);
+
+	/**
+	 * Return fastest dot-product kernel supported by the CPU
+	 */
+	Dot_kernel dot_kernel();
+}
+
+#endif /* _AUDIO_OUT__CONVERT_H_ */
@@ -7,6 +7,9 @@
 /* Linux */
 #include <linux/fs.h>
 #include <linux/major.h>
+#include <linux/poll.h>
+#include <linux/sched.h>
+#include <linux/wait.h>
 
 /* ALSA */
 #include <sound/driver.h>
@@ -72,13 +75,24 @@ static struct _sound_device *get_dev_by_fd(int fd)
 }
 
 
+static struct snd_pcm_runtime *get_runtime_by_dev(struct _sound_device *dev)
+{
+	struct snd_pcm_file *pcm_file = dev->file.private_data;
+
+	/* only PCM devices have a runtime */
+	if (strncmp(dev->name, "/dev/snd/pcm", 12) || !pcm_file || !pcm_file->substream)
+		return 0;
+
+	return pcm_file->substream->runtime;
+}
+
+
 char *dde_linux26_get_hwbuf_by_fd(int fd)
 {
-	struct file *file = &(get_dev_by_fd(fd))->file;
-	struct snd_pcm_file *pcm_file = file->private_data;
-	struct snd_pcm_substream *stream = pcm_file->substream;
+	struct _sound_device *dev = get_dev_by_fd(fd);
+	struct snd_pcm_runtime *runtime = dev ? get_runtime_by_dev(dev) : 0;
 
-	return stream->runtime->dma_area;
+	return runtime ? runtime->dma_area : 0;
 }
 
 
@@ -270,24 +284,105 @@ int ioctl(int fd, unsigned long int request, ...)
  * sys/poll.h
  */
 
+/**
+ * Poll table that enqueues the calling task in the wait queue of the device
+ */
+struct poll_wqueue_single
+{
+	poll_table         pt;
+	wait_queue_head_t *head;
+	wait_queue_t       wait;
+};
+
+
+static void poll_queue_proc(struct file *file, wait_queue_head_t *head, poll_table *pt)
+{
+	struct poll_wqueue_single *q = container_of(pt, struct poll_wqueue_single, pt);
+
+	/* devices poll on one wait queue only */
+	if (q->head)
+		return;
+
+	q->head = head;
+	init_waitqueue_entry(&q->wait, current);
+	add_wait_queue(head, &q->wait);
+}
+
+
+/*
+ * Only a single file descriptor is supported, which is all SALSA needs to
+ * wait for PCM buffer space.
+ */
 int poll(struct pollfd *fds, unsigned long nfds, int timeout)
 {
-	errno = EBADF;
-	return -1;
+	struct _sound_device *dev = nfds == 1 ? get_dev_by_fd(fds->fd) : 0;
+	struct poll_wqueue_single q;
+	signed long timeo;
+	unsigned int mask;
+
+	if (!dev || !dev->file.f_op->poll) {
+		errno = EBADF;
+		return -1;
+	}
+
+	init_poll_funcptr(&q.pt, poll_queue_proc);
+	q.head = 0;
+	timeo  = timeout < 0 ? MAX_SCHEDULE_TIMEOUT : msecs_to_jiffies(timeout);
+
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		mask  = dev->file.f_op->poll(&dev->file, &q.pt);
+		mask &= fds->events | POLLERR | POLLHUP | POLLNVAL;
+		if (mask || !timeo)
+			break;
+		timeo = schedule_timeout(timeo);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	if (q.head)
+		remove_wait_queue(q.head, &q.wait);
+
+	fds->revents = mask;
+	return mask ? 1 : 0;
 }
 
 /*
  * sys/mman.h
+ *
+ * The DMA buffer of a PCM device already resides in our address space and
+ * is "mapped" as is. Status and control records are not mapped, so SALSA
+ * falls back to SNDRV_PCM_IOCTL_SYNC_PTR for them.
  */
 
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
 {
-	errno = EBADF;
-	return MAP_FAILED;
+	struct _sound_device *dev = get_dev_by_fd(fd);
+	struct snd_pcm_runtime *runtime = dev ? get_runtime_by_dev(dev) : 0;
+
+	if (!runtime || offset != SNDRV_PCM_MMAP_OFFSET_DATA || !runtime->dma_area ||
+	    length > PAGE_ALIGN(runtime->dma_bytes)) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
+	return runtime->dma_area;
 }
 
 int munmap(void *addr, size_t length)
 {
+	int i;
+
+	for (i = 0; i < MAX_DEVICES; i++) {
+		struct snd_pcm_runtime *runtime;
+
+		if (!alsa_devices[i].fd)
+			continue;
+
+		runtime = get_runtime_by_dev(&alsa_devices[i]);
+		if (runtime && runtime->dma_area == addr)
+			return 0;
+	}
+
 	errno = EINVAL;
 	return -1;
 }
@@ -11,15 +11,24 @@
 #include <cap_session/connection.h>
 #include <audio_out_session/rpc_object.h>
 #include <util/misc_math.h>
+#include <util/list.h>
+#include <os/config.h>
+#include <timer_session/connection.h>
 
 extern "C" {
 #include <dde_linux26/audio.h>
 }
 
+#include "convert.h"
+#include "resample.h"
+
 using namespace Genode;
 
 static const bool verbose = false;
 
+/* add TPDF dither when converting to 16 bit */
+static const bool dither = true;
+
 static bool audio_out_active = false;
 
 namespace Audio_out {
@@ -28,15 +37,86 @@ namespace Audio_out {
 
 	enum Channel_number { LEFT, RIGHT, MAX_CHANNELS, INVALID = MAX_CHANNELS };
 
-	static Session_component *channel_acquired[MAX_CHANNELS];
-	Semaphore channel_sema;
+	enum {
+		SESSION_RATE = 44100,  /* sample rate of all sessions */
+		MAX_FRAMES   = PERIOD * Resampler::MAX_RATIO + 1,  /* per resampled period */
+	};
+
+	/* a period is resampled by one 'Resampler::process()' call */
+	typedef char Period_fits_resampler_input[PERIOD <= Resampler::MAX_INPUT ? 1 : -1];
 
-	class Session_component : public Session_rpc_object
+	/* sessions of all channels, guarded by 'session_lock' */
+	static List<Session_component> sessions;
+	static Lock                    session_lock;
+
+	/**
+	 * Statistics of the playback delay reported by ALSA
+	 *
+	 * The delay is sampled after each write to the hardware buffer and
+	 * reported once per second of played audio.
+	 */
+	class Latency_monitor
+	{
+		private:
+
+			unsigned           _rate;
+			unsigned long      _frames;   /* played since last report */
+			unsigned long      _samples;
+			unsigned long      _errors;
+			long               _min, _max;
+			unsigned long long _sum;
+
+			unsigned long _us(unsigned long long frames) const {
+				return (unsigned long)(frames * 1000000 / _rate); }
+
+			void _reset()
+			{
+				_frames = _samples = _errors = 0;
+				_min = _max = 0;
+				_sum = 0;
+			}
+
+		public:
+
+			Latency_monitor(unsigned rate) : _rate(rate) { _reset(); }
+
+			void sample(unsigned frames)
+			{
+				long delay = dde_linux26_audio_delay();
+
+				if (delay < 0)
+					_errors++;
+				else {
+					if (!_samples || delay < _min) _min = delay;
+					if (!_samples || delay > _max) _max = delay;
+					_sum += delay;
+					_samples++;
+				}
+
+				_frames += frames;
+				if (_frames < _rate)
+					return;
+
+				if (_samples)
+					PINF("playback delay min %lu avg %lu max %lu us (%lu samples, %lu errors)",
+					     _us(_min), _us(_sum / _samples), _us(_max), _samples, _errors);
+				else
+					PINF("playback delay unavailable (%lu errors)", _errors);
+
+				_reset();
+			}
+	};
+
+	class Session_component : public Session_rpc_object,
+	                          public List<Session_component>::Element
 	{
 		private:
 
 			Ram_dataspace_capability _ds;
 			Channel_number           _channel;
+			char                     _label[64];
+			float                    _gain;
+			bool                     _ready;  /* packet is mixed in this period */
 
 			Ram_dataspace_capability _alloc_dataspace(size_t size)
 			{
@@ -46,28 +126,47 @@ namespace Audio_out {
 
 		public:
 
-			Session_component(Channel_number channel, size_t buffer_size,
-			                  Rpc_entrypoint &ep)
-			: Session_rpc_object(_alloc_dataspace(buffer_size), ep), _channel(channel)
+			Session_component(Channel_number channel, const char *label,
+			                  float gain, size_t buffer_size, Rpc_entrypoint &ep)
+			: Session_rpc_object(_alloc_dataspace(buffer_size), ep),
+			  _channel(channel), _gain(gain), _ready(false)
 			{
-				Audio_out::channel_acquired[_channel] = this;
-				channel_sema.up();
+				strncpy(_label, label, sizeof(_label));
+
+				Lock::Guard guard(session_lock);
+				sessions.insert(this);
 			}
 
 			~Session_component()
 			{
-				channel_sema.down();
-				Audio_out::channel_acquired[_channel] = 0;
+				{
+					Lock::Guard guard(session_lock);
+					sessions.remove(this);
+				}
 
 				env()->ram_session()->free(_ds);
 			}
 
+			Channel_number channel_number() const { return _channel; }
+			float          gain()           const { return _gain; }
+
+			/**
+			 * Return true if both sessions belong to the same client
+			 */
+			bool same_client(Session_component const *other) const {
+				return !strcmp(_label, other->_label); }
+
+			bool ready()             const { return _ready; }
+			void ready(bool ready)         { _ready = ready; }
+
 			/*********************************
 			 ** Audio-out-session interface **
 			 *********************************/
 
 			void flush()
 			{
+				Lock::Guard guard(session_lock);
+
 				while (channel()->packet_avail())
 					channel()->acknowledge_packet(channel()->get_packet());
 			}
@@ -124,8 +223,6 @@ namespace Audio_out {
 			                                             "left");
 			if (!channel_number_from_string(channel_name, &channel_number))
 				throw Root::Invalid_args();
-			if (channel_acquired[channel_number])
-				throw Root::Unavailable();
 		}
 
 		void release() { }
@@ -145,6 +242,134 @@ namespace Audio_out {
 
 			Semaphore _startup_sema;  /* thread startup sync */
 
+			Convert_kernel _convert;  /* chosen at startup */
+			Mix_kernel     _mix;
+			Dither         _dither;
+
+			float _mix_buf[MAX_CHANNELS][PERIOD];
+			float _out_buf[MAX_CHANNELS][MAX_FRAMES];
+
+			Resampler *_resampler;  /* 0 if hardware runs at session rate */
+
+			Timer::Connection _timer;
+			unsigned          _idle_ms;  /* poll interval without packets */
+
+			unsigned const   _hw_channels;
+			unsigned const   _hw_period;  /* frames per write */
+			Latency_monitor *_latency;    /* 0 if not reporting */
+
+			void _sample_latency(unsigned frames)
+			{
+				if (_latency)
+					_latency->sample(frames);
+			}
+
+			/**
+			 * Convert frames and blocking-write them to ALSA
+			 */
+			void _play(float const * const *src, unsigned count)
+			{
+				static short data[MAX_CONVERT_CHANNELS * PERIOD];
+
+				for (unsigned done = 0; done < count; ) {
+					unsigned frames = min(min(_hw_period, (unsigned)PERIOD), count - done);
+
+					float const *chunk[MAX_CONVERT_CHANNELS];
+					for (unsigned i = 0; i < _hw_channels; ++i)
+						chunk[i] = src[i] + done;
+
+					_convert(data, chunk, _hw_channels, frames, dither ? &_dither : 0);
+
+					int err;
+					while ((err = dde_linux26_audio_play(data, frames)))
+						PWRN("Error %d during playback", err);
+
+					_sample_latency(frames);
+					done += frames;
+				}
+			}
+
+			/**
+			 * Convert frames directly into the hardware buffer
+			 */
+			void _play_mmap(float const * const *src, int count)
+			{
+				for (int done = 0; done < count; ) {
+					int    frames = count - done;
+					short *dst    = (short *)dde_linux26_audio_mmap_begin(&frames);
+					if (!dst) {
+						PWRN("Error during playback, dropping %d frames", count - done);
+						return;
+					}
+
+					float const *chunk[MAX_CONVERT_CHANNELS];
+					for (unsigned i = 0; i < _hw_channels; ++i)
+						chunk[i] = src[i] + done;
+
+					_convert(dst, chunk, _hw_channels, frames, dither ? &_dither : 0);
+					dde_linux26_audio_mmap_commit(frames);
+
+					_sample_latency(frames);
+					done += frames;
+				}
+			}
+
+			/**
+			 * Return true if all sessions of the client have a packet
+			 *
+			 * Mixing the channels of a client only together keeps them in
+			 * sync if the client submits them one after the other.
+			 */
+			bool _client_ready(Session_component *session)
+			{
+				for (Session_component *s = sessions.first(); s; s = s->next())
+					if (s->same_client(session) && !s->channel()->packet_avail())
+						return false;
+
+				return true;
+			}
+
+			/**
+			 * Mix one packet of each ready client into the mix buffers
+			 *
+			 * Clients without a packet do not stall the others but miss
+			 * the period.
+			 *
+			 * \return  false if no client had a packet
+			 */
+			bool _mix_period()
+			{
+				Lock::Guard guard(session_lock);
+
+				/* determine all ready sessions before consuming any packet */
+				bool any_ready = false;
+				for (Session_component *s = sessions.first(); s; s = s->next()) {
+					s->ready(_client_ready(s));
+					any_ready |= s->ready();
+				}
+
+				if (!any_ready)
+					return false;
+
+				memset(_mix_buf, 0, sizeof(_mix_buf));
+
+				for (Session_component *s = sessions.first(); s; s = s->next()) {
+					if (!s->ready())
+						continue;
+
+					Packet_descriptor p = s->channel()->get_packet();
+					if (!p.valid())
+						continue;
+
+					_mix(_mix_buf[s->channel_number()],
+					     s->channel()->packet_content(p), s->gain(), PERIOD);
+
+					s->channel()->acknowledge_packet(p);
+				}
+
+				return true;
+			}
+
 			void entry()
 			{
 				dde_linux26_audio_adopt_myself();
@@ -154,42 +379,76 @@ namespace Audio_out {
 
 				/* handle audio-out packets */
 				while (true) {
+					if (!_mix_period()) {
+						_timer.msleep(_idle_ms);
+						continue;
+					}
+
+					float const *src[MAX_CONVERT_CHANNELS];
+					unsigned     frames = PERIOD;
 					for (int i = 0; i < MAX_CHANNELS; ++i)
-						channel_sema.down();
+						src[i] = _mix_buf[i];
 
-					Session_component *left  = channel_acquired[LEFT],
-					                  *right = channel_acquired[RIGHT];
+					/* convert mix to the hardware rate */
+					if (_resampler) {
+						float *dst[MAX_CHANNELS];
+						for (int i = 0; i < MAX_CHANNELS; ++i)
+							dst[i] = _out_buf[i];
 
-					/* get packets for channels */
-					Packet_descriptor p[MAX_CHANNELS];
-					static short data[2 * PERIOD];
-					p[LEFT] = left->channel()->get_packet();
-					for (int i = 0; i < 2 * PERIOD; i += 2)
-						data[i] = left->channel()->packet_content(p[LEFT])[i / 2] * 32767;
-					p[RIGHT] = right->channel()->get_packet();
-					for (int i = 1; i < 2 * PERIOD; i += 2)
-						data[i] = right->channel()->packet_content(p[RIGHT])[i / 2] * 32767;
+						frames = _resampler->process(dst, src, PERIOD);
 
-					if (verbose)
-						PDBG("play packet");
+						for (int i = 0; i < MAX_CHANNELS; ++i)
+							src[i] = _out_buf[i];
+					}
 
-					/* blocking-write packet to ALSA */
-					int err;
-					if (audio_out_active)
-						while ((err = dde_linux26_audio_play(data, PERIOD)))
-							PWRN("Error %d during playback", err);
+					/* play silence on additional hardware channels */
+					static float const silence[MAX_FRAMES] = { 0 };
+					for (unsigned i = MAX_CHANNELS; i < _hw_channels; ++i)
+						src[i] = silence;
 
-					/* acknowledge packet to the client */
-					if (p[LEFT].valid())
-						left->channel()->acknowledge_packet(p[LEFT]);
-					if (p[RIGHT].valid())
-						right->channel()->acknowledge_packet(p[RIGHT]);
+					if (verbose)
+						PDBG("play packet");
 
-					for (int i = 0; i < MAX_CHANNELS; ++i)
-						channel_sema.up();
+					if (audio_out_active && dde_linux26_audio_mmap())
+						_play_mmap(src, frames);
+					else if (audio_out_active)
+						_play(src, frames);
 				}
 			}
 
+			/**
+			 * Determine gain of session from the policy matching its label
+			 *
+			 * The gain is specified in percent, e.g.,
+			 * '<policy label="player" gain="50"/>'.
+			 */
+			float _session_gain(const char *label)
+			{
+				try {
+					Xml_node config_node = config()->xml_node();
+					for (Xml_node policy = config_node.sub_node("policy"); ;
+					     policy = policy.next("policy")) {
+
+						char policy_label[64];
+						try {
+							policy.attribute("label").value(policy_label,
+							                                sizeof(policy_label));
+						} catch (Xml_node::Nonexistent_attribute) { continue; }
+
+						if (strcmp(label, policy_label))
+							continue;
+
+						unsigned long gain = 100;
+						policy.attribute("gain").value(&gain);
+						return gain / 100.0f;
+					}
+				} catch (Config::Invalid) {
+				} catch (Xml_node::Nonexistent_sub_node) {
+				} catch (Xml_node::Nonexistent_attribute) { }
+
+				return 1.0f;
+			}
+
 		protected:
 
 			Session_component *_create_session(const char *args)
@@ -207,15 +466,55 @@ namespace Audio_out {
 				                                             "left");
 				channel_number_from_string(channel_name, &channel_number);
 
+				char label[64];
+				Arg_string::find_arg(args, "label").string(label, sizeof(label), "");
+
+				float gain = _session_gain(label);
+				if (verbose)
+					PDBG("session \"%s\" (%s), gain %d%%",
+					     label, channel_name, (int)(gain * 100));
+
 				return new (md_alloc())
-					Session_component(channel_number, buffer_size, _channel_ep);
+					Session_component(channel_number, label, gain,
+					                  buffer_size, _channel_ep);
 			}
 
 		public:
 
-			Root(Rpc_entrypoint *session_ep, Allocator *md_alloc)
-			: Root_component(session_ep, md_alloc), _channel_ep(*session_ep)
+			/**
+			 * Constructor
+			 *
+			 * \param params          negotiated PCM configuration
+			 * \param quality         resampler quality if the hardware rate
+			 *                        differs from SESSION_RATE
+			 * \param report_latency  periodically log the playback delay
+			 */
+			Root(Rpc_entrypoint *session_ep, Allocator *md_alloc,
+			     dde_linux26_audio_params const &params,
+			     Resampler::Quality quality, bool report_latency)
+			: Root_component(session_ep, md_alloc), _channel_ep(*session_ep),
+			  _convert(convert_kernel()), _mix(mix_kernel()), _resampler(0),
+			  _idle_ms(max(1U, params.period_size * 1000 / max(1U, params.rate))),
+			  _hw_channels(params.channels), _hw_period(params.period_size),
+			  _latency(report_latency ? new (env()->heap()) Latency_monitor(params.rate) : 0)
 			{
+				if (verbose)
+					PDBG("using %s sample conversion", convert_kernel_name(_convert));
+
+				if (audio_out_active && params.rate != SESSION_RATE) {
+					_resampler = new (env()->heap())
+						Resampler(SESSION_RATE, params.rate, quality, MAX_CHANNELS);
+
+					if (_resampler->valid())
+						PINF("resampling from %u Hz to %u Hz", (unsigned)SESSION_RATE, params.rate);
+					else {
+						PWRN("cannot resample from %u Hz to %u Hz",
+						     (unsigned)SESSION_RATE, params.rate);
+						destroy(env()->heap(), _resampler);
+						_resampler = 0;
+					}
+				}
+
 				/* synchronize with root thread startup */
 				start();
 				_startup_sema.down();
@@ -224,23 +523,129 @@ namespace Audio_out {
 }
 
 
+static void config_value(Xml_node node, const char *name, unsigned *out)
+{
+	try {
+		unsigned long value = *out;
+		node.attribute(name).value(&value);
+		*out = value;
+	} catch (Xml_node::Nonexistent_attribute) { }
+}
+
+
+static void config_value(Xml_node node, const char *name, char *out, size_t out_len)
+{
+	try {
+		node.attribute(name).value(out, out_len);
+	} catch (Xml_node::Nonexistent_attribute) { }
+}
+
+
+static bool quality_from_string(const char                    *name,
+                                Audio_out::Resampler::Quality *out_quality)
+{
+	static struct Names {
+		const char                    *name;
+		Audio_out::Resampler::Quality  quality;
+	} names[] = {
+		{ "low", Audio_out::Resampler::LOW }, { "medium", Audio_out::Resampler::MEDIUM },
+		{ "high", Audio_out::Resampler::HIGH }, { 0, Audio_out::Resampler::LOW }
+	};
+
+	for (Names *n = names; n->name; ++n)
+		if (!strcmp(name, n->name)) {
+			*out_quality = n->quality;
+			return true;
+		}
+
+	return false;
+}
+
+
+/**
+ * Get PCM configuration, resampler quality and latency reporting from config
+ *
+ * Example:
+ *
+ *   <config rate="48000" channels="2" format="S16_LE"
+ *           period_size="128" periods="4" resampler="high"
+ *           latency_report="yes"/>
+ */
+static void process_config(dde_linux26_audio_params      *params,
+                           Audio_out::Resampler::Quality *quality,
+                           bool                          *report_latency)
+{
+	char format[16]   = "";
+	char resampler[8] = "medium";
+	char report[4]    = "no";
+
+	try {
+		Xml_node config_node = config()->xml_node();
+
+		config_value(config_node, "format",         format, sizeof(format));
+		config_value(config_node, "rate",           &params->rate);
+		config_value(config_node, "channels",       &params->channels);
+		config_value(config_node, "period_size",    &params->period_size);
+		config_value(config_node, "periods",        &params->periods);
+		config_value(config_node, "resampler",      resampler, sizeof(resampler));
+		config_value(config_node, "latency_report", report, sizeof(report));
+	} catch (Config::Invalid) { }
+
+	/* the conversion kernels produce 16-bit samples only */
+	if (format[0] && strcmp(format, "S16_LE"))
+		PWRN("unsupported format %s, using S16_LE", format);
+	params->format = "S16_LE";
+
+	params->channels    = max(1U, min(params->channels,
+	                                  (unsigned)Audio_out::MAX_CONVERT_CHANNELS));
+	params->period_size = max(1U, params->period_size);
+	params->periods     = max(2U, params->periods);
+
+	if (!quality_from_string(resampler, quality)) {
+		PWRN("unknown resampler quality %s, using medium", resampler);
+		*quality = Audio_out::Resampler::MEDIUM;
+	}
+
+	*report_latency = !strcmp(report, "yes");
+}
+
+
 int main(int argc, char **argv)
 {
 	enum { STACK_SIZE = 4096 };
 	static Cap_connection cap;
 	static Rpc_entrypoint ep(&cap, STACK_SIZE, "audio_ep");
 
+	/* defaults, about 46 ms of buffering */
+	dde_linux26_audio_params params;
+	params.format      = "S16_LE";
+	params.rate        = Audio_out::SESSION_RATE;
+	params.channels    = Audio_out::MAX_CHANNELS;
+	params.period_size = 256;
+	params.periods     = 8;
+
+	Audio_out::Resampler::Quality quality = Audio_out::Resampler::MEDIUM;
+	bool report_latency = false;
+	process_config(&params, &quality, &report_latency);
+
 	/* init ALSA */
-	int err = dde_linux26_audio_init();
+	int err = dde_linux26_audio_init(&params);
 	if (err) {
 		PERR("audio driver init returned %d", err);
+	} else if (params.channels > Audio_out::MAX_CONVERT_CHANNELS) {
+		PERR("unsupported number of hardware channels %u", params.channels);
 	} else {
+		PINF("%s, %u Hz, %u channel(s), %u periods of %u frames",
+		     params.format, params.rate, params.channels,
+		     params.periods, params.period_size);
+
 		dde_linux26_audio_start();
 		audio_out_active = true;
 	}
 
 	/* setup service */
-	static Audio_out::Root audio_root(&ep, env()->heap());
+	static Audio_out::Root audio_root(&ep, env()->heap(), params, quality,
+	                                  report_latency);
 	env()->parent()->announce(ep.manage(&audio_root));
 
 	sleep_forever();
@@ -0,0 +1,20 @@
+/*
+ * \brief  Replacement of the compiler's mm_malloc.h
+ * \date   2026-10-18
+ *
+ * The compiler's version is included by immintrin.h and depends on the C
+ * library's stdlib.h, which is not available when building with -nostdinc.
+ * Included before immintrin.h, this file takes the include guard of the
+ * compiler's version. The aligned allocation functions are declared only and
+ * must not be used.
+ */
+
+#ifndef _MM_MALLOC_H_INCLUDED
+#define _MM_MALLOC_H_INCLUDED
+
+extern "C" {
+	void *_mm_malloc(__SIZE_TYPE__ size, __SIZE_TYPE__ alignment);
+	void  _mm_free(void *ptr);
+}
+
+#endif /* _MM_MALLOC_H_INCLUDED */
@@ -0,0 +1,184 @@
+/*
+ * \brief  Polyphase sample-rate converter
+ * \date   2026-10-18
+ *
+ * The filter design runs once at construction and uses its own series
+ * approximations instead of libm.
+ */
+
+#include "resample.h"
+
+using namespace Audio_out;
+
+static const double PI = 3.14159265358979323846;
+
+
+static unsigned gcd(unsigned a, unsigned b)
+{
+	while (b) {
+		unsigned t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+
+double Audio_out::sine(double x)
+{
+	/* reduce to [-pi, pi], then to [-pi/2, pi/2] */
+	long k = (long)(x / (2 * PI) + (x < 0 ? -0.5 : 0.5));
+	x -= k * 2 * PI;
+	if (x >  PI / 2) x =  PI - x;
+	if (x < -PI / 2) x = -PI - x;
+
+	double x2 = x * x, term = x, sum = x;
+	for (unsigned i = 1; i < 10; i++) {
+		term *= -x2 / ((2 * i) * (2 * i + 1));
+		sum  += term;
+	}
+	return sum;
+}
+
+
+static double sinc(double x)
+{
+	return x == 0 ? 1.0 : sine(PI * x) / (PI * x);
+}
+
+
+static double square_root(double x)
+{
+	if (x <= 0)
+		return 0;
+
+	double r = x > 1 ? x : 1;
+	for (unsigned i = 0; i < 64; i++) {
+		double next = 0.5 * (r + x / r);
+		if (next >= r)
+			break;
+		r = next;
+	}
+	return r;
+}
+
+
+/**
+ * Modified Bessel function of the first kind, order zero
+ */
+static double bessel_i0(double x)
+{
+	double term = 1, sum = 1;
+
+	for (unsigned k = 1; k < 64 && term > sum * 1e-14; k++) {
+		double t = x / (2 * k);
+		term *= t * t;
+		sum  += term;
+	}
+	return sum;
+}
+
+
+/**
+ * Compute filter phases
+ *
+ * \param cutoff  -6 dB frequency relative to the input Nyquist frequency
+ * \param beta    Kaiser-window shape
+ */
+void Resampler::_design(double cutoff, double beta)
+{
+	double const center = _taps / 2 - 1;
+	double const i0_beta = bessel_i0(beta);
+
+	for (unsigned p = 0; p < _l; p++) {
+		double sum = 0;
+
+		for (unsigned t = 0; t < _taps; t++) {
+
+			/* distance of input frame 't' to output instant of phase 'p' */
+			double x = t - center - (double)p / _l;
+			double w = x / (_taps / 2);
+
+			double c = (w >= 1 || w <= -1) ? 0
+			         : cutoff * sinc(cutoff * x)
+			         * bessel_i0(beta * square_root(1 - w * w)) / i0_beta;
+
+			_coef[p][t] = (float)c;
+			sum += c;
+		}
+
+		/* unity DC gain for each phase */
+		for (unsigned t = 0; t < _taps; t++)
+			_coef[p][t] = (float)(_coef[p][t] / sum);
+	}
+}
+
+
+Resampler::Resampler(unsigned in_rate, unsigned out_rate, Quality quality,
+                     unsigned channels)
+:
+	_dot(dot_kernel()), _channels(channels), _taps(0), _l(1), _m(1),
+	_phase(0), _pos(0), _len(0), _valid(false)
+{
+	static const struct { unsigned taps; double beta; } levels[] = {
+		{ 16,  6.0 },  /* about 60 dB stopband attenuation */
+		{ 32,  8.6 },  /* about 85 dB */
+		{ 64, 10.6 },  /* about 105 dB */
+	};
+
+	if (!in_rate || !out_rate || channels > MAX_CHANNELS)
+		return;
+
+	unsigned const d = gcd(in_rate, out_rate);
+	_l = out_rate / d;
+	_m = in_rate  / d;
+
+	if (_l > MAX_PHASES || _l > MAX_RATIO * _m)
+		return;
+
+	_taps = levels[quality].taps;
+
+	/* the lower Nyquist frequency bounds the passband */
+	_design(_l < _m ? (double)_l / _m : 1.0, levels[quality].beta);
+
+	/* align the first output with the first input frame */
+	_len = _taps / 2 - 1;
+	for (unsigned c = 0; c < _channels; c++)
+		for (unsigned i = 0; i < _len; i++)
+			_hist[c][i] = 0;
+
+	_valid = true;
+}
+
+
+unsigned Resampler::process(float * const *dst, float const * const *src,
+                            unsigned frames)
+{
+	if (!_valid || frames > MAX_INPUT)
+		return 0;
+
+	for (unsigned c = 0; c < _channels; c++)
+		for (unsigned i = 0; i < frames; i++)
+			_hist[c][_len + i] = src[c][i];
+	_len += frames;
+
+	unsigned n = 0;
+	for (; _pos + _taps <= _len; n++) {
+		for (unsigned c = 0; c < _channels; c++)
+			dst[c][n] = _dot(_hist[c] + _pos, _coef[_phase], _taps);
+
+		_phase += _m;
+		_pos   += _phase / _l;
+		_phase %= _l;
+	}
+
+	/* keep the frames of the next filter window */
+	unsigned const shift = _pos < _len ? _pos : _len;
+	for (unsigned c = 0; c < _channels; c++)
+		for (unsigned i = shift; i < _len; i++)
+			_hist[c][i - shift] = _hist[c][i];
+	_len -= shift;
+	_pos -= shift;
+
+	return n;
+}
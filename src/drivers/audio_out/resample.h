@@ -0,0 +1,100 @@
+/*
+ * \brief  Polyphase sample-rate converter
+ * \date   2026-10-18
+ *
+ * The converter implements the rational ratio L/M of the output and input
+ * rates exactly. The prototype low-pass filter is a Kaiser-windowed sinc
+ * with its cutoff at the lower of both Nyquist frequencies, which confines
+ * aliasing to the transition band. It is split into L phases of 'taps'
+ * coefficients each, and every output sample is the dot product of one
+ * phase with the input history. The quality level selects the number of
+ * taps and the stopband attenuation.
+ *
+ * The converter uses static storage only and does not depend on Genode.
+ */
+
+#ifndef _AUDIO_OUT__RESAMPLE_H_
+#define _AUDIO_OUT__RESAMPLE_H_
+
+#include "convert.h"
+
+namespace Audio_out {
+
+	/**
+	 * Sine with an error below 1e-11, computed without libm
+	 */
+	double sine(double x);
+
+	class Resampler
+	{
+		public:
+
+			enum Quality { LOW, MEDIUM, HIGH };
+
+			enum {
+				MAX_CHANNELS = 2,
+				MAX_TAPS     = 64,
+				MAX_PHASES   = 640,   /* covers 44.1 kHz to 192 kHz */
+				MAX_INPUT    = 1024,  /* frames per process() call */
+				MAX_RATIO    = 8,     /* of output to input rate */
+			};
+
+		private:
+
+			Dot_kernel _dot;
+			unsigned   _channels;
+			unsigned   _taps;
+			unsigned   _l, _m;   /* output rate / input rate = L / M */
+			unsigned   _phase;   /* of next output, in 1/L input frames */
+			unsigned   _pos;     /* history index of next filter window */
+			unsigned   _len;     /* frames in history */
+			bool       _valid;
+
+			float _coef[MAX_PHASES][MAX_TAPS];
+			float _hist[MAX_CHANNELS][MAX_TAPS + MAX_INPUT];
+
+			void _design(double cutoff, double beta);
+
+		public:
+
+			/**
+			 * Constructor
+			 *
+			 * \param channels  number of channels, at most MAX_CHANNELS
+			 */
+			Resampler(unsigned in_rate, unsigned out_rate, Quality quality,
+			          unsigned channels);
+
+			/**
+			 * Return false if the rate ratio is not supported
+			 */
+			bool valid() const { return _valid; }
+
+			/**
+			 * Return number of filter taps per phase
+			 */
+			unsigned taps() const { return _taps; }
+
+			/**
+			 * Return maximum number of frames produced from 'frames'
+			 */
+			unsigned max_output(unsigned frames) const {
+				return (frames * _l + _m - 1) / _m + 1; }
+
+			/**
+			 * Convert frames
+			 *
+			 * Input frames are delayed by 'taps() / 2' frames.
+			 *
+			 * \param dst     one buffer per channel with room for
+			 *                'max_output(frames)' samples
+			 * \param src     one buffer per channel
+			 * \param frames  number of input frames, at most MAX_INPUT
+			 * \return        number of frames written to 'dst'
+			 */
+			unsigned process(float * const *dst, float const * const *src,
+			                 unsigned frames);
+	};
+}
+
+#endif /* _AUDIO_OUT__RESAMPLE_H_ */
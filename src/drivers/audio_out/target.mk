@@ -1,3 +1,3 @@
 TARGET  = audio_out_drv
 LIBS    = cxx env server signal dde_linux26_audio
-SRC_CC  = main.cc
+SRC_CC  = main.cc convert.cc resample.cc
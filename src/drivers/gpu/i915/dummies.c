@@ -226,14 +226,6 @@ void *i8xx_disable_fbc(void) { TRACE; return 0; }
 void *g4x_disable_fbc(void) { TRACE; return 0; }
 
 
-/********************
- ** Bit operations **
- ********************/
-
-int __test_bit(int nr, const volatile long *addr) { TRACE; return 0; }
-void __clear_bit(int nr, volatile long *addr) { TRACE; }
-
-
 /*********************
  ** linux/vmalloc.h **
  *********************/
@@ -255,7 +247,6 @@ int sysctl_vfs_cache_pressure;
 struct resource iomem_resource;
 
 
-int ffs(int x) { TRACE; return 0; }
 long time_after_eq(long a, long b) { TRACE; return 0; }
 unsigned long msecs_to_jiffies(const unsigned int m) { TRACE; return 0; }
 
@@ -183,77 +183,13 @@ int pci_register_driver(struct pci_driver *driver)
 int try_module_get(struct module *module) { TRACE; return 1; }
 
 
-/***********************
- ** Atomic operations **
- ***********************/
-
-/*
- * Actually not atomic, for now
- */
-
-void atomic_set(atomic_t *p, atomic_t v) { *p = v; }
-
-atomic_t atomic_read(atomic_t *p) { return *(volatile int *)p; }
-
-void atomic_inc(atomic_t *v) { (*(volatile int *)v)++; }
-void atomic_dec(atomic_t *v) { (*(volatile int *)v)--; }
-
-void atomic_add(int i, atomic_t *v) { (*(volatile int *)v) += i; }
-void atomic_sub(int i, atomic_t *v) { (*(volatile int *)v) -= i; }
-
-
-/********************
- ** Bit operations **
- ********************/
-
-/**
- * Find first zero bit at specified memory region
- *
- * \param  size_bits memory region size in bits
- */
-unsigned long find_first_zero_bit(const unsigned long *addr, unsigned long size_bits)
-{
-	TRACE;
-
-	enum { BITS_PER_LONG = sizeof(unsigned long)*8 };
-	unsigned long max_long = size_bits /= BITS_PER_LONG;
-	for (unsigned long i = 0; i < max_long; i++)
-		for (unsigned long j = 0, v = addr[i]; BITS_PER_LONG; j++)
-			if ((v & (1 << j)) == 0)
-				return i*BITS_PER_LONG + j;
-
-	return size_bits;  /* no bit found */
-}
-
-
-/**
- * Set specified bit in memory region
- */
-void __set_bit(int nr, volatile long *addr)
-{
-	TRACE;
-	unsigned long mask = sizeof(*addr)*8 - 1;
-	addr[nr / sizeof(*addr)] |= 1 << (nr & mask);
-}
-
-
 /**********************
  ** linux/spinlock.h **
  **********************/
 
-void spin_lock_init(spinlock_t *lock) { dde_kit_lock_init(lock); }
-void spin_lock(spinlock_t *lock)
-{
-	/*
-	 * If the spinlock was declared via the 'DEFINE_SPINLOCK' macro, it is not
-	 * yet initialized when first locked. So we do the initialization here as
-	 * needed.
-	 */
-	if (!*lock)
-		spin_lock_init(lock);
-	dde_kit_lock_lock(*lock);
-}
-void spin_unlock(spinlock_t *lock) { dde_kit_lock_unlock(*lock); }
+void spin_lock_init(spinlock_t *lock)   { dde_linux26_spin_lock_init(lock); }
+void spin_lock(spinlock_t *lock)        { dde_linux26_spin_lock_lock(lock); }
+void spin_unlock(spinlock_t *lock)      { dde_linux26_spin_lock_unlock(lock); }
 
 void spin_lock_irqsave(spinlock_t *lock, unsigned long flags) { spin_lock(lock); }
 void spin_unlock_irqrestore(spinlock_t *lock, unsigned long flags) { spin_unlock(lock); }
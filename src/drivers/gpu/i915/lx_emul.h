@@ -17,6 +17,10 @@ extern "C" {
 #include <dde_kit/panic.h>
 #include <dde_kit/lock.h>
 
+/* DDE Linux 2.6 includes */
+#include <dde_linux26/atomic.h>
+#include <dde_linux26/spin_lock.h>
+
 #define VERBOSE_LX_EMUL 0
 
 
@@ -55,14 +59,14 @@ enum { HZ = 100UL };
 
 typedef int atomic_t;
 
-void     atomic_set(atomic_t *p, atomic_t v);
-atomic_t atomic_read(atomic_t *p);
+static inline void     atomic_set(atomic_t *p, atomic_t v) { dde_linux26_atomic_set(p, v); }
+static inline atomic_t atomic_read(atomic_t *p) { return dde_linux26_atomic_read(p); }
 
-void     atomic_inc(atomic_t *v);
-void     atomic_dec(atomic_t *v);
+static inline void     atomic_inc(atomic_t *v) { dde_linux26_atomic_add_return(1, v); }
+static inline void     atomic_dec(atomic_t *v) { dde_linux26_atomic_sub_return(1, v); }
 
-void     atomic_add(int i, atomic_t *v);
-void     atomic_sub(int i, atomic_t *v);
+static inline void     atomic_add(int i, atomic_t *v) { dde_linux26_atomic_add_return(i, v); }
+static inline void     atomic_sub(int i, atomic_t *v) { dde_linux26_atomic_sub_return(i, v); }
 
 
 /*******************
@@ -367,21 +371,29 @@ static inline size_t roundup(size_t x, size_t y) { return ((x + y - 1)/y)*y; }
  ** linux/bitops.h, asm/bitops.h **
  **********************************/
 
-int __test_bit(int nr, const volatile long *addr);
-void __set_bit(int nr, volatile long *addr);
-void __clear_bit(int nr, volatile long *addr);
-unsigned long find_first_zero_bit(const unsigned long *addr, unsigned long size);
+/*
+ * The non-atomic variants are atomic as well
+ */
+#define set_bit(nr, addr)   dde_linux26_set_bit  (nr,       (volatile unsigned long *)(addr))
+#define clear_bit(nr, addr) dde_linux26_clear_bit(nr,       (volatile unsigned long *)(addr))
+#define test_bit(nr, addr)  dde_linux26_test_bit (nr, (const volatile unsigned long *)(addr))
+#define __set_bit(nr, addr)   set_bit(nr, addr)
+#define __clear_bit(nr, addr) clear_bit(nr, addr)
+
+#define test_and_set_bit(nr, addr) \
+	dde_linux26_test_and_set_bit(nr, (volatile unsigned long *)(addr))
+#define test_and_clear_bit(nr, addr) \
+	dde_linux26_test_and_clear_bit(nr, (volatile unsigned long *)(addr))
 
-#define set_bit(nr, addr)   __set_bit  (nr,       (volatile long *)(addr))
-#define clear_bit(nr, addr) __clear_bit(nr,       (volatile long *)(addr))
-#define test_bit(nr, addr)  __test_bit (nr, (const volatile long *)(addr))
+#define find_first_bit(addr, size)      dde_linux26_find_first_bit(addr, size)
+#define find_first_zero_bit(addr, size) dde_linux26_find_first_zero_bit(addr, size)
 
 /* copied from linux/bitops.h */
 #define BITS_PER_BYTE		8
 #define BITS_TO_LONGS(nr)	DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
 
 /* normally declared in asm-generic/bitops/ffs.h */
-int ffs(int x);
+static inline int ffs(int x) { return dde_linux26_ffs(x); }
 
 
 /********************
@@ -474,8 +486,8 @@ void *kmalloc(size_t size, gfp_t flags);
  * needed by drm_crtc.h
  */
 
-typedef struct dde_kit_lock *spinlock_t;
-#define DEFINE_SPINLOCK(name) spinlock_t name = 0;
+typedef struct dde_linux26_spin_lock spinlock_t;
+#define DEFINE_SPINLOCK(name) spinlock_t name = DDE_LINUX26_SPIN_LOCK_UNLOCKED;
 
 void spin_lock(spinlock_t *lock);
 void spin_unlock(spinlock_t *lock);
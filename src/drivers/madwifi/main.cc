@@ -13,12 +13,13 @@
 #include <cap_session/connection.h>
 #include <nic_session/rpc_object.h>
 #include <nic_session/client.h>
-#include <timer_session/connection.h>
+#include <dataspace/client.h>
 #include <os/config.h>
 
 /* DDE kit */
 extern "C" {
 #include <dde_kit/lock.h>
+#include <dde_kit/pgtab.h>
 #include <dde_kit/printf.h>
 #include <dde_kit/timer.h>
 #include <dde_linux26/general.h>
@@ -72,13 +73,192 @@ namespace Nic {
 
 	static Nic::Mac_address _mac_addr;
 
+	/* maximum time to wait for the association at session creation */
+	static unsigned long _assoc_timeout_ms = 8000;
+
+	/* link state of the wifi device */
+	static int           _wifi_idx = -1;
+	static volatile bool _link_up  = false;
+
 	/* declaration of local handlers */
 	static void dde_rx_handler(unsigned if_index,
-	                           const unsigned char *packet,
-	                           unsigned packet_len);
+	                           const dde_linux26_net_iovec *iov,
+	                           unsigned n);
 	static void dde_tx_handler(const char *essid);
 
 
+	/*
+	 * Receive buffers carved from the rx packet-stream dataspace
+	 *
+	 * The driver receives directly into these buffers, so received packets
+	 * are submitted to the client without copying. A buffer is referenced by
+	 * the driver until it frees the socket buffer and by each packet
+	 * submitted from it until the client acknowledges the packet. The lock
+	 * serializes all users of the rx block allocator.
+	 *
+	 * The dataspace is attached separately from the packet stream, as the
+	 * driver may still hold buffers when the session is closed. After
+	 * detach(), the object destroys itself once the driver released the
+	 * region.
+	 */
+	class Rx_buffers
+	{
+		public:
+
+			enum { BUFFER_LOG2 = 12, BUFFER_SIZE = 1 << BUFFER_LOG2 };
+
+		private:
+
+			Genode::Lock           _lock;
+			Genode::Allocator_avl *_alloc;  /* rx block allocator        */
+			char                  *_base;   /* local address of rx buffer */
+			Genode::size_t         _size;
+			unsigned short        *_refs;   /* references per buffer      */
+			int                    _if_index;  /* device using the buffers */
+
+			void _unref(Genode::addr_t offset)
+			{
+				Genode::addr_t i = offset >> BUFFER_LOG2;
+				if (--_refs[i] == 0)
+					_alloc->free((void *)(i << BUFFER_LOG2));
+			}
+
+			static void *_alloc_buffer(void *priv, unsigned size) {
+				return static_cast<Rx_buffers *>(priv)->alloc(size); }
+
+			static void _free_buffer(void *priv, void *buf) {
+				static_cast<Rx_buffers *>(priv)->free(buf); }
+
+			static void _release_region(void *priv) {
+				destroy(Genode::env()->heap(), static_cast<Rx_buffers *>(priv)); }
+
+			void _cleanup()
+			{
+				if (!_base)
+					return;
+
+				dde_kit_pgtab_clear_region(_base);
+				Genode::env()->rm_session()->detach(_base);
+				Genode::env()->heap()->free(_refs, (_size >> BUFFER_LOG2) * sizeof(*_refs));
+				_refs = 0;
+				_base = 0;
+			}
+
+		public:
+
+			Rx_buffers(Genode::Allocator_avl *alloc)
+			: _alloc(alloc), _base(0), _size(0), _refs(0), _if_index(-1) { }
+
+			~Rx_buffers() { _cleanup(); }
+
+			Genode::Lock &lock() { return _lock; }
+
+			/**
+			 * Provide buffers to the driver
+			 *
+			 * \param if_index  device allocating the receive buffers
+			 * \param ds        rx dataspace
+			 */
+			bool attach(int if_index, Genode::Dataspace_capability ds)
+			{
+				Genode::Dataspace_client ds_client(ds);
+				Genode::size_t           size = ds_client.size();
+				void                    *refs;
+
+				if (!Genode::env()->heap()->alloc((size >> BUFFER_LOG2) * sizeof(*_refs), &refs))
+					return false;
+				Genode::memset(refs, 0, (size >> BUFFER_LOG2) * sizeof(*_refs));
+
+				_refs = (unsigned short *)refs;
+				_size = size;
+				_base = Genode::env()->rm_session()->attach(ds);
+
+				dde_kit_pgtab_set_region_with_size(_base, ds_client.phys_addr(), _size);
+
+				dde_linux26_net_rx_buffer_alloc alloc;
+				alloc.base    = _base;
+				alloc.size    = _size;
+				alloc.alloc   = _alloc_buffer;
+				alloc.free    = _free_buffer;
+				alloc.release = _release_region;
+				alloc.priv    = this;
+				if (dde_linux26_net_register_rx_buffer_alloc(if_index, &alloc)) {
+					_cleanup();
+					return false;
+				}
+
+				_if_index = if_index;
+				return true;
+			}
+
+			/**
+			 * Withdraw buffers from the driver and destroy the object
+			 *
+			 * Buffers still held by the driver are freed to this object
+			 * later, which is destroyed after the last one.
+			 */
+			void detach()
+			{
+				if (_if_index < 0) {
+					destroy(Genode::env()->heap(), this);
+					return;
+				}
+
+				/* calls _release_region() as soon as the driver is done */
+				dde_linux26_net_unregister_rx_buffer_alloc(_if_index);
+			}
+
+			void *alloc(unsigned size)
+			{
+				Genode::Lock::Guard guard(_lock);
+
+				void *offset;
+				if (size > BUFFER_SIZE
+				 || !_alloc->alloc_aligned(BUFFER_SIZE, &offset, BUFFER_LOG2))
+					return 0;
+
+				_refs[(Genode::addr_t)offset >> BUFFER_LOG2] = 1;
+				return _base + (Genode::addr_t)offset;
+			}
+
+			void free(void *buf)
+			{
+				Genode::Lock::Guard guard(_lock);
+				_unref((char *)buf - _base);
+			}
+
+			bool contains(const unsigned char *data) const {
+				return _base && (char *)data >= _base && (char *)data < _base + _size; }
+
+			/**
+			 * Get packet referring to received data within a buffer
+			 */
+			Packet_descriptor packet(const unsigned char *data, Genode::size_t len)
+			{
+				Genode::Lock::Guard guard(_lock);
+
+				Genode::addr_t offset = (char *)data - _base;
+				_refs[offset >> BUFFER_LOG2]++;
+				return Packet_descriptor(offset, len);
+			}
+
+			/**
+			 * Release packet acknowledged by the client, lock must be held
+			 *
+			 * \return false if the packet does not refer to a buffer
+			 */
+			bool release(Packet_descriptor const &packet)
+			{
+				Genode::addr_t i = packet.offset() >> BUFFER_LOG2;
+				if (!_refs || !_refs[i])
+					return false;
+
+				_unref(packet.offset());
+				return true;
+			}
+	};
+
+
 	/*
 	 * Nic-session component class
 	 */
@@ -91,6 +271,7 @@ namespace Nic {
 			Genode::Dataspace_capability _rx_ds;         /* buffer for rx channel   */
 			Genode::Lock                 _startup_lock;  /* signals ready to submit */
 			const char                  *_essid;
+			Rx_buffers                  *_rx_buffers;
 
 		public:
 
@@ -98,23 +279,29 @@ namespace Nic {
 			 * Constructor
 			 *
 			 * \param tx_buf_size        buffer size for tx channel
-			 * \param rx_buf_size        buffer size for rx channel
+			 * \param rx_ds              buffer for rx channel
 			 * \param rx_block_alloc     rx block allocator
 			 * \param ep                 entry point used for packet stream
 			 */
-			Session_component(Genode::size_t          tx_buf_size,
-			                  Genode::size_t          rx_buf_size,
-			                  Genode::Allocator_avl  *rx_block_alloc,
-			                  const char             *essid,
-			                  Genode::Rpc_entrypoint &ep)
+			Session_component(Genode::size_t               tx_buf_size,
+			                  Genode::Dataspace_capability rx_ds,
+			                  Genode::Allocator_avl       *rx_block_alloc,
+			                  const char                  *essid,
+			                  Genode::Rpc_entrypoint      &ep)
 			: Session_rpc_object(Genode::env()->ram_session()->alloc(tx_buf_size),
-			                     Genode::env()->ram_session()->alloc(rx_buf_size),
+			                     rx_ds,
 			                     static_cast<Genode::Range_allocator *>(rx_block_alloc), ep),
-			  _startup_lock(Genode::Lock::LOCKED), _essid(essid) { }
+			  _rx_ds(rx_ds), _startup_lock(Genode::Lock::LOCKED), _essid(essid),
+			  _rx_buffers(new (Genode::env()->heap()) Rx_buffers(rx_block_alloc)) { }
+
+			~Session_component();
 
 			Mac_address  mac_address() { return _mac_addr;    }
 			Tx::Sink*    tx_sink()     { return _tx.sink();   }
 			Rx::Source*  rx_source()   { return _rx.source(); }
+			Rx_buffers  &rx_buffers()  { return *_rx_buffers; }
+
+			Genode::Dataspace_capability rx_ds() { return _rx_ds; }
 
 			/* thread entry function */
 			void entry() { dde_tx_handler(_essid); }
@@ -132,32 +319,87 @@ namespace Nic {
 	 */
 	static Session_component *_session = 0;
 
+	/* held while receiving, keeps '_session' from being destroyed */
+	static Genode::Lock _session_lock;
+
+
+	Session_component::~Session_component()
+	{
+		/* no further packets for this session */
+		dde_linux26_net_register_rx_burst_callback(0);
+		{
+			Genode::Lock::Guard guard(_session_lock);
+			_session = 0;
+		}
+
+		/* destroys the rx buffers once the driver released them */
+		_rx_buffers->detach();
+	}
+
 	/*
-	 * Callback function, called whenever data was received by the card.
+	 * Callback function, called with bursts of data received by the card.
 	 */
 	static void dde_rx_handler(unsigned if_index,
-	                           const unsigned char *packet,
-	                           unsigned packet_len)
+	                           const dde_linux26_net_iovec *iov,
+	                           unsigned n)
 	{
+		Genode::Lock::Guard session_guard(_session_lock);
+		if (!_session)
+			return;
+
 		Session_component::Rx::Source *rx_source = _session->rx_source();
-		try {
-			/* flush remaining acknowledgements */
-			while (rx_source->ack_avail())
-				rx_source->release_packet(rx_source->get_acked_packet());
-
-			/* allocate packet in rx channel */
-			Packet_descriptor packet_to_client =
-				rx_source->alloc_packet(packet_len);
-
-			/* copy received data to rx packet and submit it to our client */
-			Genode::memcpy(rx_source->packet_content(packet_to_client),
-			               packet, packet_len);
-			rx_source->submit_packet(packet_to_client);
-		} catch (Session_component::Rx::Source::Packet_alloc_failed) {
-			PWRN("transmit packet allocation failed, drop packet");
+		Rx_buffers                    &buffers   = _session->rx_buffers();
+
+		/* flush remaining acknowledgements once per burst */
+		{
+			Genode::Lock::Guard guard(buffers.lock());
+			while (rx_source->ack_avail()) {
+				Packet_descriptor packet = rx_source->get_acked_packet();
+				if (!buffers.release(packet))
+					rx_source->release_packet(packet);
+			}
+		}
+
+		for (unsigned i = 0; i < n; i++) {
+
+			/* received into an rx buffer - submit it without copying */
+			if (buffers.contains(iov[i].packet)) {
+				rx_source->submit_packet(buffers.packet(iov[i].packet,
+				                                        iov[i].packet_len));
+				continue;
+			}
+
+			try {
+				/* allocate packet in rx channel */
+				Packet_descriptor packet_to_client;
+				{
+					Genode::Lock::Guard guard(buffers.lock());
+					packet_to_client = rx_source->alloc_packet(iov[i].packet_len);
+				}
+
+				/* copy received data to rx packet and submit it to our client */
+				Genode::memcpy(rx_source->packet_content(packet_to_client),
+				               iov[i].packet, iov[i].packet_len);
+				rx_source->submit_packet(packet_to_client);
+			} catch (Session_component::Rx::Source::Packet_alloc_failed) {
+				PWRN("transmit packet allocation failed, drop %u packets", n - i);
+				return;
+			}
 		}
 	}
 
+	/*
+	 * Callback function, called on association and disassociation.
+	 */
+	static void dde_link_handler(unsigned if_index, int up)
+	{
+		if ((int)if_index != _wifi_idx)
+			return;
+
+		_link_up = up;
+		PINF("link %s", up ? "up" : "down");
+	}
+
 	/*
 	 * Server loop, initializes DDE subsystem,
 	 * waits for packets from the client and puts them into the card's buffer.
@@ -175,49 +417,76 @@ namespace Nic {
 		PDBG("    number of devices: %d", cnt);
 
 		PDBG("--- init rx_callbacks");
-		dde_linux26_net_register_rx_callback(dde_rx_handler);
+		dde_linux26_net_register_rx_burst_callback(dde_rx_handler);
 
 		/* get nic index of atheros card */
 		int idx = dde_linux26_wifi_atheros_idx();
 
+		_wifi_idx = idx;
+		dde_linux26_net_register_link_callback(dde_link_handler);
+
 		/* get mac address */
 		dde_linux26_net_get_mac_addr(idx, (unsigned char*)_mac_addr.addr);
 
+		/* let the card receive into the rx dataspace */
+		if (!_session->rx_buffers().attach(dde_linux26_wifi_atheros_phy_idx(),
+		                                   _session->rx_ds()))
+			PWRN("zero-copy receive not available");
+
 		/* set essid */
 		PDBG("Set essid to %s", essid);
 		dde_linux26_wifi_set_essid(idx, essid);
 
-		/* we need to wait until the card can associate with the AP */
-		Timer::Connection timer;
-		timer.msleep(8000);
+		/*
+		 * Wait until the card associated with the AP. If this takes longer,
+		 * the session starts nevertheless and the link comes up later.
+		 */
+		if (dde_linux26_wifi_wait_for_association(idx, _assoc_timeout_ms))
+			PWRN("no association within %lu ms", _assoc_timeout_ms);
 
 		/* signal that server is ready to handle requests from the client */
 		_session->ready();
 
 		Session_component::Tx::Sink *tx_sink = _session->tx_sink();
 
+		enum { BURST = DDE_LINUX26_NET_BURST_MAX };
+		Packet_descriptor     packets[BURST];
+		dde_linux26_net_iovec iov[BURST];
+
 		/* server loop, handling send packets of the client */
 		while (true) {
-			Packet_descriptor packet_from_client;
+			unsigned n = 0;
 
-			/* get packet, block until a packet is available */
-			packet_from_client = tx_sink->get_packet();
-			if (!packet_from_client.valid()) {
-				PWRN("received invalid packet");
-				continue;
+			/*
+			 * Block for the first packet only and gather all further
+			 * packets already submitted by the client into one burst.
+			 */
+			do {
+				Packet_descriptor packet_from_client = tx_sink->get_packet();
+				if (!packet_from_client.valid()) {
+					PWRN("received invalid packet");
+					continue;
+				}
+				packets[n]        = packet_from_client;
+				iov[n].packet     = (unsigned char*)
+					tx_sink->packet_content(packet_from_client);
+				iov[n].packet_len = packet_from_client.size();
+				n++;
+			} while (n < BURST && tx_sink->packet_avail());
+
+			/* send them to the network buffer, drop them without link */
+			if (_link_up) {
+				int sent = dde_linux26_net_tx_burst(idx, iov, n);
+				if (sent < (int)n)
+					PWRN("Sending %d of %u packets failed!", (int)n - max(sent, 0), n);
+			}
+
+			/* acknowledge packets to the client */
+			for (unsigned i = 0; i < n; i++) {
+				if (!tx_sink->ready_to_ack())
+					PDBG("need to wait until ready-for-ack");
+				tx_sink->acknowledge_packet(packets[i]);
 			}
-			size_t packet_size       = packet_from_client.size();
-			const unsigned char *src = (unsigned char*)
-				tx_sink->packet_content(packet_from_client);
-
-			/* send it to the network buffer */
-			if (dde_linux26_net_tx(idx, src, packet_size))
-				PWRN("Sending packet failed!");
-
-			/* acknowledge packet to the client */
-			if (!tx_sink->ready_to_ack())
-				PDBG("need to wait until ready-for-ack");
-			tx_sink->acknowledge_packet(packet_from_client);
 		}
 	}
 
@@ -276,7 +545,7 @@ namespace Nic {
 					new (md_alloc()) Allocator_avl(env()->heap());
 				Nic::_session =
 					new (md_alloc()) Session_component(tx_buf_size,
-				                                       rx_buf_size,
+				                                       env()->ram_session()->alloc(rx_buf_size),
 				                                       alloc, _essid, _ep);
 				Nic::_session->start();
 				Nic::_session->wait_for_completion();
@@ -294,7 +563,7 @@ namespace Nic {
 
 
 /**
- * Get name of the ESSID.
+ * Get name of the ESSID and association timeout.
  */
 static void process_config(char *essid, Genode::size_t sz)
 {
@@ -304,10 +573,10 @@ static void process_config(char *essid, Genode::size_t sz)
 
 	for (unsigned i = 0; i < config_node.num_sub_nodes(); ++i) {
 		Xml_node file_node = config_node.sub_node(i);
-		if (file_node.has_type("essid")) {
+		if (file_node.has_type("essid"))
 			file_node.value(essid, sz);
-			break;
-		}
+		if (file_node.has_type("assoc_timeout_ms"))
+			file_node.value(&Nic::_assoc_timeout_ms);
 	}
 }
 
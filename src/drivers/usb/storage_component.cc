@@ -6,16 +6,19 @@
  */
 
 #include <base/env.h>
+#include <base/lock.h>
 #include <base/printf.h>
 #include <base/rpc_server.h>
+#include <base/semaphore.h>
 #include <block_session/rpc_object.h>
+#include <dataspace/client.h>
 #include <os/ring_buffer.h>
 #include <root/component.h>
 #include <util/xml_node.h>
-#include <timer_session/connection.h>
 
 extern "C" {
 #include <dde_kit/lock.h>
+#include <dde_kit/pgtab.h>
 #include <dde_kit/thread.h>
 #include <dde_linux26/general.h>
 #include <dde_linux26/block.h>
@@ -28,12 +31,27 @@ using namespace Genode;
  * Startup synchronization
  */
 static struct dde_kit_lock *plugin_lock;
-static int current_index = -1;
+static int current_index = -1;  /* most recently plugged device */
+
+/**
+ * Block cache configuration, disabled if 'cache_size' is 0
+ */
+static Genode::size_t cache_size = 0;
+static unsigned long  cache_readahead = 0;
 
 static void plugin_handler(int usb_index)
 {
+	bool first = (current_index < 0);
+
+	PINF("USB storage device %d (LUN %d) with %lld blocks plugged in",
+	     usb_index, dde_linux26_block_lun(usb_index),
+	     dde_linux26_block_count(usb_index));
+
 	current_index = usb_index;
-	dde_kit_lock_unlock(plugin_lock);
+
+	/* open barrier for session creation */
+	if (first)
+		dde_kit_lock_unlock(plugin_lock);
 }
 
 
@@ -45,14 +63,290 @@ namespace Block {
 
 			/**
 			 * Thread handling the requests of an open block session.
+			 *
+			 * Packets are passed to the device's request queue as soon as
+			 * they arrive and are acknowledged by the ack thread after
+			 * completion, possibly out of order. The device accesses the
+			 * packet payload directly via DMA if possible and uses a bounce
+			 * buffer otherwise.
 			 */
 			class Tx_thread : public Thread<8192>
 			{
 				private:
 
+					enum { MAX_REQUESTS = 32 };
+
+					/**
+					 * Packet in flight
+					 */
+					struct Request
+					{
+						Tx_thread               *thread;
+						Block::Packet_descriptor packet;
+						unsigned char           *buffer;  /* bounce buffer or 0 */
+						int                      error;
+						Request                 *next;  /* free or completed list */
+					};
+
+					/**
+					 * Thread acknowledging completed requests
+					 *
+					 * Acknowledging a packet blocks while the client's ack
+					 * queue is full. The completion callback runs on the
+					 * device's request dispatcher, which must never block on
+					 * a client, and the tx thread blocks in 'get_packet()',
+					 * so completed requests are handed over to this thread.
+					 */
+					class Ack_thread : public Thread<8192>
+					{
+						private:
+
+							Tx_thread *_tx_thread;
+
+						public:
+
+							Ack_thread(Tx_thread *tx_thread)
+							: Thread<8192>("ack_thread"), _tx_thread(tx_thread) { }
+
+							void entry()
+							{
+								dde_linux26_process_add_worker("ack_thread");
+
+								while (true)
+									_tx_thread->_ack_completed();
+							}
+					};
+
 					Session_component *_session;  /* corresponding session object */
 					int                _usb_index;
-					Timer::Connection  _timer;
+					size_t             _block_size;  /* device block size in bytes */
+
+					Request    _requests[MAX_REQUESTS];
+					Request   *_free_requests;
+					Lock       _free_lock;
+					Semaphore  _free_sema;      /* count of free requests */
+					Lock       _ack_lock;
+					Lock       _io_lock;        /* held while handling a packet */
+
+					Request   *_completed;       /* completed, not acknowledged */
+					Request  **_completed_tail;
+					Lock       _completed_lock;
+					Semaphore  _completed_sema;  /* count of completed requests */
+					Ack_thread _ack_thread;
+
+					void      *_dma_base;       /* local address of tx buffer */
+					unsigned   _zero_copy_count;
+					unsigned   _bounce_count;
+
+					/**
+					 * Make tx buffer known to the DDE kit page table
+					 *
+					 * The local address of the buffer is known to the
+					 * packet stream only, so we derive it from the first
+					 * packet.
+					 */
+					void _register_dma_region(Block::Packet_descriptor &packet)
+					{
+						if (_dma_base || !_session->_tx_ds_phys)
+							return;
+
+						_dma_base = (char *)_session->tx_sink()->packet_content(packet)
+						          - packet.offset();
+
+						dde_kit_pgtab_set_region_with_size(_dma_base,
+						                                   _session->_tx_ds_phys,
+						                                   _session->_tx_ds_size);
+					}
+
+					/**
+					 * Get request object, block if all are in flight
+					 */
+					Request *_alloc_request(Block::Packet_descriptor &packet)
+					{
+						_free_sema.down();
+
+						Lock::Guard guard(_free_lock);
+						Request *r = _free_requests;
+						_free_requests = r->next;
+
+						r->packet = packet;
+						r->buffer = 0;
+						r->error  = 0;
+						return r;
+					}
+
+					void _free_request(Request *r)
+					{
+						if (r->buffer)
+							dde_linux26_block_free(r->buffer);
+
+						{
+							Lock::Guard guard(_free_lock);
+							r->next = _free_requests;
+							_free_requests = r;
+						}
+
+						_free_sema.up();
+					}
+
+					/**
+					 * Acknowledge packet to the client
+					 */
+					void _ack(Block::Packet_descriptor &packet, bool success)
+					{
+						Lock::Guard guard(_ack_lock);
+
+						Session_component::Tx::Sink *tx_sink =
+							_session->tx_sink();
+
+						packet.succeeded(success);
+
+						if (!tx_sink->ready_to_ack())
+							PDBG("need to wait until ready-for-ack");
+						tx_sink->acknowledge_packet(packet);
+					}
+
+					/**
+					 * Acknowledge the oldest completed request, block if none
+					 */
+					void _ack_completed()
+					{
+						_completed_sema.down();
+
+						Request *r;
+						{
+							Lock::Guard guard(_completed_lock);
+							r = _completed;
+							_completed = r->next;
+							if (!_completed)
+								_completed_tail = &_completed;
+						}
+
+						_ack(r->packet, !r->error);
+						_free_request(r);
+					}
+
+					/**
+					 * Completion callback of the device's request queue
+					 *
+					 * Runs on the request dispatcher and hands the request
+					 * over to the ack thread.
+					 */
+					static void _complete(void *priv, int error)
+					{
+						Request   *r      = static_cast<Request *>(priv);
+						Tx_thread *thread = r->thread;
+
+						if (error)
+							PWRN("block request %zd-%zd failed with error %d",
+							     r->packet.block_number(),
+							     r->packet.block_number() + r->packet.block_count(),
+							     error);
+
+						/* copy block content from bounce buffer to packet payload */
+						if (!error && r->buffer
+						 && r->packet.operation() == Block::Packet_descriptor::READ)
+							memcpy(thread->_session->tx_sink()->packet_content(r->packet),
+							       r->buffer, r->packet.block_count() * thread->_block_size);
+
+						r->error = error;
+						r->next  = 0;
+						{
+							Lock::Guard guard(thread->_completed_lock);
+							*thread->_completed_tail = r;
+							thread->_completed_tail  = &r->next;
+						}
+						thread->_completed_sema.up();
+					}
+
+					/**
+					 * Handle packet synchronously via the block cache
+					 */
+					void _cached_io(Block::Packet_descriptor &packet, bool write)
+					{
+						void *content = _session->tx_sink()->packet_content(packet);
+
+						int ret = write
+						        ? dde_linux26_block_cache_write(_usb_index,
+						                                        packet.block_number(),
+						                                        packet.block_count(),
+						                                        content)
+						        : dde_linux26_block_cache_read(_usb_index,
+						                                       packet.block_number(),
+						                                       packet.block_count(),
+						                                       content);
+						if (ret)
+							PWRN("dde_linux26_block_cache_%s returned error %d",
+							     write ? "write" : "read", ret);
+
+						_ack(packet, ret == 0);
+					}
+
+					/**
+					 * Pass packet to the device's request queue
+					 *
+					 * \return true if the packet was queued
+					 */
+					bool _submit(Block::Packet_descriptor &packet)
+					{
+						Session_component::Tx::Sink *tx_sink =
+							_session->tx_sink();
+
+						bool write;
+						switch (packet.operation()) {
+						case Block::Packet_descriptor::READ:  write = false; break;
+						case Block::Packet_descriptor::WRITE: write = true;  break;
+						default:
+							PWRN("unsupported operation");
+							return false;
+						}
+
+						if (dde_linux26_block_cache_enabled(_usb_index)) {
+							_cached_io(packet, write);
+							return true;
+						}
+
+						Request *r = _alloc_request(packet);
+
+						size_t  size    = packet.block_count() * _block_size;
+						void   *content = tx_sink->packet_content(packet);
+						void   *buffer  = content;
+
+						if (dde_linux26_block_dma_capable(_usb_index, content, size))
+							_zero_copy_count++;
+
+						else {
+							if (_bounce_count++ == 0)
+								PWRN("packet payload at %p not usable for DMA, using bounce buffer",
+								     content);
+
+							r->buffer = (unsigned char*)dde_linux26_block_malloc(size);
+
+							if (!r->buffer) {
+								_free_request(r);
+								return false;
+							}
+
+							/* copy packet payload to block content */
+							if (write)
+								memcpy(r->buffer, content, size);
+
+							buffer = r->buffer;
+						}
+
+						int ret = dde_linux26_block_submit(_usb_index,
+						                                   packet.block_number(),
+						                                   packet.block_count(),
+						                                   buffer, write,
+						                                   _complete, r);
+						if (ret) {
+							PWRN("dde_linux26_block_submit returned error %d", ret);
+							_free_request(r);
+							return false;
+						}
+
+						return true;
+					}
 
 				public:
 
@@ -63,7 +357,24 @@ namespace Block {
 					          int                usb_index)
 					: Thread<8192>("tx_thread"),
 					  _session(session),
-					  _usb_index(usb_index) { }
+					  _usb_index(usb_index),
+					  _block_size(dde_linux26_block_size(usb_index)),
+					  _free_requests(0),
+					  _free_sema(MAX_REQUESTS),
+					  _completed(0),
+					  _completed_tail(&_completed),
+					  _completed_sema(0),
+					  _ack_thread(this),
+					  _dma_base(0),
+					  _zero_copy_count(0),
+					  _bounce_count(0)
+					{
+						for (unsigned i = 0; i < MAX_REQUESTS; i++) {
+							_requests[i].thread = this;
+							_requests[i].next   = _free_requests;
+							_free_requests      = &_requests[i];
+						}
+					}
 
 					/**
 					 * Thread's entry function.
@@ -76,6 +387,8 @@ namespace Block {
 							_session->tx_sink();
 						Block::Packet_descriptor packet;
 
+						_ack_thread.start();
+
 						/* signal preparedness to server activation */
 						_session->tx_ready();
 
@@ -89,6 +402,9 @@ namespace Block {
 								continue;
 							}
 
+							/* blocks forever once the session is closed */
+							Lock::Guard io_guard(_io_lock);
+
 							/* sanity check block number */
 							if ((packet.block_number() + packet.block_count()
 								 > (Genode::size_t)dde_linux26_block_count(_usb_index))
@@ -99,79 +415,43 @@ namespace Block {
 								continue;
 							}
 
-							switch (packet.operation()) {
-							case Block::Packet_descriptor::READ:
-								{
-									size_t size = packet.block_count() * 512;
-									unsigned char *dde_blocks = (unsigned char*)dde_linux26_block_malloc(size);
-
-									if (!dde_blocks) {
-										packet.succeeded(false);
-										break;
-									}
-
-									for (Genode::size_t i = 0; i < packet.block_count(); i++) {
-										for (;;) {
-											int ret = dde_linux26_block_read(_usb_index, packet.block_number() + i,
-											                                 &dde_blocks[i * 512]);
-											/* block reading suceeded */
-											if (ret == 0)
-												break;
-
-											PWRN("dde_linux26_block_read returned error %d", ret);
-
-											if (ret == -EBLK_BUSY)
-												_timer.msleep(10);
-										}
-									}
-
-									/* copy block content to packet payload */
-									memcpy(tx_sink->packet_content(packet),
-									       dde_blocks, size);
-
-									dde_linux26_block_free(dde_blocks);
-
-									packet.succeeded(true);
-									break;
-								}
-							case Block::Packet_descriptor::WRITE:
-								{
-									size_t size = packet.block_count() * 512;
-									unsigned char *dde_blocks = (unsigned char*)dde_linux26_block_malloc(size);
-
-									if (!dde_blocks) {
-										packet.succeeded(false);
-										break;
-									}
-
-									/* copy packet payload to block content */
-									memcpy(dde_blocks, tx_sink->packet_content(packet), size);
-
-									for (Genode::size_t i = 0; i < packet.block_count(); i++)
-										dde_linux26_block_write(_usb_index, packet.block_number() + i,
-										                        &dde_blocks[i * 512]);
-
-									dde_linux26_block_free(dde_blocks);
-
-									packet.succeeded(true);
-									break;
-								}
-							default:
-								PWRN("unsupported operation");
-								packet.succeeded(false);
+							/* sanity check payload size, which is in bytes */
+							if (packet.block_count() * _block_size > packet.size()) {
+								PWRN("payload of %zd bytes too small for %zd blocks of %zd bytes",
+								     packet.size(), packet.block_count(), _block_size);
+								_ack(packet, false);
 								continue;
 							}
 
-							/* acknowledge packet to the client */
-							if (!tx_sink->ready_to_ack())
-								PDBG("need to wait until ready-for-ack");
-							tx_sink->acknowledge_packet(packet);
+							_register_dma_region(packet);
+
+							/* completed requests are acknowledged by the ack thread */
+							if (!_submit(packet))
+								_ack(packet, false);
 						}
 					}
 
+					/**
+					 * Stop handling packets and wait for requests in flight
+					 *
+					 * Afterwards, the tx and ack threads are blocked outside
+					 * of DDE Linux and no completion callback is pending,
+					 * so the threads and the session can be destroyed.
+					 */
+					void stop()
+					{
+						_io_lock.lock();
+
+						for (unsigned i = 0; i < MAX_REQUESTS; i++)
+							_free_sema.down();
+					}
+
 					friend class Session_component;
+					friend class Ack_thread;
 			};
 
+			Genode::addr_t _tx_ds_phys;
+			Genode::size_t _tx_ds_size;
 			int       _usb_index;
 			Semaphore _startup_sema;  /* thread startup sync */
 			Tx_thread _tx_thread;     /* thread handling block requests */
@@ -189,6 +469,8 @@ namespace Block {
 			                  Genode::Rpc_entrypoint *ep,
 			                  int usb_index)
 			: Session_rpc_object(tx_ds, *ep),
+			  _tx_ds_phys(Genode::Dataspace_client(tx_ds).phys_addr()),
+			  _tx_ds_size(Genode::Dataspace_client(tx_ds).size()),
 			  _usb_index(usb_index),
 			  _startup_sema(0),
 			  _tx_thread(this, _usb_index)
@@ -199,6 +481,30 @@ namespace Block {
 				_startup_sema.down();
 			}
 
+			~Session_component()
+			{
+				struct dde_linux26_block_cache_stats stats;
+
+				/* requests in flight refer to the packet buffer and the sink */
+				_tx_thread.stop();
+
+				if (dde_linux26_block_cache_flush(_usb_index))
+					PERR("block cache write-back failed");
+
+				if (dde_linux26_block_cache_stats(_usb_index, &stats) == 0)
+					PINF("block cache: %lu hits, %lu misses, %lu blocks read ahead, "
+					     "%lu writes, %lu write-backs",
+					     stats.hits, stats.misses, stats.readahead,
+					     stats.writes, stats.writebacks);
+
+				/* no zero-copy request targets the packet buffer after stop() */
+				if (_tx_thread._dma_base)
+					dde_kit_pgtab_clear_region(_tx_thread._dma_base);
+
+				PINF("%u packets transferred via DMA, %u via bounce buffer",
+				     _tx_thread._zero_copy_count, _tx_thread._bounce_count);
+			}
+
 			/**
 			 * Signal indicating that transmit thread is ready
 			 */
@@ -212,28 +518,82 @@ namespace Block {
 			void info(size_t *blk_count, size_t *blk_size, Operations *ops)
 			{
 				*blk_count = dde_linux26_block_count(_usb_index);
-				*blk_size  = 512;
+				*blk_size  = dde_linux26_block_size(_usb_index);
 				ops->set_operation(Block::Packet_descriptor::READ);
 				ops->set_operation(Block::Packet_descriptor::WRITE);
 			}
 	};
 
 
-	/*
-	 * Shortcut for single-client root component
-	 */
-	typedef Root_component<Session_component, Single_client> Root_component;
-
-
 	/**
 	 * Root component, handling new session requests
+	 *
+	 * Each device (i.e., logical unit) is served by sessions of its own. The
+	 * device of a session is selected by the 'device' session argument or by
+	 * a '<policy label="..." device="..."/>' node of the storage
+	 * configuration. Sessions without a device selection get the most
+	 * recently plugged device.
 	 */
-	class Root : public Root_component
+	class Root : public Root_component<Session_component>
 	{
+		private:
+
+			enum { PLUGIN_TIMEOUT_MS = 5000 };
+
+			Xml_node _config;
+
+			/**
+			 * Determine device index of session
+			 */
+			int _device_index(const char *args)
+			{
+				long index = Arg_string::find_arg(args, "device").long_value(-1);
+				if (index >= 0)
+					return index;
+
+				char label[64];
+				Arg_string::find_arg(args, "label").string(label, sizeof(label), "");
+
+				try {
+					for (Xml_node policy = _config.sub_node("policy"); ;
+					     policy = policy.next("policy")) {
+
+						char policy_label[64];
+						try {
+							policy.attribute("label").value(policy_label,
+							                                sizeof(policy_label));
+						} catch (Xml_node::Nonexistent_attribute) { continue; }
+
+						if (strcmp(label, policy_label))
+							continue;
+
+						unsigned long device = 0;
+						policy.attribute("device").value(&device);
+						return device;
+					}
+				} catch (Xml_node::Nonexistent_sub_node) {
+				} catch (Xml_node::Nonexistent_attribute) {
+					PWRN("policy for \"%s\" lacks 'device' attribute", label);
+				}
+
+				return current_index;
+			}
+
 		protected:
 
 			Session_component *_create_session(const char *args)
 			{
+				/*
+				 * Block-cache setup and write-back block in DDE Linux and
+				 * run on the entrypoint during session creation and
+				 * destruction, so the entrypoint must be a DDE worker.
+				 */
+				static bool ep_is_worker = false;
+				if (!ep_is_worker) {
+					dde_linux26_process_add_worker("usb_ep");
+					ep_is_worker = true;
+				}
+
 				size_t ram_quota =
 					Arg_string::find_arg(args, "ram_quota"  ).ulong_value(0);
 				size_t tx_buf_size =
@@ -262,16 +622,29 @@ namespace Block {
 				/*
 				 * Prepare for a subsequenting session creation
 				 *
-				 * Even though only one open USB block session is supported at
-				 * a time, a client may open, close, and re-open sessions. To
-				 * let not only the first session creation succeed, we need to
-				 * clear the barrier.
+				 * To let not only the first session creation succeed, we need
+				 * to clear the barrier.
 				 */
 				dde_kit_lock_unlock(plugin_lock);
 
+				/* other devices may still be in the process of enumeration */
+				int usb_index = _device_index(args);
+				for (unsigned ms = 0; !dde_linux26_block_present(usb_index)
+				                   && ms < PLUGIN_TIMEOUT_MS; ms += 100)
+					dde_kit_thread_msleep(100);
+
+				if (!dde_linux26_block_present(usb_index)) {
+					PERR("USB storage device %d not present", usb_index);
+					throw Root::Unavailable();
+				}
+
+				if (cache_size && dde_linux26_block_cache_init(usb_index, cache_size,
+				                                               cache_readahead))
+					PWRN("could not enable block cache");
+
 				return new (md_alloc())
 				       Session_component(env()->ram_session()->alloc(tx_buf_size),
-				                         ep(), current_index);
+				                         ep(), usb_index);
 			}
 
 		public:
@@ -281,20 +654,35 @@ namespace Block {
 			 *
 			 * \param session_ep  session entrypoint
 			 * \param md_alloc    meta-data allocator
-			 * \param usb_index
+			 * \param config      storage configuration node
 			 */
-			Root(Rpc_entrypoint *session_ep, Allocator *md_alloc)
-			: Root_component(session_ep, md_alloc) { }
+			Root(Rpc_entrypoint *session_ep, Allocator *md_alloc, Xml_node config)
+			: Root_component<Session_component>(session_ep, md_alloc),
+			  _config(config) { }
 	};
 }
 
 
 void start_storage_service(Rpc_entrypoint *ep, Xml_node storage_subnode)
 {
+	try {
+		Genode::Number_of_bytes size = 0;
+		storage_subnode.attribute("cache_size").value(&size);
+		cache_size = size;
+	} catch (Xml_node::Nonexistent_attribute) { }
+
+	try {
+		storage_subnode.attribute("readahead").value(&cache_readahead);
+	} catch (Xml_node::Nonexistent_attribute) { }
+
+	if (cache_size)
+		PINF("block cache of %zd bytes, read-ahead %lu blocks",
+		     cache_size, cache_readahead);
+
 	dde_kit_lock_init(&plugin_lock);
 	dde_kit_lock_lock(plugin_lock);
 	dde_linux26_block_register_plugin_callback(plugin_handler);
 
-	static Block::Root blk_root(ep, env()->heap());
+	static Block::Root blk_root(ep, env()->heap(), storage_subnode);
 	env()->parent()->announce(ep->manage(&blk_root));
 }
@@ -0,0 +1,686 @@
+/*
+ * \brief  DDE Linux 2.6 block cache
+ * \date   2026-10-18
+ *
+ * The cache holds an LRU list of fixed-size extents. Each extent covers
+ * EXTENT_BLOCKS consecutive blocks and tracks valid, dirty, and in-flight
+ * blocks in bitmaps. Reads of sequential streams trigger asynchronous
+ * read-ahead. Writes are absorbed by the cache and written back per extent,
+ * which coalesces small client writes into large WRITE commands. Dirty blocks
+ * are written back at least every FLUSH_INTERVAL milliseconds.
+ *
+ * The cache lock is never held while waiting for I/O. Completion callbacks
+ * (running on the device's request dispatcher) update the bitmaps and wake
+ * up waiters.
+ */
+
+#include <linux/delay.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+
+#include <dde_linux26/block.h>
+
+#include "local.h"
+
+enum {
+	EXTENT_BLOCKS  = 128,
+	EXTENT_LONGS   = BITS_TO_LONGS(EXTENT_BLOCKS),
+	HASH_SIZE      = 64,
+	FLUSH_INTERVAL = 1000,  /* ms, maximum age of dirty blocks */
+};
+
+struct cache_extent
+{
+	struct list_head   lru;
+	struct hlist_node  hash;
+
+	unsigned long long first;                   /* first block number */
+	unsigned long      valid[EXTENT_LONGS];
+	unsigned long      dirty[EXTENT_LONGS];
+	unsigned long      pending[EXTENT_LONGS];   /* blocks being read */
+	int                writeback;               /* write commands in flight */
+	int                users;                   /* pinned by readers/writers */
+	int                used;                    /* 'first' is valid */
+	unsigned char     *data;
+};
+
+struct block_cache
+{
+	struct list_head     list;        /* list of all caches */
+	int                  usb_index;
+	unsigned             block_size;
+	unsigned             readahead;   /* blocks */
+
+	spinlock_t           lock;
+	wait_queue_head_t    wq;
+	struct list_head     lru;         /* most recently used first */
+	struct hlist_head    hash[HASH_SIZE];
+	struct cache_extent *extents;
+	unsigned             num_extents;
+	unsigned             num_dirty;   /* extents with dirty blocks */
+
+	unsigned long long   next_seq;    /* block following the last read */
+	int                  error;       /* write-back error since last flush */
+
+	struct dde_linux26_block_cache_stats stats;
+};
+
+/**
+ * Cache I/O command, passed as private data to the request queue
+ */
+struct cache_io
+{
+	struct block_cache  *cache;
+	struct cache_extent *extent;
+	unsigned             from;
+	unsigned             count;
+	int                  write;
+};
+
+static LIST_HEAD(caches);
+
+
+static struct block_cache *find_cache(int usb_index)
+{
+	struct block_cache *cache;
+
+	list_for_each_entry(cache, &caches, list)
+		if (cache->usb_index == usb_index)
+			return cache;
+
+	return NULL;
+}
+
+
+static inline unsigned hash_index(unsigned long long first)
+{
+	return (unsigned)(first / EXTENT_BLOCKS) % HASH_SIZE;
+}
+
+
+static int extent_dirty(struct cache_extent *e)
+{
+	unsigned i;
+
+	for (i = 0; i < EXTENT_LONGS; i++)
+		if (e->dirty[i])
+			return 1;
+
+	return 0;
+}
+
+
+/**
+ * Check if all blocks of range are valid or not pending anymore
+ *
+ * \return 1 if valid, 0 if still pending, negative on read error
+ */
+static int range_state(struct block_cache *cache, struct cache_extent *e,
+                       unsigned from, unsigned to)
+{
+	unsigned long flags;
+	unsigned i;
+	int ret = 1;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	for (i = from; i < to; i++) {
+		if (test_bit(i, e->pending)) { ret = 0; break; }
+		if (!test_bit(i, e->valid))  { ret = -EBLK_FAULT; }
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return ret;
+}
+
+
+/**
+ * Check if extent has no write-back in flight and no pending reads in range
+ */
+static int extent_idle_locked(struct cache_extent *e, unsigned from, unsigned to)
+{
+	unsigned i;
+
+	if (e->writeback)
+		return 0;
+
+	for (i = from; i < to; i++)
+		if (test_bit(i, e->pending))
+			return 0;
+
+	return 1;
+}
+
+
+static int extent_idle(struct block_cache *cache, struct cache_extent *e,
+                       unsigned from, unsigned to)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	ret = extent_idle_locked(e, from, to);
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return ret;
+}
+
+
+static void io_complete(void *priv, int error)
+{
+	struct cache_io     *io    = priv;
+	struct block_cache  *cache = io->cache;
+	struct cache_extent *e     = io->extent;
+	unsigned long flags;
+	unsigned i;
+
+	spin_lock_irqsave(&cache->lock, flags);
+
+	if (io->write) {
+		if (error) {
+			/* keep the blocks dirty and report the error on flush */
+			if (!extent_dirty(e))
+				cache->num_dirty++;
+			for (i = io->from; i < io->from + io->count; i++)
+				__set_bit(i, e->dirty);
+			cache->error = error;
+		}
+		e->writeback--;
+	} else {
+		for (i = io->from; i < io->from + io->count; i++) {
+			__clear_bit(i, e->pending);
+			if (!error)
+				__set_bit(i, e->valid);
+		}
+	}
+
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	kfree(io);
+	wake_up(&cache->wq);
+}
+
+
+/**
+ * Submit I/O for a run of blocks of an extent
+ *
+ * Must be called with the cache lock held, bitmaps are updated by the caller.
+ */
+static int submit_run(struct block_cache *cache, struct cache_extent *e,
+                      unsigned from, unsigned count, int write)
+{
+	struct cache_io *io = kmalloc(sizeof(struct cache_io), GFP_ATOMIC);
+	int ret;
+
+	if (!io)
+		return -EBLK_NOMEM;
+
+	io->cache  = cache;
+	io->extent = e;
+	io->from   = from;
+	io->count  = count;
+	io->write  = write;
+
+	ret = dde_linux26_block_submit(cache->usb_index, e->first + from, count,
+	                               e->data + from * cache->block_size, write,
+	                               io_complete, io);
+	if (ret)
+		kfree(io);
+
+	return ret;
+}
+
+
+/**
+ * Read all blocks of range that are neither valid nor pending
+ *
+ * Must be called with the cache lock held.
+ *
+ * \return number of blocks submitted
+ */
+static unsigned fetch_range(struct block_cache *cache, struct cache_extent *e,
+                            unsigned from, unsigned to)
+{
+	unsigned submitted = 0;
+	unsigned i = from;
+
+	while (i < to) {
+		unsigned start;
+
+		if (test_bit(i, e->valid) || test_bit(i, e->pending)) {
+			i++;
+			continue;
+		}
+
+		for (start = i; i < to && !test_bit(i, e->valid)
+		                       && !test_bit(i, e->pending); i++)
+			__set_bit(i, e->pending);
+
+		if (submit_run(cache, e, start, i - start, 0)) {
+			for (; start < i; start++)
+				__clear_bit(start, e->pending);
+			break;
+		}
+
+		submitted += i - start;
+	}
+
+	return submitted;
+}
+
+
+/**
+ * Write back all dirty blocks of an extent
+ *
+ * Must be called with the cache lock held.
+ */
+static void writeback_extent(struct block_cache *cache, struct cache_extent *e)
+{
+	unsigned i = 0;
+
+	if (!extent_dirty(e))
+		return;
+
+	while (i < EXTENT_BLOCKS) {
+		unsigned start;
+
+		if (!test_bit(i, e->dirty)) {
+			i++;
+			continue;
+		}
+
+		for (start = i; i < EXTENT_BLOCKS && test_bit(i, e->dirty); i++)
+			__clear_bit(i, e->dirty);
+
+		if (submit_run(cache, e, start, i - start, 1)) {
+			for (; start < i; start++)
+				__set_bit(start, e->dirty);
+			cache->error = -EBLK_NOMEM;
+			return;
+		}
+
+		e->writeback++;
+		cache->stats.writebacks++;
+	}
+
+	cache->num_dirty--;
+}
+
+
+/**
+ * Look up extent, evict the least recently used one on a miss
+ *
+ * Must be called with the cache lock held.
+ *
+ * \return extent or NULL if all extents are busy
+ */
+static struct cache_extent *lookup_extent(struct block_cache *cache,
+                                          unsigned long long first)
+{
+	struct cache_extent *e;
+	struct hlist_node   *node;
+
+	hlist_for_each_entry(e, node, &cache->hash[hash_index(first)], hash)
+		if (e->used && e->first == first) {
+			list_move(&e->lru, &cache->lru);
+			return e;
+		}
+
+	list_for_each_entry_reverse(e, &cache->lru, lru) {
+		unsigned i;
+
+		if (e->users || e->writeback)
+			continue;
+
+		for (i = 0; i < EXTENT_LONGS; i++)
+			if (e->pending[i])
+				break;
+		if (i < EXTENT_LONGS)
+			continue;
+
+		/* dirty extents are written back and reused later */
+		if (extent_dirty(e)) {
+			writeback_extent(cache, e);
+			continue;
+		}
+
+		if (e->used)
+			hlist_del(&e->hash);
+
+		memset(e->valid, 0, sizeof(e->valid));
+		e->first = first;
+		e->used  = 1;
+		hlist_add_head(&e->hash, &cache->hash[hash_index(first)]);
+		list_move(&e->lru, &cache->lru);
+		return e;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Pin extent, return NULL if no extent is free
+ */
+static struct cache_extent *try_get_extent(struct block_cache *cache,
+                                           unsigned long long first)
+{
+	struct cache_extent *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	e = lookup_extent(cache, first);
+	if (e)
+		e->users++;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return e;
+}
+
+
+/**
+ * Get and pin extent, wait for a free extent if necessary
+ */
+static struct cache_extent *get_extent(struct block_cache *cache,
+                                       unsigned long long first)
+{
+	struct cache_extent *e;
+
+	/* write-back, reads, and unpinning of other extents wake us up */
+	wait_event(cache->wq, (e = try_get_extent(cache, first)) != NULL);
+
+	return e;
+}
+
+
+static void put_extent(struct block_cache *cache, struct cache_extent *e)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	e->users--;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	wake_up(&cache->wq);
+}
+
+
+static void readahead(struct block_cache *cache, unsigned long long block_nr)
+{
+	unsigned long long end = block_nr + cache->readahead;
+	unsigned long flags;
+
+	end = min(end, (unsigned long long)dde_linux26_block_count(cache->usb_index));
+
+	spin_lock_irqsave(&cache->lock, flags);
+
+	while (block_nr < end) {
+		unsigned long long first = block_nr - block_nr % EXTENT_BLOCKS;
+		unsigned from = block_nr - first;
+		unsigned to   = min(end - first, (unsigned long long)EXTENT_BLOCKS);
+		struct cache_extent *e = lookup_extent(cache, first);
+
+		/* no free extent, skip read-ahead */
+		if (!e)
+			break;
+
+		cache->stats.readahead += fetch_range(cache, e, from, to);
+		block_nr = first + to;
+	}
+
+	spin_unlock_irqrestore(&cache->lock, flags);
+}
+
+
+/**
+ * Periodic write-back of dirty blocks
+ */
+static int flusher(void *arg)
+{
+	struct block_cache *cache = arg;
+
+	for (;;) {
+		msleep(FLUSH_INTERVAL);
+
+		if (cache->num_dirty) {
+			int ret = dde_linux26_block_cache_flush(cache->usb_index);
+			if (ret)
+				printk(KERN_ERR "block cache: write-back to device %d failed (%d)\n",
+				       cache->usb_index, ret);
+		}
+	}
+
+	return 0;
+}
+
+
+int dde_linux26_block_cache_init(int usb_index, unsigned long size, unsigned readahead)
+{
+	struct block_cache *cache;
+	unsigned i;
+
+	if (!dde_linux26_block_present(usb_index))
+		return -EBLK_NODEV;
+
+	if (find_cache(usb_index))
+		return 0;
+
+	cache = kzalloc(sizeof(struct block_cache), GFP_KERNEL);
+	if (!cache)
+		return -EBLK_NOMEM;
+
+	cache->usb_index   = usb_index;
+	cache->block_size  = dde_linux26_block_size(usb_index);
+	cache->readahead   = readahead;
+	cache->num_extents = max(1UL, size / (EXTENT_BLOCKS * cache->block_size));
+
+	spin_lock_init(&cache->lock);
+	init_waitqueue_head(&cache->wq);
+	INIT_LIST_HEAD(&cache->lru);
+	for (i = 0; i < HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&cache->hash[i]);
+
+	cache->extents = kzalloc(cache->num_extents * sizeof(struct cache_extent), GFP_KERNEL);
+	if (!cache->extents)
+		goto err;
+
+	for (i = 0; i < cache->num_extents; i++) {
+		struct cache_extent *e = &cache->extents[i];
+
+		e->data = kmalloc(EXTENT_BLOCKS * cache->block_size, GFP_KERNEL);
+		if (!e->data)
+			goto err;
+
+		INIT_HLIST_NODE(&e->hash);
+		list_add_tail(&e->lru, &cache->lru);
+	}
+
+	list_add(&cache->list, &caches);
+	kernel_thread(flusher, cache, 0);
+
+	DEBUG_MSG("block cache for device %d: %u extents of %u blocks, read-ahead %u blocks",
+	          usb_index, cache->num_extents, EXTENT_BLOCKS, readahead);
+	return 0;
+
+err:
+	if (cache->extents)
+		for (i = 0; i < cache->num_extents; i++)
+			kfree(cache->extents[i].data);
+	kfree(cache->extents);
+	kfree(cache);
+	return -EBLK_NOMEM;
+}
+
+
+int dde_linux26_block_cache_enabled(int usb_index)
+{
+	return find_cache(usb_index) != NULL;
+}
+
+
+int dde_linux26_block_cache_read(int usb_index, unsigned long long block_nr,
+                                 unsigned long count, void *buffer)
+{
+	struct block_cache *cache = find_cache(usb_index);
+	unsigned long long end = block_nr + count;
+	unsigned long flags;
+	int sequential;
+
+	if (!cache)
+		return dde_linux26_block_read_range(usb_index, block_nr, count, buffer);
+
+	if (end > (unsigned long long)dde_linux26_block_count(usb_index))
+		return -EBLK_FAULT;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	sequential = (block_nr == cache->next_seq);
+	cache->next_seq = end;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	while (block_nr < end) {
+		unsigned long long first = block_nr - block_nr % EXTENT_BLOCKS;
+		unsigned from = block_nr - first;
+		unsigned to   = min(end - first, (unsigned long long)EXTENT_BLOCKS);
+		struct cache_extent *e = get_extent(cache, first);
+		int state;
+
+		spin_lock_irqsave(&cache->lock, flags);
+		if (fetch_range(cache, e, from, to))
+			cache->stats.misses++;
+		else
+			cache->stats.hits++;
+		spin_unlock_irqrestore(&cache->lock, flags);
+
+		/* start read-ahead before waiting for our own data */
+		if (sequential && cache->readahead) {
+			readahead(cache, end);
+			sequential = 0;
+		}
+
+		wait_event(cache->wq, (state = range_state(cache, e, from, to)) != 0);
+
+		if (state > 0)
+			memcpy(buffer, e->data + from * cache->block_size,
+			       (to - from) * cache->block_size);
+
+		put_extent(cache, e);
+
+		if (state < 0)
+			return state;
+
+		buffer   += (to - from) * cache->block_size;
+		block_nr  = first + to;
+	}
+
+	return 0;
+}
+
+
+int dde_linux26_block_cache_write(int usb_index, unsigned long long block_nr,
+                                  unsigned long count, void *buffer)
+{
+	struct block_cache *cache = find_cache(usb_index);
+	unsigned long long end = block_nr + count;
+	unsigned long flags;
+	unsigned i;
+
+	if (!cache)
+		return dde_linux26_block_write_range(usb_index, block_nr, count, buffer);
+
+	if (end > (unsigned long long)dde_linux26_block_count(usb_index))
+		return -EBLK_FAULT;
+
+	while (block_nr < end) {
+		unsigned long long first = block_nr - block_nr % EXTENT_BLOCKS;
+		unsigned from = block_nr - first;
+		unsigned to   = min(end - first, (unsigned long long)EXTENT_BLOCKS);
+		struct cache_extent *e = get_extent(cache, first);
+
+		/*
+		 * Do not modify the extent while it is written back, and do not
+		 * let pending reads overwrite the new data.
+		 */
+		for (;;) {
+			spin_lock_irqsave(&cache->lock, flags);
+			if (extent_idle_locked(e, from, to))
+				break;
+			spin_unlock_irqrestore(&cache->lock, flags);
+
+			wait_event(cache->wq, extent_idle(cache, e, from, to));
+		}
+
+		memcpy(e->data + from * cache->block_size, buffer,
+		       (to - from) * cache->block_size);
+
+		if (!extent_dirty(e))
+			cache->num_dirty++;
+
+		for (i = from; i < to; i++) {
+			__set_bit(i, e->valid);
+			__set_bit(i, e->dirty);
+		}
+
+		cache->stats.writes++;
+
+		/* keep at least half of the cache available for reading */
+		if (cache->num_dirty > cache->num_extents / 2)
+			writeback_extent(cache, e);
+
+		spin_unlock_irqrestore(&cache->lock, flags);
+
+		put_extent(cache, e);
+
+		buffer   += (to - from) * cache->block_size;
+		block_nr  = first + to;
+	}
+
+	return 0;
+}
+
+
+int dde_linux26_block_cache_flush(int usb_index)
+{
+	struct block_cache *cache = find_cache(usb_index);
+	unsigned long flags;
+	unsigned i;
+	int ret;
+
+	if (!cache)
+		return 0;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	for (i = 0; i < cache->num_extents; i++)
+		if (!cache->extents[i].writeback)
+			writeback_extent(cache, &cache->extents[i]);
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	/* wait until all write-back commands completed */
+	for (i = 0; i < cache->num_extents; i++) {
+		struct cache_extent *e = &cache->extents[i];
+
+		wait_event(cache->wq, extent_idle(cache, e, 0, 0));
+	}
+
+	spin_lock_irqsave(&cache->lock, flags);
+	ret = cache->error;
+	cache->error = 0;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return ret;
+}
+
+
+int dde_linux26_block_cache_stats(int usb_index, struct dde_linux26_block_cache_stats *stats)
+{
+	struct block_cache *cache = find_cache(usb_index);
+	unsigned long flags;
+
+	if (!cache)
+		return -EBLK_NODEV;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	*stats = cache->stats;
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return 0;
+}
@@ -0,0 +1,450 @@
+/*
+ * \brief  DDE Linux 2.6 high-resolution timers
+ * \date   2026-10-18
+ *
+ * Jiffies advance in steps of 1/HZ, which is far too coarse for udelay()
+ * and the short sleeps of host-controller drivers. The time-stamp counter
+ * is therefore calibrated against jiffies at startup and serves as
+ * nanosecond clock. Delays below HRTIMER_SPIN_NS are busy-waited on the
+ * counter. Longer delays block in the DDE kit. Delays below HRTIMER_SLICE_NS
+ * wake up early by the sleep overshoot measured during calibration and spin
+ * the remainder, which is below HRTIMER_SPIN_NS. Longer delays only block.
+ *
+ * Active hrtimers are kept in a time-sorted list and expired by the
+ * hrtimer thread. While the first timer is far away, the thread blocks and
+ * lets the jiffies timer wheel wake it up shortly before expiry. Near
+ * expiry, it sleeps in slices and spins below HRTIMER_SPIN_NS only.
+ */
+
+#include <linux/hrtimer.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/timer.h>
+
+#include <asm/div64.h>
+#include <asm/msr.h>
+#include <asm/processor.h>
+
+#include "local.h"
+
+enum {
+	HRTIMER_CALIB_JIFFIES = HZ / 10,  /* TSC calibration period */
+	HRTIMER_SPIN_NS       = 10000,    /* delays below are busy-waited */
+	HRTIMER_SLICE_NS      = 1000000,  /* max. sleep with timers pending */
+	HRTIMER_SLACK_MAX_NS  = HRTIMER_SPIN_NS / 2,  /* max. spin after a sleep */
+	HRTIMER_RESOLUTION_NS = 1000,
+};
+
+#define NSEC_PER_JIFFY (NSEC_PER_SEC / HZ)
+
+static struct
+{
+	unsigned long        tsc_khz;   /* calibrated TSC frequency */
+	unsigned long long   tsc_base;  /* TSC at calibration */
+	s64                  ns_base;   /* jiffies clock at calibration */
+	s64                  slack_ns;  /* expected overshoot of DDE kit sleeps */
+
+	struct hrtimer_base  base;
+	struct dde_kit_sem  *sem;       /* wakes the hrtimer thread */
+	struct timer_list    wakeup;    /* coarse wakeup for far timers */
+} hrt;
+
+
+/***********
+ ** Clock **
+ ***********/
+
+/**
+ * Convert non-negative nanoseconds to ktime
+ */
+static inline ktime_t ns_to_ktime(s64 ns)
+{
+	u64 sec = ns;
+	unsigned long nsec = do_div(sec, NSEC_PER_SEC);
+
+	return ktime_set((long)sec, nsec);
+}
+
+
+/**
+ * Monotonic time in nanoseconds
+ */
+static s64 hrtimer_now(void)
+{
+	unsigned long long tsc;
+	u64 ms, ns;
+
+	/* fall back to jiffies before calibration */
+	if (!hrt.tsc_khz)
+		return (s64)jiffies * NSEC_PER_JIFFY;
+
+	/* split the division to keep the intermediate results in 64 bit */
+	rdtscll(tsc);
+	ms = tsc - hrt.tsc_base;
+	ns = (u64)do_div(ms, hrt.tsc_khz) * NSEC_PER_MSEC;
+	do_div(ns, hrt.tsc_khz);
+
+	return hrt.ns_base + (s64)(ms * NSEC_PER_MSEC + ns);
+}
+
+
+ktime_t ktime_get(void)
+{
+	return ns_to_ktime(hrtimer_now());
+}
+
+
+void ktime_get_ts(struct timespec *ts)
+{
+	*ts = ktime_to_timespec(ktime_get());
+}
+
+
+#if (BITS_PER_LONG != 64) && !defined(CONFIG_KTIME_SCALAR)
+ktime_t ktime_add_ns(const ktime_t kt, u64 nsec)
+{
+	return ns_to_ktime(ktime_to_ns(kt) + nsec);
+}
+#endif
+
+
+static void spin_until(s64 deadline)
+{
+	while (hrtimer_now() < deadline) {
+		/* without TSC the clock advances with jiffies only */
+		if (hrt.tsc_khz)
+			cpu_relax();
+		else
+			dde_kit_thread_schedule();
+	}
+}
+
+
+/**
+ * Block for 'ns' minus the expected sleep overshoot
+ */
+static void sleep_ns(s64 ns)
+{
+	u64 us = ns > hrt.slack_ns ? ns - hrt.slack_ns : 0;
+
+	do_div(us, NSEC_PER_USEC);
+	dde_kit_thread_usleep(us ? (unsigned long)us : 1);
+}
+
+
+/**
+ * Sleep until 'deadline'
+ *
+ * \param precise  spin the remainder below HRTIMER_SPIN_NS after blocking,
+ *                 otherwise block past the deadline
+ */
+static void sleep_until(s64 deadline, int precise)
+{
+	s64 left;
+
+	while ((left = deadline - hrtimer_now()) >= HRTIMER_SPIN_NS)
+		sleep_ns(left);
+
+	if (precise)
+		spin_until(deadline);
+	else if (left > 0)
+		dde_kit_thread_usleep(1 + (unsigned long)left / NSEC_PER_USEC);
+}
+
+
+/**
+ * Calibrate TSC against jiffies and measure DDE kit sleep overshoot
+ */
+static void calibrate(void)
+{
+	unsigned long long tsc0, tsc1;
+	unsigned long j;
+	u64 cycles;
+	s64 worst = 0;
+	int i;
+
+	/* start and stop at jiffies edges */
+	for (j = jiffies; jiffies == j; )
+		dde_kit_thread_schedule();
+	rdtscll(tsc0);
+	j = jiffies;
+
+	dde_kit_thread_msleep((HRTIMER_CALIB_JIFFIES - 1) * 1000 / HZ);
+	while (time_before(jiffies, j + HRTIMER_CALIB_JIFFIES))
+		dde_kit_thread_schedule();
+	rdtscll(tsc1);
+
+	cycles = tsc1 - tsc0;
+	do_div(cycles, (jiffies - j) * 1000 / HZ);
+	if (!cycles) {
+		printk("hrtimer: TSC calibration failed, using jiffies\n");
+		return;
+	}
+
+	hrt.ns_base  = (s64)jiffies * NSEC_PER_JIFFY;
+	hrt.tsc_base = tsc1;
+	hrt.tsc_khz  = (unsigned long)cycles;
+
+	for (i = 0; i < 8; i++) {
+		s64 start = hrtimer_now(), over;
+
+		dde_kit_thread_usleep(HRTIMER_SPIN_NS / NSEC_PER_USEC);
+		over = hrtimer_now() - start - HRTIMER_SPIN_NS;
+		worst = max(worst, over);
+	}
+	hrt.slack_ns = min_t(s64, worst, HRTIMER_SLACK_MAX_NS);
+
+	printk("hrtimer: TSC %lu kHz, sleep slack %lu us\n",
+	       hrt.tsc_khz, (unsigned long)hrt.slack_ns / NSEC_PER_USEC);
+}
+
+
+/************
+ ** Delays **
+ ************/
+
+void dde_linux26_hrtimer_delay(s64 ns)
+{
+	s64 deadline = hrtimer_now() + ns;
+
+	if (ns < HRTIMER_SPIN_NS)
+		spin_until(deadline);
+	else
+		sleep_until(deadline, ns < HRTIMER_SLICE_NS);
+}
+
+
+/**************
+ ** Hrtimers **
+ **************/
+
+/**
+ * Insert timer into the sorted list, return true if it became the first
+ */
+static int enqueue_hrtimer(struct hrtimer *timer)
+{
+	struct list_head *pos;
+
+	list_for_each(pos, &hrt.base.active)
+		if (list_entry(pos, struct hrtimer, node)->expires.tv64 >
+		    timer->expires.tv64)
+			break;
+
+	list_add_tail(&timer->node, pos);
+
+	return timer->node.prev == &hrt.base.active;
+}
+
+
+static int remove_hrtimer(struct hrtimer *timer)
+{
+	if (!hrtimer_active(timer))
+		return 0;
+
+	list_del(&timer->node);
+	timer->node.next = NULL;
+	return 1;
+}
+
+
+static void hrtimer_wakeup_thread(unsigned long data)
+{
+	dde_kit_sem_up(hrt.sem);
+}
+
+
+void hrtimer_init(struct hrtimer *timer, clockid_t clock_id,
+                  enum hrtimer_mode mode)
+{
+	memset(timer, 0, sizeof(*timer));
+	timer->base = &hrt.base;
+}
+
+
+int hrtimer_start(struct hrtimer *timer, ktime_t tim, const enum hrtimer_mode mode)
+{
+	int ret, first;
+
+	if (mode == HRTIMER_REL)
+		tim = ns_to_ktime(hrtimer_now() + ktime_to_ns(tim));
+
+	spin_lock(&hrt.base.lock);
+	ret = remove_hrtimer(timer);
+	timer->expires = tim;
+	first = enqueue_hrtimer(timer);
+	spin_unlock(&hrt.base.lock);
+
+	if (first)
+		dde_kit_sem_up(hrt.sem);
+
+	return ret;
+}
+
+
+int hrtimer_try_to_cancel(struct hrtimer *timer)
+{
+	int ret = -1;
+
+	spin_lock(&hrt.base.lock);
+	if (hrt.base.curr_timer != timer)
+		ret = remove_hrtimer(timer);
+	spin_unlock(&hrt.base.lock);
+
+	return ret;
+}
+
+
+int hrtimer_cancel(struct hrtimer *timer)
+{
+	for (;;) {
+		int ret = hrtimer_try_to_cancel(timer);
+		if (ret >= 0)
+			return ret;
+		cpu_relax();
+	}
+}
+
+
+ktime_t hrtimer_get_remaining(const struct hrtimer *timer)
+{
+	return ktime_sub(timer->expires, ktime_get());
+}
+
+
+int hrtimer_get_res(const clockid_t which_clock, struct timespec *tp)
+{
+	tp->tv_sec  = 0;
+	tp->tv_nsec = hrt.tsc_khz ? HRTIMER_RESOLUTION_NS : NSEC_PER_JIFFY;
+	return 0;
+}
+
+
+static int hrtimer_wakeup(struct hrtimer *timer)
+{
+	struct hrtimer_sleeper *t =
+		container_of(timer, struct hrtimer_sleeper, timer);
+	struct task_struct *task = t->task;
+
+	t->task = NULL;
+	if (task)
+		wake_up_process(task);
+
+	return HRTIMER_NORESTART;
+}
+
+
+void hrtimer_init_sleeper(struct hrtimer_sleeper *sl, struct task_struct *task)
+{
+	sl->timer.function = hrtimer_wakeup;
+	sl->task = task;
+}
+
+
+s64 dde_linux26_schedule_hrtimeout(s64 ns)
+{
+	struct hrtimer_sleeper t;
+	s64 left;
+
+	hrtimer_init(&t.timer, CLOCK_MONOTONIC, HRTIMER_REL);
+	hrtimer_init_sleeper(&t, current);
+	hrtimer_start(&t.timer, ns_to_ktime(ns), HRTIMER_REL);
+
+	schedule();
+
+	hrtimer_cancel(&t.timer);
+	left = ktime_to_ns(t.timer.expires) - hrtimer_now();
+
+	return left < 0 ? 0 : left;
+}
+
+
+/**
+ * Expire all timers due until now
+ *
+ * \return  expiry of the first pending timer or 0 if none is pending
+ */
+static s64 run_hrtimers(void)
+{
+	s64 next = 0;
+
+	spin_lock(&hrt.base.lock);
+	while (!list_empty(&hrt.base.active)) {
+		struct hrtimer *timer =
+			list_entry(hrt.base.active.next, struct hrtimer, node);
+		int restart;
+
+		if (ktime_to_ns(timer->expires) > hrtimer_now()) {
+			next = ktime_to_ns(timer->expires);
+			break;
+		}
+
+		hrt.base.curr_timer = timer;
+		remove_hrtimer(timer);
+		spin_unlock(&hrt.base.lock);
+
+		restart = timer->function(timer);
+
+		spin_lock(&hrt.base.lock);
+		if (restart != HRTIMER_NORESTART) {
+			BUG_ON(hrtimer_active(timer));
+			enqueue_hrtimer(timer);
+		}
+		hrt.base.curr_timer = NULL;
+	}
+	spin_unlock(&hrt.base.lock);
+
+	return next;
+}
+
+
+static void hrtimer_thread(void *arg)
+{
+	dde_linux26_process_add_worker("hrtimer");
+
+	for (;;) {
+		s64 next = run_hrtimers(), left;
+
+		if (!next) {
+			dde_kit_sem_down(hrt.sem);
+			continue;
+		}
+
+		left = next - hrtimer_now();
+		if (left > 2 * NSEC_PER_JIFFY) {
+			/* block until the jiffy before expiry or a new first timer */
+			u64 j = left;
+			do_div(j, NSEC_PER_JIFFY);
+			mod_timer(&hrt.wakeup, jiffies + (unsigned long)j - 1);
+			dde_kit_sem_down(hrt.sem);
+			continue;
+		}
+
+		if (left < HRTIMER_SPIN_NS) {
+			spin_until(next);
+			continue;
+		}
+
+		/* sleep in slices to notice new timers expiring earlier */
+		sleep_ns(min_t(s64, left, HRTIMER_SLICE_NS));
+	}
+}
+
+
+void dde_linux26_hrtimer_init(void)
+{
+	spin_lock_init(&hrt.base.lock);
+	INIT_LIST_HEAD(&hrt.base.active);
+	hrt.base.index      = CLOCK_MONOTONIC;
+	hrt.base.resolution = ns_to_ktime(HRTIMER_RESOLUTION_NS);
+	hrt.base.get_time   = ktime_get;
+
+	hrt.sem = dde_kit_sem_init(0);
+	setup_timer(&hrt.wakeup, hrtimer_wakeup_thread, 0);
+
+	calibrate();
+
+	dde_kit_thread_create(hrtimer_thread, NULL, ".hrtimerd");
+}
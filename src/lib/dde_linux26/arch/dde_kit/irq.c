@@ -2,13 +2,18 @@
  * \brief   Hardware-interrupt support
  * \author  Christian Helmuth
  * \date    2007-02-12
- *
- * XXX Consider support for IRQ_HANDLED and friends (linux/irqreturn.h)
  */
 
 /* Linux */
+#include <linux/hrtimer.h>
 #include <linux/interrupt.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>     /* memset() */
+#include <linux/timer.h>
+
+#include <asm/div64.h>
 
 /* DDE kit */
 #include <dde_kit/interrupt.h>
@@ -22,6 +27,24 @@
 /* dummy */
 irq_cpustat_t irq_stat[CONFIG_NR_CPUS];
 
+/**
+ * Linux IRQ action with handler statistics
+ */
+struct dde_linux26_irq_action
+{
+	struct irqaction action;
+
+	unsigned long    count;        /* invocations */
+	unsigned long    unhandled;    /* IRQ_NONE returned */
+	s64              time_min;     /* handler runtime in ns */
+	s64              time_max;
+	s64              time_sum;
+	s64              delay_min;    /* dispatch to handler entry */
+	s64              delay_max;
+	s64              delay_sum;
+	unsigned long    hist[DDE_LINUX26_IRQ_HIST_SIZE];
+};
+
 /**
  * IRQ handling data
  */
@@ -32,10 +55,21 @@ static struct dde_linux26_irq
 	int                     shared;  /* shared IRQ */
 	struct dde_kit_thread  *thread;  /* DDE kit interrupt thread */
 	struct irqaction       *action;  /* Linux IRQ action */
+	spinlock_t              lock;    /* protects action list */
+	int                     masked;  /* masked after last handler left */
 
 	struct dde_linux26_irq *next;    /* next DDE IRQ */
 } *used_irqs;
 
+/* protects used_irqs */
+static DEFINE_SPINLOCK(used_irqs_lock);
+
+
+static inline struct dde_linux26_irq_action *to_irq_action(struct irqaction *a)
+{
+	return container_of(a, struct dde_linux26_irq_action, action);
+}
+
 
 static void irq_thread_init(void *p)
 {
@@ -43,21 +77,53 @@ static void irq_thread_init(void *p)
 }
 
 
+static void account_irq_action(struct irqaction *action, irqreturn_t ret,
+                               s64 delay, s64 time)
+{
+	struct dde_linux26_irq_action *a = to_irq_action(action);
+	unsigned bucket;
+	unsigned long us;
+
+	if (!a->count || time < a->time_min)   a->time_min  = time;
+	if (!a->count || delay < a->delay_min) a->delay_min = delay;
+	if (time > a->time_max)                a->time_max  = time;
+	if (delay > a->delay_max)              a->delay_max = delay;
+	a->time_sum  += time;
+	a->delay_sum += delay;
+	a->count++;
+
+	if (ret == IRQ_NONE)
+		a->unhandled++;
+
+	/* bucket i counts runtimes below 2^i us */
+	us = (unsigned long)min_t(s64, time, LONG_MAX) / NSEC_PER_USEC;
+	for (bucket = 0; us && bucket < DDE_LINUX26_IRQ_HIST_SIZE - 1; us >>= 1)
+		bucket++;
+	a->hist[bucket]++;
+}
+
+
 static void irq_handler(void *arg)
 {
 	struct dde_linux26_irq *irq = arg;
 	struct irqaction *action;
+	s64 dispatch = ktime_to_ns(ktime_get());
 
 #if 0
 	DEBUG_MSG("irq 0x%x", irq->irq);
 #endif
 	/* interrupt occurred - call all handlers */
-	for (action = irq->action; action; action = action->next)
-		action->handler(action->irq, action->dev_id);
+	spin_lock(&irq->lock);
+	for (action = irq->action; action; action = action->next) {
+		s64 start = ktime_to_ns(ktime_get());
+		irqreturn_t ret = action->handler(action->irq, action->dev_id);
 
-	/* upon return we check for pending soft irqs */
-	if (local_softirq_pending())
-		dde_linux26_raise_softirq();
+		account_irq_action(action, ret, start - dispatch,
+		                   ktime_to_ns(ktime_get()) - start);
+	}
+	spin_unlock(&irq->lock);
+
+	/* softirqs raised by the handlers already woke their threads */
 }
 
 
@@ -65,69 +131,137 @@ static void irq_handler(void *arg)
  ** IRQ handler bookkeeping **
  *****************************/
 
+static struct dde_linux26_irq *__lookup_irq(unsigned irq_num)
+{
+	struct dde_linux26_irq *irq;
+
+	for (irq = used_irqs; irq; irq = irq->next)
+		if (irq->irq == irq_num) break;
+
+	return irq;
+}
+
+
 /**
  * Claim IRQ
  *
  * \return usage counter or negative error code
- *
- * FIXME list locking
- * FIXME are there more races?
  */
 static int claim_irq(struct irqaction *action)
 {
 	int shared = action->flags & SA_SHIRQ ? 1 : 0;
 	struct dde_linux26_irq *irq;
+	int ret = 0;
+
+	spin_lock(&used_irqs_lock);
 
 	/* check if IRQ already used */
-	for (irq = used_irqs; irq; irq = irq->next)
-		if (irq->irq == action->irq) break;
+	irq = __lookup_irq(action->irq);
 
 	/* we have to setup IRQ handling */
 	if (!irq) {
 		/* allocate and initalize new descriptor */
 		irq = dde_kit_simple_malloc(sizeof(*irq));
-		if (!irq) return -ENOMEM;
+		if (!irq) {
+			ret = -ENOMEM;
+			goto out;
+		}
 		memset(irq, 0, sizeof(*irq));
 
 		irq->irq    = action->irq;
 		irq->shared = shared;
-		irq->next   = used_irqs;
-		used_irqs   = irq;
+		spin_lock_init(&irq->lock);
 
 		/* attach to interrupt */
-		int ret = dde_kit_interrupt_attach(irq->irq,
-		                                   irq->shared,
-		                                   irq_thread_init,
-		                                   irq_handler,
-		                                   (void *)irq);
-		if (ret) {
+		if (dde_kit_interrupt_attach(irq->irq,
+		                             irq->shared,
+		                             irq_thread_init,
+		                             irq_handler,
+		                             (void *)irq)) {
 			dde_kit_simple_free(irq);
-			return -EBUSY;
+			ret = -EBUSY;
+			goto out;
 		}
+
+		irq->next   = used_irqs;
+		used_irqs   = irq;
 	}
 
 	/* does desciptor allow our new handler? */
-	if ((!irq->shared || !shared) && irq->action) return -EBUSY;
+	if (irq->action && (!irq->shared || !shared)) {
+		ret = -EBUSY;
+		goto out;
+	}
 
-	/* add handler */
+	/* add handler, the first one re-establishes sharing mode */
+	spin_lock(&irq->lock);
+	if (!irq->action)
+		irq->shared = shared;
 	irq->count++;
 	action->next = irq->action;
 	irq->action = action;
+	spin_unlock(&irq->lock);
+
+	/* line was masked when its last handler was released */
+	if (irq->masked) {
+		irq->masked = 0;
+		dde_kit_interrupt_enable(irq->irq);
+	}
 
-	return irq->count;
+	ret = irq->count;
+
+out:
+	spin_unlock(&used_irqs_lock);
+	return ret;
 }
 
 
 /**
  * Free previously claimed IRQ
  *
+ * The IRQ thread and descriptor of a line stay around after the last
+ * handler was released. The line is masked and unmasked again by the next
+ * claim_irq(), so handlers can be detached and re-attached without
+ * creating new IRQ threads.
+ *
+ * \param  irq_num  interrupt number
+ * \param  dev_id   cookie of the handler to release
+ * \param  out      released Linux IRQ action
+ *
  * \return usage counter or negative error code
  */
-static int release_irq(unsigned irq_num)
+static int release_irq(unsigned irq_num, void *dev_id, struct irqaction **out)
 {
-	WARN_UNIMPL;
+	struct dde_linux26_irq *irq;
+	struct irqaction **a;
+	int ret = -EINVAL;
+
+	spin_lock(&used_irqs_lock);
+
+	irq = __lookup_irq(irq_num);
+	if (!irq)
+		goto out;
+
+	/* waits for a running handler */
+	spin_lock(&irq->lock);
+	for (a = &irq->action; *a; a = &(*a)->next)
+		if ((*a)->dev_id == dev_id) break;
+
+	if (*a) {
+		*out = *a;
+		*a   = (*a)->next;
+		ret  = --irq->count;
+	}
+	spin_unlock(&irq->lock);
+
+	if (ret == 0) {
+		dde_kit_interrupt_disable(irq->irq);
+		irq->masked = 1;
+	}
 
-	return -EPERM;
+out:
+	spin_unlock(&used_irqs_lock);
+	return ret;
 }
 
 
@@ -145,8 +279,6 @@ static int release_irq(unsigned irq_num)
  * \param  dev_id    cookie passed back to handler
  *
  * \return 0 on success; error code otherwise
- *
- * \todo FIXME consider locking!
  */
 int request_irq(unsigned int irq, irq_handler_t handler,
                 unsigned long flags, const char *dev_name, void *dev_id)
@@ -154,10 +286,11 @@ int request_irq(unsigned int irq, irq_handler_t handler,
   if (!handler) return -EINVAL;
 
   /* facilitate Linux irqaction for this handler */
-  struct irqaction *irq_action = dde_kit_simple_malloc(sizeof(*irq_action));
-  if (!irq_action) return -ENOMEM;
-  memset(irq_action, 0, sizeof(*irq_action));
+  struct dde_linux26_irq_action *a = dde_kit_simple_malloc(sizeof(*a));
+  if (!a) return -ENOMEM;
+  memset(a, 0, sizeof(*a));
 
+  struct irqaction *irq_action = &a->action;
   irq_action->handler = handler;
   irq_action->flags   = flags;
   irq_action->name    = dev_name;
@@ -166,7 +299,10 @@ int request_irq(unsigned int irq, irq_handler_t handler,
 
   /* attach to IRQ */
   int err = claim_irq(irq_action);
-  if (err < 0) return err;
+  if (err < 0) {
+    dde_kit_simple_free(a);
+    return err;
+  }
 
   return 0;
 }
@@ -178,13 +314,18 @@ int request_irq(unsigned int irq, irq_handler_t handler,
  * \param  irq     interrupt number
  * \param  dev_id  cookie passed back to handler
  *
+ * The function returns after a currently running handler finished.
  */
 void free_irq(unsigned int irq, void *dev_id)
 {
-	/* FIXME Release IRQ */
-	/* FIXME Maybe, stop IRQ thread */
+	struct irqaction *action = 0;
+
+	if (release_irq(irq, dev_id, &action) < 0) {
+		printk("Trying to free free IRQ%d\n", irq);
+		return;
+	}
 
-	WARN_UNIMPL;
+	dde_kit_simple_free(to_irq_action(action));
 }
 
 
@@ -210,3 +351,130 @@ void enable_irq(unsigned int irq)
 {
 	dde_kit_interrupt_enable(irq);
 }
+
+
+/****************
+ ** Statistics **
+ ****************/
+
+static void stats_of_action(struct irqaction *action,
+                            struct dde_linux26_irq_stats *s)
+{
+	struct dde_linux26_irq_action *a = to_irq_action(action);
+	unsigned long count = a->count ? a->count : 1;
+	u64 avg;
+
+	memset(s, 0, sizeof(*s));
+	s->irq       = action->irq;
+	s->name      = action->name;
+	s->count     = a->count;
+	s->unhandled = a->unhandled;
+
+	s->time_min_ns  = a->time_min;
+	s->time_max_ns  = a->time_max;
+	avg = a->time_sum;
+	do_div(avg, count);
+	s->time_avg_ns  = avg;
+
+	s->delay_min_ns = a->delay_min;
+	s->delay_max_ns = a->delay_max;
+	avg = a->delay_sum;
+	do_div(avg, count);
+	s->delay_avg_ns = avg;
+
+	memcpy(s->hist, a->hist, sizeof(s->hist));
+}
+
+
+int dde_linux26_irq_stats(unsigned irq_num, struct dde_linux26_irq_stats *stats,
+                          unsigned max)
+{
+	struct dde_linux26_irq *irq;
+	struct irqaction *action;
+	int n = -1;
+
+	spin_lock(&used_irqs_lock);
+	irq = __lookup_irq(irq_num);
+	if (irq) {
+		n = 0;
+		spin_lock(&irq->lock);
+		for (action = irq->action; action && (unsigned)n < max;
+		     action = action->next)
+			stats_of_action(action, &stats[n++]);
+		spin_unlock(&irq->lock);
+	}
+	spin_unlock(&used_irqs_lock);
+
+	return n;
+}
+
+
+static void dump_irq_action(struct dde_linux26_irq_stats const *s)
+{
+	char hist[DDE_LINUX26_IRQ_HIST_SIZE * 11 + 1];
+	int i, len = 0;
+
+	for (i = 0; i < DDE_LINUX26_IRQ_HIST_SIZE; i++)
+		len += snprintf(hist + len, sizeof(hist) - len, " %lu", s->hist[i]);
+
+	printk("IRQ%u %s: %lu calls (%lu unhandled), "
+	       "time %lu/%lu/%lu ns, dispatch delay %lu/%lu/%lu ns (min/avg/max)\n",
+	       s->irq, s->name ? s->name : "?", s->count, s->unhandled,
+	       s->time_min_ns, s->time_avg_ns, s->time_max_ns,
+	       s->delay_min_ns, s->delay_avg_ns, s->delay_max_ns);
+
+	printk("IRQ%u %s: runtime histogram (<1us, <2us, <4us, ...):%s\n",
+	       s->irq, s->name ? s->name : "?", hist);
+}
+
+
+enum { MAX_DUMP_ACTIONS = 32 };
+
+static struct timer_list stats_timer;
+static unsigned long     stats_period;
+
+/* snapshot printed after the IRQ locks are released */
+static struct dde_linux26_irq_stats stats_dump[MAX_DUMP_ACTIONS];
+
+
+static void dump_irq_stats(unsigned long data)
+{
+	struct dde_linux26_irq *irq;
+	struct irqaction *action;
+	unsigned i, n = 0, skipped = 0;
+
+	spin_lock(&used_irqs_lock);
+	for (irq = used_irqs; irq; irq = irq->next) {
+		spin_lock(&irq->lock);
+		for (action = irq->action; action; action = action->next)
+			if (n < MAX_DUMP_ACTIONS)
+				stats_of_action(action, &stats_dump[n++]);
+			else
+				skipped++;
+		spin_unlock(&irq->lock);
+	}
+	spin_unlock(&used_irqs_lock);
+
+	for (i = 0; i < n; i++)
+		dump_irq_action(&stats_dump[i]);
+
+	if (skipped)
+		printk("IRQ statistics of %u more handlers omitted\n", skipped);
+
+	if (stats_period)
+		mod_timer(&stats_timer, jiffies + stats_period);
+}
+
+
+void dde_linux26_irq_stats_log(unsigned period_ms)
+{
+	if (!stats_timer.function)
+		setup_timer(&stats_timer, dump_irq_stats, 0);
+
+	stats_period = period_ms ? max(1UL, msecs_to_jiffies(period_ms)) : 0;
+
+	if (stats_period)
+		mod_timer(&stats_timer, jiffies + stats_period);
+	else
+		del_timer_sync(&stats_timer);
+}
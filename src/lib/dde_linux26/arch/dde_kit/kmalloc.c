@@ -9,6 +9,15 @@
  * some power of two bytes. For larger allocations ddedkit_large_malloc() is
  * used. This way, we optimize for speed and potentially waste memory
  * resources.
+ *
+ * Allocations carry no header. The objects of the kmalloc() caches are carved
+ * from chunks of CHUNK_SIZE bytes, and kfree() finds the owning cache by
+ * looking up the chunk of the object address. Addresses without chunk stem
+ * from dde_kit_large_malloc().
+ *
+ * Memory regions not allocated by kmalloc() can be entered in the chunk map
+ * as well. kfree() hands objects of such a region back to its owner, which
+ * permits, e.g., socket buffers with data in a client-provided buffer.
  */
 
 /* Linux */
@@ -24,6 +33,8 @@
 
 #include <dde_linux26/general.h>
 
+#include "local.h"
+
 /* This stuff is needed by some drivers, e.g. for ethtool.
  * XXX: This is a fake, implement it if you really need ethtool stuff.
  */
@@ -48,13 +59,35 @@ EXPORT_SYMBOL(remap_pfn_range);
  ** Implementation **
  ********************/
 
+enum {
+	CHUNK_SHIFT      = 16,                   /* 64 KiB chunks of cache objects */
+	CHUNK_SIZE       = 1 << CHUNK_SHIFT,
+	CHUNK_HASH_SIZE  = 256,
+	SIZE_INDEX_SHIFT = 5,                    /* granularity of size_index[] */
+};
+
+
+/*
+ * Size class of kmalloc(), or foreign memory region if 'cache' is 0
+ */
+struct kmalloc_class
+{
+	size_t                          size;
+	struct kmem_cache              *cache;
+	struct dde_linux26_slab_backend backend;
+
+	void  *free_list;                        /* linked through first word */
+	char  *chunk_pos;                        /* unused part of current chunk */
+	char  *chunk_end;
+};
+
+
 /*
  * These are the default caches for kmalloc. Custom caches can have other sizes.
  */
-static struct cache_sizes malloc_sizes[] = {
-#define CACHE(x) { .cs_size = (x) },
+static struct kmalloc_class malloc_sizes[] = {
+#define CACHE(x) { .size = (x) },
 #include <linux/kmalloc_sizes.h>
-	CACHE(ULONG_MAX)
 #undef CACHE
 };
 
@@ -70,16 +103,191 @@ static const char *malloc_names[] = {
 };
 
 
+/*
+ * Size class for allocation sizes, indexed by (size - 1) >> SIZE_INDEX_SHIFT
+ *
+ * The table matches the DDE_LINUX variant of kmalloc_sizes.h, which is checked
+ * in dde_linux26_kmalloc_init().
+ */
+static const unsigned char size_index[] = {
+	0,                                               /*   32 */
+	1,                                               /*   64 */
+	2, 2,                                            /*  128 */
+	3, 3, 3, 3,                                      /*  256 */
+	4, 4, 4, 4, 4, 4, 4, 4,                          /*  512 */
+	5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,  /* 1024 */
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,  /* 2048 */
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+};
+
+#define KMALLOC_MAX_CACHE_SIZE (ARRAY_SIZE(size_index) << SIZE_INDEX_SHIFT)
+
+
 /**
- * Find kmalloc() cache for size
+ * Find kmalloc() size class for size
  */
-static struct kmem_cache *find_cache(size_t size)
+static inline struct kmalloc_class *find_class(size_t size)
+{
+	if (size > KMALLOC_MAX_CACHE_SIZE) return 0;
+
+	return &malloc_sizes[size_index[size ? (size - 1) >> SIZE_INDEX_SHIFT : 0]];
+}
+
+
+/***************
+ ** Chunk map **
+ ***************/
+
+/*
+ * Chunks are not naturally aligned and may span two CHUNK_SIZE windows, so a
+ * chunk is entered in the hash bucket of each window it touches. Entries are
+ * never unlinked, which permits lookups without lock. Removed regions leave
+ * entries of size 0, which match no address and are reused by insertions.
+ */
+struct chunk_entry
+{
+	struct chunk_entry   *next;
+	unsigned long         base;
+	unsigned long         size;
+	struct kmalloc_class *class;
+};
+
+static struct chunk_entry *chunk_map[CHUNK_HASH_SIZE];
+static DEFINE_SPINLOCK(chunk_map_lock);
+
+#define CHUNK_HASH(addr) (((addr) >> CHUNK_SHIFT) & (CHUNK_HASH_SIZE - 1))
+
+
+static int chunk_map_insert(unsigned long base, unsigned long size,
+                            struct kmalloc_class *class)
+{
+	unsigned long window;
+
+	for (window = base >> CHUNK_SHIFT;
+	     window <= (base + size - 1) >> CHUNK_SHIFT; window++) {
+
+		struct chunk_entry **bucket = &chunk_map[CHUNK_HASH(window << CHUNK_SHIFT)];
+		struct chunk_entry  *e;
+
+		/* reuse entry of a removed region */
+		spin_lock(&chunk_map_lock);
+		for (e = *bucket; e && e->size; e = e->next) ;
+		if (e) {
+			e->base  = base;
+			e->class = class;
+			smp_wmb();
+			e->size  = size;
+		}
+		spin_unlock(&chunk_map_lock);
+
+		if (e) continue;
+
+		e = dde_kit_simple_malloc(sizeof(*e));
+		if (!e) return -ENOMEM;
+
+		e->base  = base;
+		e->size  = size;
+		e->class = class;
+
+		spin_lock(&chunk_map_lock);
+		e->next = *bucket;
+		smp_wmb();
+		*bucket = e;
+		spin_unlock(&chunk_map_lock);
+	}
+
+	return 0;
+}
+
+
+/**
+ * Remove all entries of region starting at base
+ *
+ * \return class of region, or 0 if the region is unknown
+ */
+static struct kmalloc_class *chunk_map_remove(unsigned long base)
+{
+	struct kmalloc_class *class = 0;
+	struct chunk_entry   *e;
+	unsigned long         window, last;
+
+	spin_lock(&chunk_map_lock);
+
+	for (e = chunk_map[CHUNK_HASH(base)]; e; e = e->next)
+		if (e->size && e->base == base)
+			break;
+
+	if (e) {
+		class = e->class;
+		last  = (base + e->size - 1) >> CHUNK_SHIFT;
+
+		for (window = base >> CHUNK_SHIFT; window <= last; window++)
+			for (e = chunk_map[CHUNK_HASH(window << CHUNK_SHIFT)]; e; e = e->next)
+				if (e->base == base && e->class == class)
+					e->size = 0;
+	}
+
+	spin_unlock(&chunk_map_lock);
+	return class;
+}
+
+
+static struct kmalloc_class *chunk_map_lookup(const void *objp)
 {
-	struct cache_sizes *sizes;
+	unsigned long       addr = (unsigned long)objp;
+	struct chunk_entry *e    = chunk_map[CHUNK_HASH(addr)];
 
-	for (sizes = malloc_sizes; size > sizes->cs_size; ++sizes) ;
+	for (; e; e = e->next) {
+		smp_read_barrier_depends();
+		if (addr - e->base < e->size)
+			return e->class;
+	}
 
-	return sizes->cs_cachep;
+	return 0;
+}
+
+
+/*********************************
+ ** Backing store of size class **
+ *********************************/
+
+static void *class_alloc(void *priv)
+{
+	struct kmalloc_class *class = priv;
+	void                 *objp;
+
+	if (class->free_list) {
+		objp = class->free_list;
+		class->free_list = *(void **)objp;
+		return objp;
+	}
+
+	if (class->chunk_pos + class->size > class->chunk_end) {
+		char *chunk = dde_kit_large_malloc(CHUNK_SIZE);
+
+		if (!chunk) return 0;
+
+		if (chunk_map_insert((unsigned long)chunk, CHUNK_SIZE, class)) {
+			dde_kit_large_free(chunk);
+			return 0;
+		}
+
+		class->chunk_pos = chunk;
+		class->chunk_end = chunk + CHUNK_SIZE;
+	}
+
+	objp = class->chunk_pos;
+	class->chunk_pos += class->size;
+	return objp;
+}
+
+
+static void class_free(void *priv, void *objp)
+{
+	struct kmalloc_class *class = priv;
+
+	*(void **)objp = class->free_list;
+	class->free_list = objp;
 }
 
 
@@ -94,20 +302,24 @@ static struct kmem_cache *find_cache(size_t size)
  */
 void kfree(const void *objp)
 {
+	struct kmalloc_class *class;
+
 	if (!objp) return;
 
-	/* find cache back-pointer */
-	void **p = (void **)objp - 1;
+	class = chunk_map_lookup(objp);
 
 	dde_kit_log(DEBUG_MALLOC, "objp=%p cache=%p (%d)",
-	            p, *p, *p ? kmem_cache_size(*p) : 0);
+	            objp, class ? class->cache : 0, class ? class->size : 0);
 
-	if (*p)
+	if (class && class->cache)
 		/* free from cache */
-		kmem_cache_free(*p, p);
+		kmem_cache_free(class->cache, (void *)objp);
+	else if (class)
+		/* hand back to owner of foreign region */
+		class->backend.free(class->backend.priv, (void *)objp);
 	else
 		/* no cache for this size - use dde_kit free */
-		dde_kit_large_free(p);
+		dde_kit_large_free((void *)objp);
 }
 
 
@@ -121,35 +333,51 @@ void kfree(const void *objp)
  */
 void *__kmalloc(size_t size, gfp_t flags)
 {
-	/* add space for back-pointer */
-	size += sizeof(void *);
-
 	/* find appropriate cache */
-	struct kmem_cache *cache = find_cache(size);
+	struct kmalloc_class *class = find_class(size);
 
-	void **p;
-	if (cache)
+	void *p;
+	if (class)
 		/* allocate from cache */
-		p = kmem_cache_alloc(cache, flags);
+		p = kmem_cache_alloc(class->cache, flags);
 	else
 		/* no cache for this size - use dde_kit malloc */
 		p = dde_kit_large_malloc(size);
 
 	dde_kit_log(DEBUG_MALLOC, "size=%d, cache=%p (%d) => %p",
-	           size, cache, cache ? kmem_cache_size(cache) : 0, p);
+	           size, class ? class->cache : 0, class ? class->size : 0, p);
 
 	/* return here in case of error */
 	if (!p) return 0;
 
 	/* zero page if demanded and no cache was used */
-	if ((flags & __GFP_ZERO) && !cache)
+	if ((flags & __GFP_ZERO) && !class)
 		memset(p, 0, size);
 
-	/* store back pointer */
-	*p = cache;
+	return p;
+}
+
+
+int dde_linux26_kmalloc_add_region(void *base, unsigned long size,
+                                   struct dde_linux26_slab_backend const *backend)
+{
+	struct kmalloc_class *region = dde_kit_simple_malloc(sizeof(*region));
+	if (!region) return -ENOMEM;
+
+	memset(region, 0, sizeof(*region));
+	region->size    = size;
+	region->backend = *backend;
 
-	/* return pointer to actual chunk */
-	return ++p;
+	return chunk_map_insert((unsigned long)base, size, region);
+}
+
+
+void dde_linux26_kmalloc_remove_region(void *base)
+{
+	struct kmalloc_class *region = chunk_map_remove((unsigned long)base);
+
+	if (region && !region->cache)
+		dde_kit_simple_free(region);
 }
 
 
@@ -182,10 +410,27 @@ void dma_free_coherent(struct device *dev, size_t size,
  */
 void dde_linux26_kmalloc_init(void)
 {
-	struct cache_sizes  *sizes = malloc_sizes;
-	const char         **names = malloc_names;
+	unsigned i;
 
 	/* init malloc sizes array */
-	for (; sizes->cs_size != ULONG_MAX; ++sizes, ++names)
-		sizes->cs_cachep = kmem_cache_create(*names, sizes->cs_size, 0, 0, 0, 0);
+	for (i = 0; i < ARRAY_SIZE(malloc_sizes); i++) {
+		struct kmalloc_class *class = &malloc_sizes[i];
+
+		class->backend.alloc = class_alloc;
+		class->backend.free  = class_free;
+		class->backend.priv  = class;
+		class->cache = dde_linux26_kmem_cache_create_backed(malloc_names[i],
+		                                                    class->size,
+		                                                    &class->backend);
+	}
+
+	/* check size_index[] against kmalloc_sizes.h */
+	for (i = 0; i < ARRAY_SIZE(size_index); i++) {
+		size_t size = (i + 1) << SIZE_INDEX_SHIFT;
+		unsigned c  = size_index[i];
+
+		if (c >= ARRAY_SIZE(malloc_sizes) || malloc_sizes[c].size < size
+		 || (c > 0 && malloc_sizes[c - 1].size >= size))
+			dde_kit_panic("kmalloc size_index[] does not match kmalloc_sizes.h");
+	}
 }
@@ -5,6 +5,12 @@
  *
  * In Linux 2.6 this resides in mm/slab.c.
  *
+ * Objects are cached in per-thread magazines in front of the DDE kit slab (see
+ * Bonwick and Adams, "Magazines and Vmem", USENIX 2001). A thread allocates
+ * from and frees to its own two magazines without taking any lock. Only if
+ * both are empty (or full) it exchanges a magazine with the per-cache depot.
+ * Threads that are no DDE Linux 2.6 threads use the locked slab directly.
+ *
  * I'll disregard the following function currently...
  *
  * extern struct kmem_cache *kmem_find_general_cachep(size_t size, gfp_t gfpflags);
@@ -16,9 +22,10 @@
 
 /* DDE kit */
 #include <dde_kit/memory.h>
-#include <dde_kit/lock.h>
 #include <dde_kit/printf.h>
 
+#include "local.h"
+
 
 /*******************
  ** Configuration **
@@ -32,6 +39,35 @@
 # define DEBUG_SLAB_ALLOC 0
 #endif
 
+enum {
+	MAGAZINE_ROUNDS = 15,        /* max objects per magazine */
+	MAGAZINE_BYTES  = 16 * 1024, /* max object memory per magazine */
+	DEPOT_MAX_FULL  = 8,         /* max full magazines kept per depot */
+	MAX_CACHES      = 64,        /* caches with magazine layer */
+};
+
+
+/*
+ * Magazine of free objects
+ */
+struct kmem_magazine
+{
+	struct kmem_magazine *next;                    /* depot list */
+	unsigned              rounds;                  /* number of objects */
+	void                 *objs[MAGAZINE_ROUNDS];
+};
+
+
+/*
+ * Per-thread magazines of one cache
+ */
+struct kmem_thread_cache
+{
+	struct kmem_magazine *loaded;
+	struct kmem_magazine *previous;
+};
+
+
 /*
  * Kmem cache structure
  */
@@ -41,12 +77,300 @@ struct kmem_cache
 	unsigned             size;               /* object size */
 
 	struct dde_kit_slab *dde_kit_slab_cache; /* backing DDE kit cache */
-	struct dde_kit_lock *cache_lock;         /* synchronize access to cache */
+	struct dde_linux26_slab_backend const *backend; /* or custom backing store */
+	spinlock_t           cache_lock;         /* synchronize access to cache */
 	void (*ctor)(void*, struct kmem_cache *, unsigned long); /* object constructor */
 	void (*dtor)(void*, struct kmem_cache *, unsigned long); /* object destructor */
+
+	int                   index;             /* slot in per-thread table or -1 */
+	unsigned              magazine_size;     /* rounds per magazine */
+	spinlock_t            depot_lock;        /* synchronize access to depot */
+	struct kmem_magazine *depot_full;        /* list of full magazines */
+	struct kmem_magazine *depot_empty;       /* list of empty magazines */
+	unsigned              depot_num_full;
 };
 
 
+/*
+ * Caches with magazine layer, indexed by kmem_cache::index
+ *
+ * Indices are never reused, so a stale per-thread slot never refers to a
+ * newer cache.
+ */
+static struct kmem_cache   *caches[MAX_CACHES];
+static int                  num_caches;
+static DEFINE_SPINLOCK(caches_lock);
+
+
+/*****************
+ ** Slab access **
+ *****************/
+
+static void *slab_alloc(struct kmem_cache *cache)
+{
+	void *ret;
+
+	spin_lock(&cache->cache_lock);
+	if (cache->backend)
+		ret = cache->backend->alloc(cache->backend->priv);
+	else
+		ret = dde_kit_slab_alloc(cache->dde_kit_slab_cache);
+	spin_unlock(&cache->cache_lock);
+
+	return ret;
+}
+
+
+static void slab_free(struct kmem_cache *cache, void *objp)
+{
+	spin_lock(&cache->cache_lock);
+	if (cache->backend)
+		cache->backend->free(cache->backend->priv, objp);
+	else
+		dde_kit_slab_free(cache->dde_kit_slab_cache, objp);
+	spin_unlock(&cache->cache_lock);
+}
+
+
+/*********************
+ ** Magazine layer  **
+ *********************/
+
+static struct kmem_magazine *magazine_alloc(void)
+{
+	struct kmem_magazine *m = dde_kit_simple_malloc(sizeof(*m));
+
+	if (m) {
+		m->next   = 0;
+		m->rounds = 0;
+	}
+	return m;
+}
+
+
+/**
+ * Return objects of magazine to the slab and free the magazine
+ */
+static void magazine_destroy(struct kmem_cache *cache, struct kmem_magazine *m)
+{
+	if (!m) return;
+
+	if (cache)
+		while (m->rounds)
+			slab_free(cache, m->objs[--m->rounds]);
+
+	dde_kit_simple_free(m);
+}
+
+
+/**
+ * Return per-thread magazines of the calling thread for cache
+ *
+ * \return per-thread slot, or 0 if the magazine layer is not available
+ */
+static struct kmem_thread_cache *thread_cache(struct kmem_cache *cache)
+{
+	dde_linux26_thread_data  *t;
+	struct kmem_thread_cache *tc;
+
+	if (cache->index < 0) return 0;
+
+	t = (dde_linux26_thread_data *)dde_kit_thread_get_my_data();
+	if (!t) return 0;
+
+	if (!t->_kmem_magazines) {
+		t->_kmem_magazines = dde_kit_simple_malloc(MAX_CACHES * sizeof(*tc));
+		if (!t->_kmem_magazines) return 0;
+		memset(t->_kmem_magazines, 0, MAX_CACHES * sizeof(*tc));
+	}
+
+	tc = &((struct kmem_thread_cache *)t->_kmem_magazines)[cache->index];
+
+	if (!tc->loaded || !tc->previous) {
+		if (!tc->loaded)   tc->loaded   = magazine_alloc();
+		if (!tc->previous) tc->previous = magazine_alloc();
+		if (!tc->loaded || !tc->previous) return 0;
+	}
+
+	return tc;
+}
+
+
+static inline void swap_magazines(struct kmem_thread_cache *tc)
+{
+	struct kmem_magazine *m = tc->loaded;
+	tc->loaded   = tc->previous;
+	tc->previous = m;
+}
+
+
+/**
+ * Get object from per-thread magazines or depot
+ *
+ * \return object, or 0 if the caller has to use the slab
+ */
+static void *magazine_get(struct kmem_cache *cache)
+{
+	struct kmem_thread_cache *tc = thread_cache(cache);
+	struct kmem_magazine     *m;
+
+	if (!tc) return 0;
+
+	if (tc->loaded->rounds)
+		return tc->loaded->objs[--tc->loaded->rounds];
+
+	if (tc->previous->rounds) {
+		swap_magazines(tc);
+		return tc->loaded->objs[--tc->loaded->rounds];
+	}
+
+	/* both magazines are empty - exchange previous for a full one */
+	spin_lock(&cache->depot_lock);
+	m = cache->depot_full;
+	if (m) {
+		cache->depot_full = m->next;
+		cache->depot_num_full--;
+
+		tc->previous->next = cache->depot_empty;
+		cache->depot_empty = tc->previous;
+
+		tc->previous = tc->loaded;
+		tc->loaded   = m;
+	}
+	spin_unlock(&cache->depot_lock);
+
+	if (!m) return 0;
+
+	return tc->loaded->objs[--tc->loaded->rounds];
+}
+
+
+/**
+ * Put object into per-thread magazines or depot
+ *
+ * \return 0 on success, or -1 if the caller has to use the slab
+ */
+static int magazine_put(struct kmem_cache *cache, void *objp)
+{
+	struct kmem_thread_cache *tc = thread_cache(cache);
+	struct kmem_magazine     *m;
+
+	if (!tc) return -1;
+
+	if (tc->loaded->rounds < cache->magazine_size) {
+		tc->loaded->objs[tc->loaded->rounds++] = objp;
+		return 0;
+	}
+
+	if (tc->previous->rounds == 0) {
+		swap_magazines(tc);
+		tc->loaded->objs[tc->loaded->rounds++] = objp;
+		return 0;
+	}
+
+	/* both magazines are full - exchange previous for an empty one */
+	spin_lock(&cache->depot_lock);
+	if (cache->depot_num_full >= DEPOT_MAX_FULL) {
+		spin_unlock(&cache->depot_lock);
+		return -1;
+	}
+
+	m = cache->depot_empty;
+	if (m)
+		cache->depot_empty = m->next;
+	else
+		m = magazine_alloc();
+
+	if (m) {
+		tc->previous->next = cache->depot_full;
+		cache->depot_full  = tc->previous;
+		cache->depot_num_full++;
+
+		tc->previous = tc->loaded;
+		tc->loaded   = m;
+		m->next      = 0;
+	}
+	spin_unlock(&cache->depot_lock);
+
+	if (!m) return -1;
+
+	tc->loaded->objs[tc->loaded->rounds++] = objp;
+	return 0;
+}
+
+
+/**
+ * Free all depot magazines and return their objects to the slab
+ */
+static void depot_drain(struct kmem_cache *cache)
+{
+	struct kmem_magazine *full, *empty, *m;
+
+	spin_lock(&cache->depot_lock);
+	full  = cache->depot_full;
+	empty = cache->depot_empty;
+	cache->depot_full     = 0;
+	cache->depot_empty    = 0;
+	cache->depot_num_full = 0;
+	spin_unlock(&cache->depot_lock);
+
+	while ((m = full))  { full  = m->next; magazine_destroy(cache, m); }
+	while ((m = empty)) { empty = m->next; magazine_destroy(cache, m); }
+}
+
+
+/**
+ * Release magazines of an exiting thread
+ *
+ * Full magazines go back to the depot of the cache if there is room,
+ * otherwise their objects are freed to the slab.
+ */
+void dde_linux26_kmem_cache_thread_exit(dde_linux26_thread_data *t)
+{
+	struct kmem_thread_cache *tc = t->_kmem_magazines;
+	int i;
+
+	if (!tc) return;
+
+	for (i = 0; i < MAX_CACHES; i++) {
+		struct kmem_magazine *mags[2] = { tc[i].loaded, tc[i].previous };
+		struct kmem_cache    *cache;
+		int j;
+
+		spin_lock(&caches_lock);
+		cache = caches[i];
+
+		for (j = 0; j < 2; j++) {
+			struct kmem_magazine *m = mags[j];
+			if (!m) continue;
+
+			/* cache was destroyed, its objects are gone */
+			if (!cache) { dde_kit_simple_free(m); continue; }
+
+			spin_lock(&cache->depot_lock);
+			if (m->rounds == 0) {
+				m->next = cache->depot_empty;
+				cache->depot_empty = m;
+				m = 0;
+			} else if (m->rounds == cache->magazine_size
+			        && cache->depot_num_full < DEPOT_MAX_FULL) {
+				m->next = cache->depot_full;
+				cache->depot_full = m;
+				cache->depot_num_full++;
+				m = 0;
+			}
+			spin_unlock(&cache->depot_lock);
+
+			magazine_destroy(cache, m);
+		}
+		spin_unlock(&caches_lock);
+	}
+
+	dde_kit_simple_free(tc);
+	t->_kmem_magazines = 0;
+}
+
+
 /**
  * Return size of objects in cache
  */
@@ -74,7 +398,10 @@ const char *kmem_cache_name(struct kmem_cache *cache)
  */
 int kmem_cache_shrink(struct kmem_cache *cache)
 {
-	/* noop */
+	/* per-thread magazines are not accessible, release depot only */
+	if (cache->index >= 0)
+		depot_drain(cache);
+
 	return 1;
 }
 
@@ -94,9 +421,8 @@ void kmem_cache_free(struct kmem_cache *cache, void *objp)
 	if (cache->dtor)
 		cache->dtor(objp, cache, 0);
 
-	dde_kit_lock_lock(cache->cache_lock);
-	dde_kit_slab_free(cache->dde_kit_slab_cache, objp);
-	dde_kit_lock_unlock(cache->cache_lock);
+	if (magazine_put(cache, objp))
+		slab_free(cache, objp);
 }
 
 
@@ -114,9 +440,9 @@ void *kmem_cache_alloc(struct kmem_cache *cache, gfp_t flags)
 
 	dde_kit_log(DEBUG_SLAB_ALLOC, "\"%s\" flags=%x", cache->name, flags);
 
-	dde_kit_lock_lock(cache->cache_lock);
-	ret = dde_kit_slab_alloc(cache->dde_kit_slab_cache);
-	dde_kit_lock_unlock(cache->cache_lock);
+	ret = magazine_get(cache);
+	if (!ret)
+		ret = slab_alloc(cache);
 
 	/* return here in case of error */
 	if (!ret) return 0;
@@ -153,11 +479,88 @@ void kmem_cache_destroy(struct kmem_cache *cache)
 {
 	dde_kit_log(DEBUG_SLAB, "\"%s\"", cache->name);
 
-	dde_kit_slab_destroy(cache->dde_kit_slab_cache);
+	if (cache->index >= 0) {
+		dde_linux26_thread_data  *t  = dde_kit_thread_get_my_data();
+		struct kmem_thread_cache *tc = t ? t->_kmem_magazines : 0;
+
+		spin_lock(&caches_lock);
+		caches[cache->index] = 0;
+		spin_unlock(&caches_lock);
+
+		/* magazines of other threads are freed on thread exit */
+		if (tc) {
+			dde_kit_simple_free(tc[cache->index].loaded);
+			dde_kit_simple_free(tc[cache->index].previous);
+			tc[cache->index].loaded = tc[cache->index].previous = 0;
+		}
+
+		depot_drain(cache);
+	}
+
+	if (!cache->backend)
+		dde_kit_slab_destroy(cache->dde_kit_slab_cache);
 	dde_kit_simple_free(cache);
 }
 
 
+static struct kmem_cache *cache_create(const char *name, size_t size,
+                                       void (*ctor)(void *, struct kmem_cache *, unsigned long),
+                                       void (*dtor)(void *, struct kmem_cache *, unsigned long),
+                                       struct dde_linux26_slab_backend const *backend)
+{
+	dde_kit_log(DEBUG_SLAB, "\"%s\" obj_size=%d", name, size);
+
+	struct kmem_cache *cache;
+
+	if (!name) {
+		printk("kmem_cache name reqeuired\n");
+		return 0;
+	}
+
+	cache = dde_kit_simple_malloc(sizeof(*cache));
+	if (!cache) {
+		printk("No memory for slab cache\n");
+		return 0;
+	}
+
+	/* Initialize a physically contiguous cache for kmem */
+	cache->backend            = backend;
+	cache->dde_kit_slab_cache = 0;
+	if (!backend && !(cache->dde_kit_slab_cache = dde_kit_slab_init(size))) {
+		printk("DDE kit slab init failed\n");
+		dde_kit_simple_free(cache);
+		return 0;
+	}
+
+	cache->name = name;
+	cache->size = size;
+	cache->ctor = ctor;
+	cache->dtor = dtor;
+
+	spin_lock_init(&cache->cache_lock);
+
+	/* large objects bypass the magazine layer */
+	cache->magazine_size  = min_t(unsigned, MAGAZINE_ROUNDS, MAGAZINE_BYTES / size);
+	cache->depot_full     = 0;
+	cache->depot_empty    = 0;
+	cache->depot_num_full = 0;
+	cache->index          = -1;
+
+	if (cache->magazine_size) {
+		spin_lock_init(&cache->depot_lock);
+
+		spin_lock(&caches_lock);
+		if (num_caches < MAX_CACHES) {
+			cache->index = num_caches++;
+			caches[cache->index] = cache;
+		}
+		spin_unlock(&caches_lock);
+	}
+
+	return cache;
+}
+
+
 /**
  * kmem_cache_create - Create a cache.
  * @name: A string which is used in /proc/slabinfo to identify this cache.
@@ -192,34 +595,16 @@ struct kmem_cache * kmem_cache_create(const char *name, size_t size, size_t alig
                                       void (*ctor)(void *, struct kmem_cache *, unsigned long),
                                       void (*dtor)(void *, struct kmem_cache *, unsigned long))
 {
-	dde_kit_log(DEBUG_SLAB, "\"%s\" obj_size=%d", name, size);
-
-	struct kmem_cache *cache;
-
-	if (!name) {
-		printk("kmem_cache name reqeuired\n");
-		return 0;
-	}
-
-	cache = dde_kit_simple_malloc(sizeof(*cache));
-	if (!cache) {
-		printk("No memory for slab cache\n");
-		return 0;
-	}
-
-	/* Initialize a physically contiguous cache for kmem */
-	if (!(cache->dde_kit_slab_cache = dde_kit_slab_init(size))) {
-		printk("DDE kit slab init failed\n");
-		dde_kit_simple_free(cache);
-		return 0;
-	}
-
-	cache->name = name;
-	cache->size = size;
-	cache->ctor = ctor;
-	cache->dtor = dtor;
+	return cache_create(name, size, ctor, dtor, 0);
+}
 
-	dde_kit_lock_init(&cache->cache_lock);
 
-	return cache;
+/**
+ * Create cache for objects provided by a custom backing store
+ */
+struct kmem_cache *
+dde_linux26_kmem_cache_create_backed(const char *name, size_t size,
+                                     struct dde_linux26_slab_backend const *backend)
+{
+	return cache_create(name, size, 0, 0, backend);
 }
@@ -35,6 +35,7 @@ typedef struct dde_linux26_thread_data
 	struct thread_info     _thread_info;
 	struct dde_kit_thread *_dde_kit_thread;
 	struct dde_kit_sem    *_sleep_lock;
+	void                  *_kmem_magazines; /* per-thread kmem_cache magazines */
 } dde_linux26_thread_data;
 
 #define LX_THREAD(thread_data)     ((thread_data)->_thread_info)
@@ -95,9 +96,6 @@ extern struct thread_info init_thread;
 extern struct task_struct init_task;
 
 
-extern void dde_linux26_raise_softirq(void);
-
-
 /***********************
  ** DDE Linux 2.6 NET **
  ***********************/
@@ -111,6 +109,45 @@ extern void dde_linux26_raise_softirq(void);
  */
 extern int dde_linux26_do_rx_callback(struct sk_buff *s);
 
+/**
+ * Hand out packets collected for the burst rx callback
+ */
+extern void dde_linux26_net_rx_flush(void);
+
+struct net_device;
+
+/**
+ * Wake senders waiting for the transmit queue of device
+ */
+extern void dde_linux26_net_tx_wake(struct net_device *dev);
+
+/**
+ * Report carrier change of device
+ */
+extern void dde_linux26_net_link_event(struct net_device *dev);
+
+struct softirq_action;
+
+/**
+ * Start softnet thread executing the NET_RX action
+ */
+extern void dde_linux26_softnet_init(void (*action)(struct softirq_action *));
+
+/**
+ * Queue received packet in the backlog of its device
+ */
+extern int dde_linux26_softnet_rx(struct sk_buff *skb);
+
+/**
+ * Wake softnet thread
+ */
+extern void dde_linux26_softnet_schedule(void);
+
+/**
+ * Wake softnet thread after the NET_RX action exhausted its budget
+ */
+extern void dde_linux26_softnet_squeeze(void);
+
 
 /******************************
  ** DDE Linux 2.6 subsystems **
@@ -133,6 +170,25 @@ extern void dde_linux26_softirq_init(void);
  */
 extern void dde_linux26_timer_init(void);
 
+/**
+ * Initialize high-resolution timers and calibrate their clock
+ */
+extern void dde_linux26_hrtimer_init(void);
+
+/**
+ * Delay current thread for 'ns' nanoseconds
+ *
+ * Short delays are busy-waited.
+ */
+extern void dde_linux26_hrtimer_delay(s64 ns);
+
+/**
+ * Block current task for 'ns' nanoseconds unless it is woken up earlier
+ *
+ * \return  nanoseconds left
+ */
+extern s64 dde_linux26_schedule_hrtimeout(s64 ns);
+
 /**
  * Initialize memory subsystem
  */
@@ -143,4 +199,43 @@ extern void dde_linux26_kmalloc_init(void);
  */
 extern void dde_linux26_printk_init(void);
 
+/**
+ * Custom backing store of a kmem_cache
+ *
+ * The functions are called with the cache lock held.
+ */
+struct dde_linux26_slab_backend
+{
+	void *(*alloc)(void *priv);
+	void  (*free)(void *priv, void *objp);
+	void  *priv;
+};
+
+/**
+ * Create kmem_cache that obtains its objects from a custom backing store
+ */
+extern struct kmem_cache *
+dde_linux26_kmem_cache_create_backed(const char *name, size_t size,
+                                     struct dde_linux26_slab_backend const *backend);
+
+/**
+ * Register foreign memory region with kfree()
+ *
+ * kfree() of an address within the region calls 'backend->free'.
+ */
+extern int dde_linux26_kmalloc_add_region(void *base, unsigned long size,
+                                          struct dde_linux26_slab_backend const *backend);
+
+/**
+ * Unregister foreign memory region starting at 'base'
+ *
+ * No object of the region may be in use anymore.
+ */
+extern void dde_linux26_kmalloc_remove_region(void *base);
+
+/**
+ * Release per-thread kmem_cache magazines of exiting thread
+ */
+extern void dde_linux26_kmem_cache_thread_exit(dde_linux26_thread_data *t);
+
 #endif /* _ARCH__DDE_KIT__LOCAL_H_ */
@@ -19,16 +19,368 @@
 
 #include <dde_linux26/net.h>
 
-#include <asm/delay.h>
+#include <linux/delay.h>
 #include <linux/kernel.h>
 #include <linux/skbuff.h>
 #include <linux/netdevice.h>
 #include <linux/if_ether.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include "local.h"
 
 
-dde_linux26_net_rx_cb current_rx_callback = NULL;
+dde_linux26_net_rx_cb       current_rx_callback       = NULL;
+dde_linux26_net_rx_burst_cb current_rx_burst_callback = NULL;
+dde_linux26_net_link_cb     current_link_callback     = NULL;
+
+/* threads waiting for link changes */
+static DECLARE_WAIT_QUEUE_HEAD(link_wait);
+
+
+/********************************
+ ** Client-provided rx buffers **
+ ********************************/
+
+/*
+ * Drivers may receive directly into buffers provided by the client of a
+ * device. Such buffers never enter the skb pool. They return to the client
+ * when the skb is freed, as the buffer region is known to kfree(). An
+ * unregistered region is drained: It provides no new buffers and is released
+ * when its last buffer was freed.
+ */
+
+enum { MAX_RX_BUFFER_REGIONS = 4 };
+
+enum { RX_REGION_FREE, RX_REGION_ACTIVE, RX_REGION_DRAINING };
+
+static struct rx_buffer_region
+{
+	int                                    state;
+	unsigned                               if_index;
+	unsigned long                          in_use;  /* buffers not yet freed */
+	struct dde_linux26_net_rx_buffer_alloc alloc;
+	struct dde_linux26_slab_backend        backend;
+} rx_buffer_regions[MAX_RX_BUFFER_REGIONS];
+
+static DEFINE_SPINLOCK(rx_buffer_regions_lock);
+
+
+static struct rx_buffer_region *find_rx_buffer_region(unsigned if_index)
+{
+	unsigned i;
+
+	for (i = 0; i < MAX_RX_BUFFER_REGIONS; i++) {
+		struct rx_buffer_region *r = &rx_buffer_regions[i];
+
+		if (r->state != RX_REGION_ACTIVE)
+			continue;
+
+		smp_rmb();
+		if (r->if_index == if_index)
+			return r;
+	}
+
+	return NULL;
+}
+
+
+static int rx_buffer_foreign(const void *addr)
+{
+	unsigned i;
+
+	for (i = 0; i < MAX_RX_BUFFER_REGIONS; i++) {
+		struct dde_linux26_net_rx_buffer_alloc *a = &rx_buffer_regions[i].alloc;
+
+		if (rx_buffer_regions[i].state == RX_REGION_FREE)
+			continue;
+
+		smp_rmb();
+		if ((unsigned long)addr - (unsigned long)a->base < a->size)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Release drained region (called with regions lock held)
+ *
+ * \param out  allocator to be notified by the caller after unlocking, as the
+ *             slot may be reused right away
+ */
+static void rx_buffer_region_release_locked(struct rx_buffer_region *r,
+                                            struct dde_linux26_net_rx_buffer_alloc *out)
+{
+	dde_linux26_kmalloc_remove_region(r->alloc.base);
+	*out     = r->alloc;
+	r->state = RX_REGION_FREE;
+}
+
+
+static void rx_buffer_free(void *priv, void *buf)
+{
+	struct rx_buffer_region *r = priv;
+	struct dde_linux26_net_rx_buffer_alloc released = { .release = NULL };
+
+	r->alloc.free(r->alloc.priv, buf);
+
+	spin_lock(&rx_buffer_regions_lock);
+	if (--r->in_use == 0 && r->state == RX_REGION_DRAINING)
+		rx_buffer_region_release_locked(r, &released);
+	spin_unlock(&rx_buffer_regions_lock);
+
+	if (released.release)
+		released.release(released.priv);
+}
+
+
+/**************
+ ** skb pool **
+ **************/
+
+/*
+ * Data areas with room for a full ethernet frame are recycled instead of
+ * freed. Pool skbs carry skb_pool_destructor(), which is called when the last
+ * reference to the skb is dropped or when a driver orphans the skb. The
+ * destructor takes an extra reference to the data area, so it outlives the
+ * skb, and parks it on the pending ring. Pending areas become free once
+ * their data reference is the only one left. Thus, no reference to the skb
+ * itself is held while the driver owns it, and drivers may expand or modify
+ * the skb head as usual. Received skbs get the destructor when they are
+ * handed back after the rx callback.
+ */
+
+enum {
+	SKB_POOL_HEADROOM = 64,   /* room for link-layer encapsulation */
+	SKB_POOL_MTU      = 1536,
+	SKB_POOL_SIZE     = 256,  /* max data areas held by the pool */
+};
+
+struct skb_pool_data
+{
+	u8       *head;
+	unsigned  size;  /* of data area without skb_shared_info */
+};
+
+static struct
+{
+	int                  enabled;
+
+	struct skb_pool_data free[SKB_POOL_SIZE];
+	unsigned             num_free;
+
+	struct skb_pool_data pending[SKB_POOL_SIZE];  /* data areas still in use */
+	unsigned             num_pending;
+
+	struct dde_linux26_net_skb_pool_stats stats;
+} skb_pool = { .enabled = 1 };
+
+static DEFINE_SPINLOCK(skb_pool_lock);
+
+
+static inline struct skb_shared_info *skb_pool_shinfo(struct skb_pool_data *d)
+{
+	return (struct skb_shared_info *)(d->head + d->size);
+}
+
+
+static int skb_data_recyclable(struct sk_buff *skb)
+{
+	if (skb->nohdr || skb_shinfo(skb)->nr_frags || skb_shinfo(skb)->frag_list)
+		return 0;
+
+	if (rx_buffer_foreign(skb->head))
+		return 0;
+
+	return skb->end - skb->head >= SKB_POOL_HEADROOM + SKB_POOL_MTU;
+}
+
+
+/**
+ * Take data area of skb into pool
+ *
+ * Called from __kfree_skb() right before the data reference of the skb is
+ * dropped, or from skb_orphan() while the skb stays in use.
+ */
+static void skb_pool_destructor(struct sk_buff *skb)
+{
+	spin_lock(&skb_pool_lock);
+
+	if (!skb_pool.enabled
+	 || skb_pool.num_free + skb_pool.num_pending == SKB_POOL_SIZE
+	 || !skb_data_recyclable(skb)) {
+		skb_pool.stats.dropped++;
+		spin_unlock(&skb_pool_lock);
+		return;
+	}
+
+	/* keep the data area alive beyond skb_release_data() */
+	skb->cloned = 1;
+	atomic_inc(&skb_shinfo(skb)->dataref);
+
+	skb_pool.pending[skb_pool.num_pending].head = skb->head;
+	skb_pool.pending[skb_pool.num_pending].size = skb->end - skb->head;
+	skb_pool.num_pending++;
+	skb_pool.stats.recycled++;
+
+	spin_unlock(&skb_pool_lock);
+}
+
+
+/**
+ * Move pending data areas no skb refers to anymore to the free list
+ */
+static void skb_pool_reap_locked(void)
+{
+	unsigned i, n = 0;
+
+	for (i = 0; i < skb_pool.num_pending; i++) {
+		struct skb_pool_data *d = &skb_pool.pending[i];
+
+		if (atomic_read(&skb_pool_shinfo(d)->dataref) == 1)
+			skb_pool.free[skb_pool.num_free++] = *d;
+		else
+			skb_pool.pending[n++] = *d;
+	}
+
+	skb_pool.num_pending = n;
+}
+
+
+/**
+ * Set up skb around data area as done by alloc_skb()
+ */
+static void skb_set_data(struct sk_buff *skb, u8 *data, unsigned size)
+{
+	struct skb_shared_info *shinfo;
+
+	skb->truesize = size + sizeof(struct sk_buff);
+	skb->head     = data;
+	skb->data     = data;
+	skb->tail     = data;
+	skb->end      = data + size;
+
+	shinfo = skb_shinfo(skb);
+	atomic_set(&shinfo->dataref, 1);
+	shinfo->nr_frags    = 0;
+	shinfo->gso_size    = 0;
+	shinfo->gso_segs    = 0;
+	shinfo->gso_type    = 0;
+	shinfo->ip6_frag_id = 0;
+	shinfo->frag_list   = NULL;
+}
+
+
+/**
+ * Get skb for transmission of len bytes
+ */
+static struct sk_buff *skb_pool_get(unsigned len)
+{
+	struct skb_pool_data d = { NULL, 0 };
+	struct sk_buff *skb;
+
+	if (!skb_pool.enabled || len > SKB_POOL_MTU)
+		return alloc_skb(len, GFP_KERNEL);
+
+	spin_lock(&skb_pool_lock);
+	if (!skb_pool.num_free)
+		skb_pool_reap_locked();
+
+	if (skb_pool.num_free) {
+		d = skb_pool.free[--skb_pool.num_free];
+		skb_pool.stats.hits++;
+	} else
+		skb_pool.stats.misses++;
+	spin_unlock(&skb_pool_lock);
+
+	if (d.head) {
+		/* replace the minimal data area of a fresh skb by the pooled one */
+		skb = alloc_skb(0, GFP_KERNEL);
+		if (!skb) {
+			kfree(d.head);
+			return NULL;
+		}
+		kfree(skb->head);
+		skb_set_data(skb, d.head, d.size);
+	} else {
+		/* allocate buffer suitable for the pool */
+		skb = alloc_skb(SKB_POOL_HEADROOM + SKB_POOL_MTU, GFP_KERNEL);
+		if (!skb)
+			return NULL;
+	}
+
+	skb_reserve(skb, SKB_POOL_HEADROOM);
+	skb->destructor = skb_pool_destructor;
+	return skb;
+}
+
+
+/**
+ * Free received skb, returning its data area to the pool
+ */
+static void skb_pool_put(struct sk_buff *skb)
+{
+	if (skb_pool.enabled && !skb->destructor)
+		skb->destructor = skb_pool_destructor;
+
+	kfree_skb(skb);
+}
+
+
+/*
+ * With a burst callback registered, received skbs are collected and handed
+ * out when the batch is full or when the softnet thread finished its
+ * current poll round.
+ */
+static struct sk_buff_head rx_batch;
+
+
+/**
+ * Hand out up to DDE_LINUX26_NET_BURST_MAX packets of one device
+ *
+ * \return number of packets delivered
+ */
+static unsigned rx_deliver_burst(void)
+{
+	struct dde_linux26_net_iovec iov[DDE_LINUX26_NET_BURST_MAX];
+	struct sk_buff              *skbs[DDE_LINUX26_NET_BURST_MAX];
+	struct sk_buff              *skb;
+	unsigned long                flags;
+	unsigned                     n = 0, i;
+	int                          if_index = 0;
+
+	spin_lock_irqsave(&rx_batch.lock, flags);
+	while (n < DDE_LINUX26_NET_BURST_MAX && (skb = skb_peek(&rx_batch))) {
+		if (n && skb->dev->ifindex != if_index)
+			break;
+
+		__skb_unlink(skb, &rx_batch);
+		if_index     = skb->dev->ifindex;
+		skbs[n]      = skb;
+		iov[n].packet     = skb->data;
+		iov[n].packet_len = skb->len;
+		n++;
+	}
+	spin_unlock_irqrestore(&rx_batch.lock, flags);
+
+	if (!n) return 0;
+
+	if (current_rx_burst_callback)
+		current_rx_burst_callback(if_index, iov, n);
+
+	for (i = 0; i < n; i++)
+		skb_pool_put(skbs[i]);
+
+	return n;
+}
+
+
+void dde_linux26_net_rx_flush(void)
+{
+	while (rx_deliver_burst()) ;
+}
 
 
 int dde_linux26_do_rx_callback(struct sk_buff *s)
@@ -39,11 +391,22 @@ int dde_linux26_do_rx_callback(struct sk_buff *s)
 	 */
 	skb_push(s, ETH_HLEN);
 
+	if (current_rx_burst_callback != NULL) {
+		skb_queue_tail(&rx_batch, s);
+
+		if (skb_queue_len(&rx_batch) >= DDE_LINUX26_NET_BURST_MAX)
+			dde_linux26_net_rx_flush();
+		else
+			dde_linux26_softnet_schedule();
+
+		return NET_RX_SUCCESS;
+	}
+
 	if (current_rx_callback != NULL) {
 		current_rx_callback(s->dev->ifindex, s->data, s->len);
 	}
 
-	kfree_skb(s);
+	skb_pool_put(s);
 
 	return NET_RX_SUCCESS;
 }
@@ -53,17 +416,119 @@ int dde_linux26_do_rx_callback(struct sk_buff *s)
  ** User API **
  **************/
 
-int dde_linux26_net_tx(unsigned if_index, const unsigned char *packet, unsigned packet_len)
+/*************************
+ ** Transmit queue wake **
+ *************************/
+
+/*
+ * Senders wait for a stopped transmit queue on a per-device wait queue, which
+ * is woken by __netif_schedule() when the driver calls netif_wake_queue().
+ * Drivers that restart the queue via netif_start_queue() are covered by a
+ * timeout.
+ */
+
+enum { TX_WAIT_TIMEOUT = HZ / 10 };
+
+struct net_tx_queue
 {
-	/* find device */
-	struct net_device *dev = dev_get_by_index(if_index);
-	if (!dev) {
-		printk("network device %d unknown\n", if_index);
-		return -1;
+	struct list_head   list;
+	struct net_device *dev;
+	wait_queue_head_t  wait;
+};
+
+static LIST_HEAD(net_tx_queues);
+static DEFINE_SPINLOCK(net_tx_queues_lock);
+
+
+static struct net_tx_queue *find_tx_queue(struct net_device *dev)
+{
+	struct net_tx_queue *q;
+
+	list_for_each_entry(q, &net_tx_queues, list)
+		if (q->dev == dev)
+			return q;
+
+	return NULL;
+}
+
+
+static struct net_tx_queue *tx_queue(struct net_device *dev)
+{
+	struct net_tx_queue *q, *n = NULL;
+
+	spin_lock(&net_tx_queues_lock);
+	q = find_tx_queue(dev);
+	spin_unlock(&net_tx_queues_lock);
+
+	if (q) return q;
+
+	n = kmalloc(sizeof(*n), GFP_KERNEL);
+	if (!n) return NULL;
+
+	n->dev = dev;
+	init_waitqueue_head(&n->wait);
+
+	/* another sender may have won the race */
+	spin_lock(&net_tx_queues_lock);
+	q = find_tx_queue(dev);
+	if (!q) {
+		list_add(&n->list, &net_tx_queues);
+		q = n;
+		n = NULL;
 	}
+	spin_unlock(&net_tx_queues_lock);
+
+	kfree(n);
+	return q;
+}
+
+
+/**
+ * Block until the transmit queue of the device is started
+ */
+static void tx_queue_wait(struct net_device *dev)
+{
+	struct net_tx_queue *q = tx_queue(dev);
+
+	while (netif_queue_stopped(dev)) {
+		if (q)
+			wait_event_timeout(q->wait, !netif_queue_stopped(dev), TX_WAIT_TIMEOUT);
+		else
+			msleep(1);
+	}
+}
+
+
+void dde_linux26_net_tx_wake(struct net_device *dev)
+{
+	struct net_tx_queue *q;
+
+	spin_lock(&net_tx_queues_lock);
+	q = find_tx_queue(dev);
+	spin_unlock(&net_tx_queues_lock);
+
+	if (q)
+		wake_up(&q->wait);
+}
+
+
+/**
+ * Transmit packet
+ *
+ * \param block  wait for a stopped transmit queue instead of failing
+ *
+ * \return 0 on success, -EAGAIN if the transmit queue is full and block is 0,
+ *         -1 otherwise
+ */
+static int net_tx(struct net_device *dev, const unsigned char *packet,
+                  unsigned packet_len, int block)
+{
+	/* do not copy the packet if it cannot be sent anyway */
+	if (!block && netif_queue_stopped(dev))
+		return -EAGAIN;
 
 	/* prepare socket buffer */
-	struct sk_buff *skb = alloc_skb(packet_len, GFP_KERNEL);
+	struct sk_buff *skb = skb_pool_get(packet_len);
 	if (!skb) {
 		printk("out of memory for socket buffers\n");
 		return -1;
@@ -75,13 +540,13 @@ int dde_linux26_net_tx(unsigned if_index, const unsigned char *packet, unsigned
 	/* deliver packet */
 	int xmit;
 	do {
-		/*
-		 * Wait some time (1ms) until the drivers calls netif_wake_
-		 * queue(dev). We don't do l4_yield() here because that
-		 * does not work if the priority of the IRQ threads(!) is
-		 * less than the current priority.
-		 */
-		while (netif_queue_stopped(dev)) udelay(1000);
+		if (netif_queue_stopped(dev)) {
+			if (!block) {
+				xmit = NETDEV_TX_BUSY;
+				break;
+			}
+			tx_queue_wait(dev);
+		}
 
 		/*
 		 * Note: We could also use Linux' dev->queue_xmit() functions.
@@ -94,14 +559,72 @@ int dde_linux26_net_tx(unsigned if_index, const unsigned char *packet, unsigned
 //		xmit_lock(dev->ifindex);
 		xmit = dev->hard_start_xmit(skb, dev);
 //		xmit_unlock(dev->ifindex);
-		if (xmit) printk("Error sending packet: %d\n", xmit);
-	} while (xmit != 0);
+		if (xmit && block) printk("Error sending packet: %d\n", xmit);
+	} while (block && xmit != 0);
+
+	/* the driver did not take the skb */
+	if (xmit) {
+		kfree_skb(skb);
+		return -EAGAIN;
+	}
 
-	dev_put(dev);
 	return 0;
 }
 
 
+static struct net_device *get_device(unsigned if_index)
+{
+	struct net_device *dev = dev_get_by_index(if_index);
+	if (!dev)
+		printk("network device %d unknown\n", if_index);
+
+	return dev;
+}
+
+
+int dde_linux26_net_tx(unsigned if_index, const unsigned char *packet, unsigned packet_len)
+{
+	struct net_device *dev = get_device(if_index);
+	int err;
+
+	if (!dev) return -1;
+
+	err = net_tx(dev, packet, packet_len, 1);
+	dev_put(dev);
+	return err;
+}
+
+
+int dde_linux26_net_tx_try(unsigned if_index, const unsigned char *packet, unsigned packet_len)
+{
+	struct net_device *dev = get_device(if_index);
+	int err;
+
+	if (!dev) return -1;
+
+	err = net_tx(dev, packet, packet_len, 0);
+	dev_put(dev);
+	return err;
+}
+
+
+int dde_linux26_net_tx_burst(unsigned if_index, const struct dde_linux26_net_iovec *iov,
+                             unsigned n)
+{
+	struct net_device *dev = get_device(if_index);
+	unsigned i;
+
+	if (!dev) return -1;
+
+	for (i = 0; i < n; i++)
+		if (net_tx(dev, iov[i].packet, iov[i].packet_len, 1))
+			break;
+
+	dev_put(dev);
+	return i;
+}
+
+
 dde_linux26_net_rx_cb dde_linux26_net_register_rx_callback(dde_linux26_net_rx_cb cb)
 {
 	dde_linux26_net_rx_cb old = current_rx_callback;
@@ -111,6 +634,192 @@ dde_linux26_net_rx_cb dde_linux26_net_register_rx_callback(dde_linux26_net_rx_cb
 	return old;
 }
 
+
+dde_linux26_net_rx_burst_cb dde_linux26_net_register_rx_burst_callback(dde_linux26_net_rx_burst_cb cb)
+{
+	dde_linux26_net_rx_burst_cb old = current_rx_burst_callback;
+
+	current_rx_burst_callback = cb;
+
+	/* hand out packets collected for the old callback */
+	if (old)
+		dde_linux26_net_rx_flush();
+
+	return old;
+}
+
+int dde_linux26_net_register_rx_buffer_alloc(unsigned if_index,
+                                             const struct dde_linux26_net_rx_buffer_alloc *alloc)
+{
+	struct rx_buffer_region *r = NULL;
+	unsigned i;
+	int err;
+
+	spin_lock(&rx_buffer_regions_lock);
+
+	for (i = 0; i < MAX_RX_BUFFER_REGIONS && !r; i++)
+		if (rx_buffer_regions[i].state == RX_REGION_FREE)
+			r = &rx_buffer_regions[i];
+
+	if (find_rx_buffer_region(if_index) || !r) {
+		spin_unlock(&rx_buffer_regions_lock);
+		return -EBUSY;
+	}
+
+	r->if_index     = if_index;
+	r->in_use       = 0;
+	r->alloc        = *alloc;
+	r->backend.free = rx_buffer_free;
+	r->backend.priv = r;
+
+	err = dde_linux26_kmalloc_add_region(alloc->base, alloc->size, &r->backend);
+	if (!err) {
+		smp_wmb();
+		r->state = RX_REGION_ACTIVE;
+	}
+
+	spin_unlock(&rx_buffer_regions_lock);
+	return err;
+}
+
+
+int dde_linux26_net_unregister_rx_buffer_alloc(unsigned if_index)
+{
+	struct dde_linux26_net_rx_buffer_alloc released = { .release = NULL };
+	struct rx_buffer_region *r;
+	int err = 0;
+
+	spin_lock(&rx_buffer_regions_lock);
+
+	r = find_rx_buffer_region(if_index);
+	if (!r) {
+		spin_unlock(&rx_buffer_regions_lock);
+		return -EINVAL;
+	}
+
+	r->state = RX_REGION_DRAINING;
+	if (r->in_use)
+		err = -EBUSY;
+	else
+		rx_buffer_region_release_locked(r, &released);
+
+	spin_unlock(&rx_buffer_regions_lock);
+
+	if (released.release)
+		released.release(released.priv);
+
+	return err;
+}
+
+
+struct sk_buff *dde_linux26_net_alloc_rx_skb(struct net_device *dev, unsigned size)
+{
+	struct rx_buffer_region *r;
+	struct sk_buff          *skb;
+	unsigned                 data_size = SKB_DATA_ALIGN(size + NET_SKB_PAD);
+	u8                      *data = NULL;
+
+	/* the lock keeps the region from being unregistered meanwhile */
+	spin_lock(&rx_buffer_regions_lock);
+	r = find_rx_buffer_region(dev->ifindex);
+	if (r) {
+		data = r->alloc.alloc(r->alloc.priv, data_size + sizeof(struct skb_shared_info));
+		if (data)
+			r->in_use++;
+	}
+	spin_unlock(&rx_buffer_regions_lock);
+
+	if (!data) return dev_alloc_skb(size);
+
+	/* replace the minimal data area of a fresh skb by the client buffer */
+	skb = alloc_skb(0, GFP_ATOMIC);
+	if (!skb) {
+		kfree(data);
+		return NULL;
+	}
+	kfree(skb->head);
+	skb_set_data(skb, data, data_size);
+
+	skb_reserve(skb, NET_SKB_PAD);
+	skb->dev = dev;
+	return skb;
+}
+
+
+void dde_linux26_net_skb_pool_enable(int enable)
+{
+	spin_lock(&skb_pool_lock);
+	skb_pool.enabled = enable;
+
+	if (!enable) {
+		while (skb_pool.num_free)
+			kfree(skb_pool.free[--skb_pool.num_free].head);
+
+		/* drop our reference to data areas that may still be used by drivers */
+		while (skb_pool.num_pending) {
+			struct skb_pool_data *d = &skb_pool.pending[--skb_pool.num_pending];
+			if (atomic_dec_and_test(&skb_pool_shinfo(d)->dataref))
+				kfree(d->head);
+		}
+	}
+	spin_unlock(&skb_pool_lock);
+}
+
+
+void dde_linux26_net_skb_pool_stats(struct dde_linux26_net_skb_pool_stats *stats)
+{
+	spin_lock(&skb_pool_lock);
+	*stats = skb_pool.stats;
+	spin_unlock(&skb_pool_lock);
+}
+
+
+void dde_linux26_net_link_event(struct net_device *dev)
+{
+	if (current_link_callback)
+		current_link_callback(dev->ifindex, netif_carrier_ok(dev));
+
+	wake_up(&link_wait);
+}
+
+
+dde_linux26_net_link_cb dde_linux26_net_register_link_callback(dde_linux26_net_link_cb cb)
+{
+	dde_linux26_net_link_cb old = current_link_callback;
+
+	current_link_callback = cb;
+
+	return old;
+}
+
+
+int dde_linux26_net_link_state(unsigned if_index)
+{
+	struct net_device *dev = get_device(if_index);
+	int up;
+
+	if (!dev) return -1;
+
+	up = netif_carrier_ok(dev);
+	dev_put(dev);
+	return up;
+}
+
+
+int dde_linux26_net_wait_for_link(unsigned if_index, unsigned timeout_ms)
+{
+	struct net_device *dev = get_device(if_index);
+	long left;
+
+	if (!dev) return -1;
+
+	left = wait_event_timeout(link_wait, netif_carrier_ok(dev),
+	                          msecs_to_jiffies(timeout_ms));
+	dev_put(dev);
+	return left ? 0 : -ETIMEDOUT;
+}
+
+
 int dde_linux26_net_get_mac_addr(unsigned if_index, unsigned char *out_mac_addr)
 {
 	/* find device */
@@ -129,6 +838,7 @@ int dde_linux26_net_get_mac_addr(unsigned if_index, unsigned char *out_mac_addr)
 int dde_linux26_net_init(void)
 {
 	skb_init();
+	skb_queue_head_init(&rx_batch);
 
 	struct net_device *dev;
 	int err, cnt = 0;
@@ -6,13 +6,17 @@
  *
  * In Linux 2.6 this resides in mm/page_alloc.c.
  *
- * This implementation is far from complete as it does not cover "struct page"
- * emulation. In Linux, there's an array of structures for all pages. In
- * particular, iteration works for this array like:
+ * In Linux, there's an array of structures for all pages. In particular,
+ * iteration works for this array like:
  *
  *   struct page *p = alloc_pages(3); // p refers to first page of allocation
  *   ++p;                             // p refers to second page
  *
+ * We emulate this by a region descriptor per allocation, which embeds one
+ * "struct page" per page of the region (a mem_map of the region). All pages
+ * are entered into a page table hashed by page-frame number, which makes
+ * virt_to_page() O(1) for every page of an allocation.
+ *
  * There may be more things to cover and we should have a deep look into the
  * kernel parts we want to reuse. Candidates for problems may be file systems,
  * storage (USB, IDE), and video (bttv).
@@ -23,6 +27,8 @@
 #include <linux/string.h>
 #include <linux/pagevec.h>
 #include <linux/mm.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
 #include <asm/page.h>
 
 /* DDE kit */
@@ -54,106 +60,264 @@ unsigned long max_pfn;
  *   accessible as Linux pages to the DDE
  */
 
-#define DDE_PAGE_CACHE_SHIFT  10
-#define DDE_PAGE_CACHE_SIZE   (1 << DDE_PAGE_CACHE_SHIFT)
-#define DDE_PAGE_CACHE_MASK   (DDE_PAGE_CACHE_SIZE - 1)
+enum { DDE_PAGE_TABLE_MIN_SHIFT = 10 };
+
+/*
+ * Allocation of one or more pages via __get_free_pages()
+ */
+struct page_region
+{
+	unsigned long nr_pages;
+	struct page   pages[0];  /* mem_map of region */
+};
 
+/*
+ * Page table entry
+ *
+ * Pages handed in by external clients have no region.
+ */
 typedef struct
 {
-	struct hlist_node list;
-	struct page *page;
-} page_cache_entry;
+	unsigned long       pfn;
+	struct page        *page;    /* 0 if entry is unused */
+	struct page_region *region;
+} page_table_entry;
 
-static struct hlist_head dde_linux26_page_cache[DDE_PAGE_CACHE_SIZE];
+/*
+ * Open-addressing hash table with linear probing, which is resized to keep
+ * the load factor between 1/8 and 1/2. Inserting and removing pages does not
+ * allocate memory apart from resizing.
+ */
+static page_table_entry *dde_linux26_page_table;
+static unsigned          dde_linux26_page_table_shift;
+static unsigned long     dde_linux26_page_table_used;
+static DEFINE_SPINLOCK(dde_linux26_page_table_lock);
 
-/** Hash function to map virtual addresses to page cache buckets. */
-#define VIRT_TO_PAGEHASH(a)           ((((unsigned long)a) >> PAGE_SHIFT) & DDE_PAGE_CACHE_MASK)
+#define PAGE_TABLE_SIZE   (1UL << dde_linux26_page_table_shift)
+#define PAGE_TABLE_MASK   (PAGE_TABLE_SIZE - 1)
+#define VIRT_TO_PFN(a)    (((unsigned long)(a)) >> PAGE_SHIFT)
+#define PFN_TO_SLOT(pfn)  (hash_long(pfn, dde_linux26_page_table_shift))
 
 
-void dde_linux26_page_cache_add(struct page *p)
+static void page_table_put(page_table_entry *table, unsigned shift,
+                           page_table_entry const *e)
 {
-	unsigned int hashval = VIRT_TO_PAGEHASH(p->virtual);
+	unsigned long mask = (1UL << shift) - 1;
+	unsigned long i;
 
-	page_cache_entry *e = kmalloc(sizeof(page_cache_entry), GFP_KERNEL);
+	for (i = hash_long(e->pfn, shift); table[i].page && table[i].pfn != e->pfn;
+	     i = (i + 1) & mask) ;
 
-#if DEBUG_PAGE_ALLOC
-	DEBUG_MSG("virt %p, hash: %x", p->virtual, hashval);
-#endif
+	table[i] = *e;
+}
+
+
+/**
+ * Resize page table (called with table lock held)
+ */
+static int page_table_resize(unsigned shift)
+{
+	page_table_entry *table = dde_kit_simple_malloc(sizeof(*table) << shift);
+	unsigned long i;
+
+	if (!table) return -ENOMEM;
+	memset(table, 0, sizeof(*table) << shift);
+
+	if (dde_linux26_page_table) {
+		for (i = 0; i < PAGE_TABLE_SIZE; i++)
+			if (dde_linux26_page_table[i].page)
+				page_table_put(table, shift, &dde_linux26_page_table[i]);
 
-	e->page = p;
-	INIT_HLIST_NODE(&e->list);
+		dde_kit_simple_free(dde_linux26_page_table);
+	}
+
+	dde_linux26_page_table       = table;
+	dde_linux26_page_table_shift = shift;
 
-	hlist_add_head(&e->list, &dde_linux26_page_cache[hashval]);
+	return 0;
 }
 
 
-void dde_linux26_page_cache_remove(struct page *p)
+static page_table_entry *page_table_find(unsigned long pfn)
+{
+	unsigned long i;
+
+	if (!dde_linux26_page_table) return NULL;
+
+	for (i = PFN_TO_SLOT(pfn); dde_linux26_page_table[i].page;
+	     i = (i + 1) & PAGE_TABLE_MASK)
+		if (dde_linux26_page_table[i].pfn == pfn)
+			return &dde_linux26_page_table[i];
+
+	return NULL;
+}
+
+
+static int page_table_insert(struct page *page, struct page_region *region)
 {
-	unsigned int hashval = VIRT_TO_PAGEHASH(p->virtual);
-	struct hlist_node *hn = NULL;
-	struct hlist_head *h  = &dde_linux26_page_cache[hashval];
-	page_cache_entry *e   = NULL;
-	struct hlist_node *v  = NULL;
-
-	hlist_for_each_entry(e, hn, h, list) {
-		if ((unsigned long)e->page->virtual == ((unsigned long)p->virtual & PAGE_MASK))
-			v = hn;
+	page_table_entry e = { VIRT_TO_PFN(page->virtual), page, region };
+
+	if (!dde_linux26_page_table
+	 && page_table_resize(DDE_PAGE_TABLE_MIN_SHIFT))
+		return -ENOMEM;
+
+	if ((dde_linux26_page_table_used + 1) * 2 > PAGE_TABLE_SIZE
+	 && page_table_resize(dde_linux26_page_table_shift + 1))
+		return -ENOMEM;
+
+	if (!page_table_find(e.pfn))
+		dde_linux26_page_table_used++;
+
+	page_table_put(dde_linux26_page_table, dde_linux26_page_table_shift, &e);
+	return 0;
+}
+
+
+/**
+ * Remove entry by shifting back subsequent entries of the probe sequence
+ */
+static void page_table_remove(page_table_entry *e)
+{
+	unsigned long i = e - dde_linux26_page_table;
+	unsigned long j = i;
+
+	for (;;) {
+		unsigned long k;
+
+		j = (j + 1) & PAGE_TABLE_MASK;
+		if (!dde_linux26_page_table[j].page)
 			break;
+
+		/* entry j may fill the hole at i unless its home slot lies in (i, j] */
+		k = PFN_TO_SLOT(dde_linux26_page_table[j].pfn);
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+
+		dde_linux26_page_table[i] = dde_linux26_page_table[j];
+		i = j;
 	}
 
-	if (v) {
+	dde_linux26_page_table[i].page = NULL;
+	dde_linux26_page_table_used--;
+
+	if (dde_linux26_page_table_shift > DDE_PAGE_TABLE_MIN_SHIFT
+	 && dde_linux26_page_table_used * 8 < PAGE_TABLE_SIZE)
+		page_table_resize(dde_linux26_page_table_shift - 1);
+}
+
+
+void dde_linux26_page_cache_add(struct page *p)
+{
+#if DEBUG_PAGE_ALLOC
+	DEBUG_MSG("virt %p", p->virtual);
+#endif
+
+	spin_lock(&dde_linux26_page_table_lock);
+	if (page_table_insert(p, NULL))
+		printk("could not add page %p to page table\n", p->virtual);
+	spin_unlock(&dde_linux26_page_table_lock);
+}
+
+
+void dde_linux26_page_cache_remove(struct page *p)
+{
+	page_table_entry *e;
+
+	spin_lock(&dde_linux26_page_table_lock);
+	e = page_table_find(VIRT_TO_PFN(p->virtual));
+	if (e && e->page == p) {
 #if DEBUG_PAGE_ALLOC
-		DEBUG_MSG("deleting node %p which contained page %p", v, p);
+		DEBUG_MSG("deleting entry %p which contained page %p", e, p);
 #endif
-		hlist_del(v);
+		page_table_remove(e);
 	}
+	spin_unlock(&dde_linux26_page_table_lock);
 }
 
 
 struct page* dde_linux26_page_lookup(unsigned long va)
 {
-	unsigned int hashval = VIRT_TO_PAGEHASH(va);
+	page_table_entry *e;
+	struct page      *page;
+
 #if DEBUG_PAGE_ALLOC
 	DEBUG_MSG("%p", (void*)va);
 #endif
 
-	struct hlist_node *hn = NULL;
-	struct hlist_head *h  = &dde_linux26_page_cache[hashval];
-	page_cache_entry *e   = NULL;
+	spin_lock(&dde_linux26_page_table_lock);
+	e    = page_table_find(VIRT_TO_PFN(va));
+	page = e ? e->page : NULL;
+	spin_unlock(&dde_linux26_page_table_lock);
+
+	return page;
+}
+
+
+/**
+ * Allocate pages and enter their region into the page table
+ */
+static struct page_region *alloc_region(gfp_t gfp_mask, unsigned int order)
+{
+	unsigned long       nr_pages = 1UL << order;
+	struct page_region *region;
+	unsigned long       i;
+	void               *va;
 
-	hlist_for_each_entry(e, hn, h, list) {
-		if ((unsigned long)e->page->virtual == (va & PAGE_MASK))
-			return e->page;
+	dde_kit_log(DEBUG_PAGE_ALLOC, "gfp_mask=%x order=%d (%ld bytes)",
+	           gfp_mask, order, PAGE_SIZE << order);
+
+	dde_kit_assert(gfp_mask != GFP_DMA);
+
+	region = dde_kit_simple_malloc(sizeof(*region) + nr_pages * sizeof(struct page));
+	if (!region) return NULL;
+
+	va = dde_kit_large_malloc(PAGE_SIZE << order);
+	if (!va) {
+		dde_kit_simple_free(region);
+		return NULL;
 	}
 
-	return NULL;
+	memset(region->pages, 0, nr_pages * sizeof(struct page));
+	region->nr_pages = nr_pages;
+	for (i = 0; i < nr_pages; i++)
+		region->pages[i].virtual = (char *)va + i * PAGE_SIZE;
+	init_page_count(&region->pages[0]);
+
+	spin_lock(&dde_linux26_page_table_lock);
+	for (i = 0; i < nr_pages; i++)
+		if (page_table_insert(&region->pages[i], region))
+			break;
+
+	/* roll back on failure */
+	if (i < nr_pages) {
+		while (i--)
+			page_table_remove(page_table_find(VIRT_TO_PFN(region->pages[i].virtual)));
+		spin_unlock(&dde_linux26_page_table_lock);
+
+		dde_kit_large_free(va);
+		dde_kit_simple_free(region);
+		return NULL;
+	}
+	spin_unlock(&dde_linux26_page_table_lock);
+
+	return region;
 }
 
 
 struct page * fastcall __alloc_pages(gfp_t gfp_mask, unsigned int order,
                                      struct zonelist *zonelist)
 {
-	/* XXX: In fact, according to order, we should have one struct page
-	 *      for every page, not only for the first one.
-	 */
-	struct page *ret = kmalloc(sizeof(*ret), GFP_KERNEL);
-	
-	ret->virtual = (void *)__get_free_pages(gfp_mask, order);
-	dde_linux26_page_cache_add(ret);
-
-	return ret;
+	struct page_region *region = alloc_region(gfp_mask, order);
+
+	return region ? &region->pages[0] : NULL;
 }
 
 
 fastcall unsigned long __get_free_pages(gfp_t gfp_mask, unsigned int order)
 {
-	dde_kit_log(DEBUG_PAGE_ALLOC, "gfp_mask=%x order=%d (%ld bytes)",
-	           gfp_mask, order, PAGE_SIZE << order);
-
-	dde_kit_assert(gfp_mask != GFP_DMA);
-	void *p = dde_kit_large_malloc(PAGE_SIZE << order);
+	struct page_region *region = alloc_region(gfp_mask, order);
 
-	return (unsigned long)p;
+	return region ? (unsigned long)region->pages[0].virtual : 0;
 }
 
 
@@ -172,14 +336,9 @@ void fastcall free_hot_page(struct page *page)
 	WARN_UNIMPL;
 }
 
-/* 
- * XXX: If alloc_pages() gets fixed to allocate a page struct per page,
- *      this needs to be adapted, too.
- */
 fastcall void __free_pages(struct page *page, unsigned int order)
 {
 	free_pages((unsigned long)page->virtual, order);
-	dde_linux26_page_cache_remove(page);
 }
 
 void __pagevec_free(struct pagevec *pvec)
@@ -203,8 +362,22 @@ int get_user_pages(struct task_struct *tsk, struct mm_struct *mm,
  */
 fastcall void free_pages(unsigned long addr, unsigned int order)
 {
+	struct page_region *region = NULL;
+	page_table_entry   *e;
+	unsigned long       i;
+
 	dde_kit_log(DEBUG_PAGE_ALLOC, "addr=%p order=%d", (void *)addr, order);
 
+	spin_lock(&dde_linux26_page_table_lock);
+	e = page_table_find(VIRT_TO_PFN(addr));
+	if (e && e->region && e->page == &e->region->pages[0]) {
+		region = e->region;
+		for (i = 0; i < region->nr_pages; i++)
+			page_table_remove(page_table_find(VIRT_TO_PFN(region->pages[i].virtual)));
+	}
+	spin_unlock(&dde_linux26_page_table_lock);
+
+	dde_kit_simple_free(region);
 	dde_kit_large_free((void *)addr);
 }
 
@@ -282,10 +455,11 @@ void *__init alloc_large_system_hash(const char *tablename,
 static int __init dde_linux26_page_cache_init(void)
 {
 	printk("Initializing DDE Linux 2.6 page cache\n");
-	int i=0;
 
-	for (i; i < DDE_PAGE_CACHE_SIZE; ++i)
-		INIT_HLIST_HEAD(&dde_linux26_page_cache[i]);
+	spin_lock(&dde_linux26_page_table_lock);
+	if (!dde_linux26_page_table)
+		page_table_resize(DDE_PAGE_TABLE_MIN_SHIFT);
+	spin_unlock(&dde_linux26_page_table_lock);
 
 	return 0;
 }
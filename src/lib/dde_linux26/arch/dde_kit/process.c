@@ -166,6 +166,7 @@ fastcall void do_exit(long code)
 
 	/* do some cleanup */
 	detach_pid(current, 0);
+	dde_linux26_kmem_cache_thread_exit(lxtask_to_ddethread(current));
 	
 	/* goodbye, cruel world... */
 	dde_kit_thread_exit();
@@ -214,6 +215,9 @@ static inline dde_linux26_thread_data *init_dde_linux26_thread(void)
 	/* initialize this thread's sleep lock */
 	SLEEP_LOCK(t) = dde_kit_sem_init(0);
 
+	/* kmem_cache magazines are allocated on first use */
+	t->_kmem_magazines = 0;
+
 	return t;
 }
 
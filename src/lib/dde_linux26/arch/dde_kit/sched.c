@@ -2,6 +2,8 @@
 
 #include <linux/sched.h>
 
+#include <asm/div64.h>
+
 DEFINE_RWLOCK(tasklist_lock);
 
 asmlinkage void preempt_schedule(void)
@@ -64,27 +66,29 @@ int try_to_wake_up(struct task_struct *p, unsigned int state, int sync)
 }
 
 
-static void process_timeout(unsigned long data)
-{
-	wake_up_process((struct task_struct *)data);
-}
-
-
+/*
+ * The timeout is measured from now with hrtimer precision instead of
+ * expiring at the tick boundary 'timeout' jiffies ahead.
+ */
 fastcall signed long __sched schedule_timeout(signed long timeout)
 {
-	struct timer_list timer;
-	unsigned long expire = timeout + jiffies;
+	u64 left;
+
+	if (timeout == MAX_SCHEDULE_TIMEOUT) {
+		schedule();
+		return timeout;
+	}
 
-	setup_timer(&timer, process_timeout, (unsigned long)current);
-	timer.expires = expire;
+	if (timeout < 0)
+		timeout = 0;
 
-	add_timer(&timer);
-	schedule();
-	del_timer(&timer);
+	left = dde_linux26_schedule_hrtimeout((s64)timeout * (NSEC_PER_SEC / HZ));
 
-	timeout = expire - jiffies;
+	/* round up to jiffies */
+	left += NSEC_PER_SEC / HZ - 1;
+	do_div(left, NSEC_PER_SEC / HZ);
 
-	return timeout < 0 ? 0 : timeout;
+	return (signed long)left;
 }
 
 
@@ -43,24 +43,22 @@
 
 struct Scsi_Host *scsi_host_alloc(struct scsi_host_template *t, int priv_size)
 {
-	DEBUG_MSG("t=%p, priv_size=%d", t, priv_size);
-
-	static int free = 1;
+	static unsigned short host_no = 0;
+	struct Scsi_Host *host;
 
-	/* XXX we not some extra space for hostdata[] */
-	static char buffer[4096] __attribute__((aligned(4096)));
-	static struct Scsi_Host *host = (struct Scsi_Host *)buffer;
+	DEBUG_MSG("t=%p, priv_size=%d", t, priv_size);
 
-	/* FIXME we support only one host for now */
-	if (!free) return 0;
-	free = 0;
+	/* hostdata[] follows the host structure */
+	host = (struct Scsi_Host *)kzalloc(sizeof(struct Scsi_Host) + priv_size, GFP_KERNEL);
+	if (!host) return 0;
 
 	host->host_lock = &host->default_lock;
 	spin_lock_init(host->host_lock);
 
-	host->host_no = 13;
-	host->max_id = 8;
-	host->hostt = t;
+	host->host_no = host_no++;
+	host->max_id  = 8;
+	host->max_lun = 8;
+	host->hostt   = t;
 
 //	rval = scsi_setup_command_freelist(shost);
 //	if (rval)
@@ -117,30 +115,47 @@ static void scsi_done(struct scsi_cmnd *cmd)
 	complete(cmd->back);
 }
 
-void scsi_scan_host(struct Scsi_Host *host)
+/**
+ * Probe LUN
+ *
+ * \return 0 if the LUN responded to INQUIRY, negative value otherwise
+ */
+static int scan_lun(struct Scsi_Host *host, unsigned int lun)
 {
 	struct scsi_cmnd   *cmnd;
 	struct scsi_device *sdev;
 	struct scsi_target *target;
 	struct completion compl;
-	void *result;
+	unsigned char *result;
+	int ret = 0;
 
 	init_completion(&compl);
 
 	cmnd = (struct scsi_cmnd *)kmalloc(sizeof(struct scsi_cmnd), GFP_KERNEL);
-	sdev = (struct scsi_device *)kmalloc(sizeof(struct scsi_device), GFP_KERNEL);
-	target = (struct scsi_target *)kmalloc(sizeof(struct scsi_target), GFP_KERNEL);
+	sdev = (struct scsi_device *)kzalloc(sizeof(struct scsi_device), GFP_KERNEL);
+	target = (struct scsi_target *)kzalloc(sizeof(struct scsi_target), GFP_KERNEL);
+
+	/* request queue, only used for transfer limits */
+	sdev->request_queue = (struct request_queue *)kzalloc(sizeof(struct request_queue), GFP_KERNEL);
+	blk_queue_max_sectors(sdev->request_queue, host->hostt->max_sectors
+	                                           ? host->hostt->max_sectors
+	                                           : SCSI_DEFAULT_MAX_SECTORS);
+	blk_queue_dma_alignment(sdev->request_queue, 511);
 
 	/* init device */
 	sdev->sdev_target = target;
 	sdev->host = host;
 	sdev->id  = 0;
-	sdev->lun = 0;
-	host->hostt->slave_alloc(sdev);
-	host->hostt->slave_configure(sdev);
+	sdev->lun = lun;
+	sdev->inquiry_len = 36;
+	if (host->hostt->slave_alloc)
+		host->hostt->slave_alloc(sdev);
+	if (host->hostt->slave_configure)
+		host->hostt->slave_configure(sdev);
 
 	/* inquiry (36 bytes for usb) */
 	result = kmalloc(sdev->inquiry_len, GFP_KERNEL);
+	memset(result, 0, sdev->inquiry_len);
 	memset(cmnd->cmnd, 0, MAX_COMMAND_SIZE);
 	cmnd->cmnd[0] = INQUIRY;
 	cmnd->cmnd[4] = sdev->inquiry_len;
@@ -149,21 +164,40 @@ void scsi_scan_host(struct Scsi_Host *host)
 	cmnd->sc_data_direction = DMA_FROM_DEVICE;
 	cmnd->request_buffer = result;
 	cmnd->request_bufflen = sdev->inquiry_len;
+	cmnd->result = 0;
 	cmnd->back = &compl;
 
 	host->hostt->queuecommand(cmnd, inquiry_done);
 	wait_for_completion(&compl);
 
+	/* LUN not supported by the device */
+	if (cmnd->result)
+		ret = -ENODEV;
+
 	/* if PQ and PDT are zero we have a direct access block device conntected */
-	if (!((char*)result)[0] && !dde_linux26_block_dev_add(sdev))
+	if (!ret && !result[0] && !dde_linux26_block_dev_add(sdev))
 	{}
 	else {
+		kfree(sdev->request_queue);
 		kfree(sdev);
 		kfree(target);
 	}
 
 	kfree(cmnd);
 	kfree(result);
+
+	return ret;
+}
+
+
+void scsi_scan_host(struct Scsi_Host *host)
+{
+	unsigned int lun;
+
+	/* scan sequentially until a LUN does not respond */
+	for (lun = 0; lun < host->max_lun; lun++)
+		if (scan_lun(host, lun))
+			break;
 }
 
 
@@ -192,11 +226,15 @@ void scsi_report_device_reset(struct Scsi_Host *host, int channel, int target)
  */
 void blk_queue_max_sectors(struct request_queue *q, unsigned int max_sectors)
 {
-	WARN_UNIMPL;
+	/* transfers must cover at least one page */
+	if ((max_sectors << 9) < PAGE_SIZE)
+		max_sectors = 1 << (PAGE_SHIFT - 9);
+
+	q->max_sectors = q->max_hw_sectors = max_sectors;
 }
 
 
 void blk_queue_dma_alignment(struct request_queue *q, int mask)
 {
-	WARN_UNIMPL;
+	q->dma_alignment = mask;
 }
@@ -3,67 +3,104 @@
  * \author  Björn Döbel
  * \author  Christian Helmuth
  * \date    2008-11-11
+ *
+ * Softirqs run in softirq threads, one per softirq context. As every DDE
+ * thread is a virtual CPU of its own, contexts are not bound to CPUs but to
+ * priorities: HI_SOFTIRQ has a context of its own and all other softirqs
+ * share the normal context. Thereby, high-priority tasklets (e.g., USB
+ * completions) and normal tasklets (e.g., network drivers) do not starve
+ * each other.
+ *
+ * Like ksoftirqd, a softirq thread restarts its pending softirqs at most
+ * MAX_SOFTIRQ_RESTART times and then yields before it continues. Tasklets
+ * are executed in FIFO order, at most TASKLET_BUDGET per round.
  */
 
+#include <linux/hrtimer.h>
 #include <linux/interrupt.h>
 
+#include <asm/div64.h>
+
+#include <dde_linux26/general.h>
+
 #include "local.h"
 
-/* There are at most 32 softirqs in Linux, but only 6 are really used. */
-#define NUM_SOFTIRQS 6
+/* There are at most 32 softirqs in Linux, but only 7 are really used. */
+#define NUM_SOFTIRQS (SCHED_SOFTIRQ + 1)
 
-DECLARE_INITVAR(dde_linux26_softirq);
+enum {
+	MAX_SOFTIRQ_RESTART = 10,
+	TASKLET_BUDGET      = 32,  /* tasklets per softirq round */
+};
 
-/* softirq wakeup semaphore */
-static struct dde_kit_sem *softirq_sem;
+DECLARE_INITVAR(dde_linux26_softirq);
 
 /* struct tasklet_head is not defined in a header in Linux 2.6 */
 struct tasklet_head
 {
-	struct tasklet_struct *list;
-	struct dde_kit_lock   *lock;  /* list lock */
+	struct tasklet_struct  *list;
+	struct tasklet_struct **tail;  /* next pointer of last tasklet */
+	spinlock_t              lock;  /* list lock */
 };
 
 /* What to do if a softirq occurs. */
 static struct softirq_action softirq_vec[32];
 
-/* tasklet queues for each softirq thread */
+/* tasklet queues */
 struct tasklet_head tasklet_vec;
 struct tasklet_head tasklet_hi_vec;
 
+enum { SOFTIRQ_CTX_HI, SOFTIRQ_CTX_NORMAL, NUM_SOFTIRQ_CTX };
+
+/**
+ * Softirq context executed by one softirq thread
+ */
+static struct softirq_ctx
+{
+	struct dde_kit_sem *sem;      /* wakeup semaphore */
+	unsigned long       pending;  /* raised softirqs */
+} softirq_ctx[NUM_SOFTIRQ_CTX];
+
+static struct
+{
+	atomic_t           raised;
+	unsigned long      run;
+	unsigned long long time_ns;
+} softirq_stat[NUM_SOFTIRQS];
+
+
+static inline struct softirq_ctx *softirq_to_ctx(unsigned int nr)
+{
+	return &softirq_ctx[nr == HI_SOFTIRQ ? SOFTIRQ_CTX_HI : SOFTIRQ_CTX_NORMAL];
+}
+
+
 void open_softirq(int nr, void (*action)(struct softirq_action*), void *data)
 {
 	softirq_vec[nr].action = action;
 	softirq_vec[nr].data   = data;
 }
 
-static void fastcall raise_softirq_irqoff_cpu(unsigned int nr, unsigned int cpu)
+void fastcall raise_softirq_irqoff(unsigned int nr)
 {
+	struct softirq_ctx *ctx = softirq_to_ctx(nr);
+
 	CHECK_INITVAR(dde_linux26_softirq);
 
-	/* mark softirq scheduled */
-	__raise_softirq_irqoff(nr);
-	/* wake softirq thread */
-	dde_kit_sem_up(softirq_sem);
-}
+	if (nr < NUM_SOFTIRQS)
+		atomic_inc(&softirq_stat[nr].raised);
 
-void fastcall raise_softirq_irqoff(unsigned int nr)
-{
-	raise_softirq_irqoff_cpu(nr, 0);
+	/* wake softirq thread unless the softirq is already pending */
+	if (!test_and_set_bit(nr, &ctx->pending))
+		dde_kit_sem_up(ctx->sem);
 }
 
 void fastcall raise_softirq(unsigned int nr)
 {
-	unsigned long flags;
-
-	local_irq_save(flags);
 	raise_softirq_irqoff(nr);
-	local_irq_restore(flags);
 }
 
 /** Initialize tasklet.
- *
- * Unimplemented.
  */
 void tasklet_init(struct tasklet_struct *t,
                   void (*func)(unsigned long), unsigned long data)
@@ -91,54 +128,54 @@ void tasklet_kill(struct tasklet_struct *t)
 
 EXPORT_SYMBOL(tasklet_kill);
 
-/* enqueue tasklet */
-static void __tasklet_enqueue(struct tasklet_struct *t, 
+/* enqueue tasklet at the tail */
+static void __tasklet_enqueue(struct tasklet_struct *t,
                               struct tasklet_head *listhead)
 {
-	dde_kit_lock_lock(listhead->lock);
-	t->next = listhead->list;
-	listhead->list = t;
-	dde_kit_lock_unlock(listhead->lock);
+	t->next = NULL;
+
+	spin_lock(&listhead->lock);
+	*listhead->tail = t;
+	listhead->tail  = &t->next;
+	spin_unlock(&listhead->lock);
 }
 
 void fastcall __tasklet_schedule(struct tasklet_struct *t)
 {
-	unsigned long flags;
-
 	CHECK_INITVAR(dde_linux26_softirq);
 
-	local_irq_save(flags);
-
 	__tasklet_enqueue(t, &tasklet_vec);
-	/* raise softirq */
-	raise_softirq_irqoff_cpu(TASKLET_SOFTIRQ, 0);
-
-	local_irq_restore(flags);
+	raise_softirq_irqoff(TASKLET_SOFTIRQ);
 }
 
 void fastcall __tasklet_hi_schedule(struct tasklet_struct *t)
 {
-	unsigned long flags;
-
 	CHECK_INITVAR(dde_linux26_softirq);
 
-	local_irq_save(flags);
 	__tasklet_enqueue(t, &tasklet_hi_vec);
-	raise_softirq_irqoff_cpu(HI_SOFTIRQ, 0);
-	local_irq_restore(flags);
+	raise_softirq_irqoff(HI_SOFTIRQ);
 }
 
-/* Execute tasklets */
-static void tasklet_action(struct softirq_action *a)
+/**
+ * Execute up to TASKLET_BUDGET tasklets of queue
+ *
+ * Tasklets that are disabled or running elsewhere as well as tasklets
+ * exceeding the budget are put back in front of the queue in one go,
+ * preserving their order, and the softirq is raised again.
+ */
+static void __tasklet_action(struct tasklet_head *head, unsigned int nr)
 {
-	struct tasklet_struct *list;
+	struct tasklet_struct  *list, *deferred = NULL;
+	struct tasklet_struct **deferred_tail = &deferred;
+	unsigned budget = TASKLET_BUDGET;
 
-	dde_kit_lock_lock(tasklet_vec.lock);
-	list = tasklet_vec.list;
-	tasklet_vec.list = NULL;
-	dde_kit_lock_unlock(tasklet_vec.lock);
+	spin_lock(&head->lock);
+	list = head->list;
+	head->list = NULL;
+	head->tail = &head->list;
+	spin_unlock(&head->lock);
 
-	while (list) {
+	while (list && budget) {
 		struct tasklet_struct *t = list;
 
 		list = list->next;
@@ -149,148 +186,164 @@ static void tasklet_action(struct softirq_action *a)
 					BUG();
 				t->func(t->data);
 				tasklet_unlock(t);
+				budget--;
 				continue;
 			}
 			tasklet_unlock(t);
 		}
 
-		dde_kit_lock_lock(tasklet_vec.lock);
-		t->next = tasklet_vec.list;
-		tasklet_vec.list = t;
-		raise_softirq_irqoff_cpu(TASKLET_SOFTIRQ, 0);
-		dde_kit_lock_unlock(tasklet_vec.lock);
+		*deferred_tail = t;
+		deferred_tail  = &t->next;
 	}
-}
 
+	/* append tasklets beyond the budget */
+	for (*deferred_tail = list; *deferred_tail; )
+		deferred_tail = &(*deferred_tail)->next;
 
-static void tasklet_hi_action(struct softirq_action *a)
-{
-	struct tasklet_struct *list;
+	if (!deferred)
+		return;
 
-	dde_kit_lock_lock(tasklet_hi_vec.lock);
-	list = tasklet_hi_vec.list;
-	tasklet_hi_vec.list = NULL;
-	dde_kit_lock_unlock(tasklet_hi_vec.lock);
+	spin_lock(&head->lock);
+	*deferred_tail = head->list;
+	if (!head->list)
+		head->tail = deferred_tail;
+	head->list = deferred;
+	spin_unlock(&head->lock);
 
-	while (list) {	
-		struct tasklet_struct *t = list;
+	raise_softirq_irqoff(nr);
+}
 
-		list = list->next;
 
-		if (tasklet_trylock(t)) {
-			if (!atomic_read(&t->count)) {
-				if (!test_and_clear_bit(TASKLET_STATE_SCHED, &t->state))
-					BUG();
-				t->func(t->data);
-				tasklet_unlock(t);
-				continue;
-			}
-			tasklet_unlock(t);
-		}
-
-		dde_kit_lock_lock(tasklet_hi_vec.lock);
-		t->next = tasklet_hi_vec.list;
-		tasklet_hi_vec.list = t;
-		raise_softirq_irqoff_cpu(HI_SOFTIRQ, 0);
-		dde_kit_lock_unlock(tasklet_hi_vec.lock);
-	}
+static void tasklet_action(struct softirq_action *a)
+{
+	__tasklet_action(&tasklet_vec, TASKLET_SOFTIRQ);
 }
 
 
-#define MAX_SOFTIRQ_RETRIES	10
+static void tasklet_hi_action(struct softirq_action *a)
+{
+	__tasklet_action(&tasklet_hi_vec, HI_SOFTIRQ);
+}
 
-/** Run softirq handlers 
+
+/**
+ * Run pending softirq handlers of context once
+ *
+ * \return  true if softirqs were raised meanwhile
  */
-static void __do_softirq(void)
+static int __do_softirq(struct softirq_ctx *ctx)
 {
-	int retries = MAX_SOFTIRQ_RETRIES;
-	do {
-		struct softirq_action *h = softirq_vec;
-		unsigned long pending = local_softirq_pending();
-
-		/* reset softirq count */
-		set_softirq_pending(0);
-
-		/* While we have a softirq pending... */
-		while (pending) {
-			/* need to execute current softirq? */
-			if (pending & 1)
-				h->action(h);
-			/* try next softirq */
-			h++;
-			/* remove pending flag for last softirq */
-			pending >>= 1;
-		}
+	unsigned long pending = xchg(&ctx->pending, 0);
+	unsigned int nr;
 
-	/* Somebody might have scheduled another softirq in between
-	 * (e.g., an IRQ thread or another tasklet). */
-	} while (local_softirq_pending() && --retries);
+	for (nr = 0; pending; nr++, pending >>= 1) {
+		struct softirq_action *h = &softirq_vec[nr];
+		s64 start;
 
-}
+		if (!(pending & 1) || !h->action)
+			continue;
 
+		start = ktime_to_ns(ktime_get());
+		h->action(h);
 
-void do_softirq(void)
-{
-	unsigned long flags;
+		if (nr < NUM_SOFTIRQS) {
+			softirq_stat[nr].run++;
+			softirq_stat[nr].time_ns += ktime_to_ns(ktime_get()) - start;
+		}
+	}
 
-	local_irq_save(flags);
-	if (local_softirq_pending())
-		__do_softirq();
-	local_irq_restore(flags);
+	return ctx->pending != 0;
 }
 
 
-void dde_linux26_raise_softirq()
+/**
+ * Wake softirq threads of all contexts with pending softirqs
+ *
+ * Softirqs never run in the calling thread in DDE Linux.
+ */
+void do_softirq(void)
 {
-	dde_kit_sem_up(softirq_sem);
+	int i;
+
+	for (i = 0; i < NUM_SOFTIRQ_CTX; i++)
+		if (softirq_ctx[i].pending)
+			dde_kit_sem_up(softirq_ctx[i].sem);
 }
 
 
 /** Softirq thread function.
  *
- * Once started, a softirq thread waits for tasklets to be scheduled
- * and executes them.
+ * Once started, a softirq thread waits for softirqs of its context to be
+ * raised and executes them.
  *
- * \param arg	# of this softirq thread so that it grabs the correct lock
- *              if multiple softirq threads are running.
+ * \param arg	softirq context of this thread
  */
-void dde_linux26_softirq_thread(void *arg)
+static void dde_linux26_softirq_thread(void *arg)
 {
-	printk("Softirq daemon starting\n");
+	struct softirq_ctx *ctx = arg;
+
 	dde_linux26_process_add_worker("unused");
 
-	/* This thread will always be in a softirq, so set the 
+	/* This thread will always be in a softirq, so set the
 	 * corresponding flag right now.
 	 */
 	preempt_count() |= SOFTIRQ_MASK;
 
 	while(1) {
-		dde_kit_sem_down(softirq_sem);
-		do_softirq();
+		int restart = MAX_SOFTIRQ_RESTART;
+
+		dde_kit_sem_down(ctx->sem);
+
+		while (__do_softirq(ctx) && --restart)
+			;
+
+		/* softirqs keep coming - let other threads run first */
+		if (!restart)
+			yield();
 	}
 }
 
 /** Initialize softirq subsystem.
  *
- * Start NUM_SOFTIRQ_THREADS threads executing the \ref dde_linux26_softirq_thread
- * function.
+ * Start one thread executing the \ref dde_linux26_softirq_thread function
+ * per softirq context.
  */
 void dde_linux26_softirq_init(void)
 {
-	static char name[20];
-
-	softirq_sem = dde_kit_sem_init(0);
-
-	set_softirq_pending(0);
+	static const char *names[NUM_SOFTIRQ_CTX] = { ".softirqd-hi", ".softirqd" };
+	int i;
 
-	dde_kit_lock_init(&tasklet_vec.lock);
-	dde_kit_lock_init(&tasklet_hi_vec.lock);
-
-	snprintf(name, 20, ".softirqd");
-	dde_kit_thread_create( dde_linux26_softirq_thread, NULL, name);
+	spin_lock_init(&tasklet_vec.lock);
+	spin_lock_init(&tasklet_hi_vec.lock);
+	tasklet_vec.tail    = &tasklet_vec.list;
+	tasklet_hi_vec.tail = &tasklet_hi_vec.list;
 
 	open_softirq(TASKLET_SOFTIRQ, tasklet_action, NULL);
 	open_softirq(HI_SOFTIRQ, tasklet_hi_action, NULL);
 
+	for (i = 0; i < NUM_SOFTIRQ_CTX; i++) {
+		softirq_ctx[i].sem = dde_kit_sem_init(0);
+		dde_kit_thread_create(dde_linux26_softirq_thread, &softirq_ctx[i],
+		                      names[i]);
+	}
+
 	INITIALIZE_INITVAR(dde_linux26_softirq);
 }
+
+
+/***************
+ ** Interface **
+ ***************/
+
+int dde_linux26_softirq_stats(unsigned nr, struct dde_linux26_softirq_stats *stats)
+{
+	if (nr >= NUM_SOFTIRQS)
+		return -1;
+
+	stats->raised  = atomic_read(&softirq_stat[nr].raised);
+	stats->run     = softirq_stat[nr].run;
+	stats->time_us = softirq_stat[nr].time_ns;
+	do_div(stats->time_us, NSEC_PER_USEC);
+
+	return 0;
+}
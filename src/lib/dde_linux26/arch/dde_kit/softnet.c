@@ -0,0 +1,282 @@
+/*
+ * \brief  DDE Linux 2.6 softnet - polled packet reception
+ * \date   2026-10-18
+ *
+ * Packet reception does not run in interrupt or tasklet context but in a
+ * dedicated softnet thread, which executes Linux' net_rx_action() with its
+ * budget and per-device weights. Drivers implementing ->poll (NAPI) mask
+ * their receive interrupts themselves and are scheduled by
+ * netif_rx_schedule(). Packets of all other drivers are queued by
+ * netif_rx() in a per-device backlog, which is polled on behalf of the
+ * device. Once a backlog overflows, it is throttled and drops all packets
+ * of the device until it is drained. Interrupt lines are never masked, as
+ * they may be shared and virtual devices have none.
+ */
+
+#include <dde_linux26/net.h>
+
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/wait.h>
+
+#include <asm/div64.h>
+
+#include "local.h"
+
+/**
+ * Per-device backlog for drivers without ->poll
+ */
+struct softnet_backlog
+{
+	struct list_head    list;
+	struct net_device  *dev;        /* receiving device */
+	struct net_device   poll_dev;   /* placeholder in the poll list */
+	struct sk_buff_head rxq;        /* packets queued by netif_rx() */
+	int                 throttle;   /* drop packets until drained */
+
+	unsigned long       received;
+	unsigned long       dropped;
+	unsigned long       throttled;
+};
+
+static LIST_HEAD(backlogs);
+static DEFINE_SPINLOCK(backlogs_lock);
+
+static struct
+{
+	wait_queue_head_t  wq;
+	unsigned long      pending;
+	void             (*action)(struct softirq_action *);
+
+	unsigned long      polls;     /* poll rounds */
+	unsigned long      squeezed;  /* rounds ended by budget or time limit */
+	u64                poll_ns;   /* time spent in polling */
+} softnet;
+
+
+/**
+ * Poll function of the backlog placeholder device
+ */
+static int backlog_poll(struct net_device *poll_dev, int *budget)
+{
+	struct softnet_backlog *b = poll_dev->priv;
+	int quota = min(poll_dev->quota, *budget);
+	int work  = 0;
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	while (work < quota && (skb = skb_dequeue(&b->rxq))) {
+		netif_receive_skb(skb);
+		work++;
+	}
+
+	poll_dev->quota -= work;
+	*budget         -= work;
+
+	if (!skb_queue_empty(&b->rxq))
+		return 1;
+
+	netif_rx_complete(poll_dev);
+
+	/* caught up with the device */
+	spin_lock_irqsave(&b->rxq.lock, flags);
+	b->throttle = 0;
+	spin_unlock_irqrestore(&b->rxq.lock, flags);
+
+	/* packets queued after our last dequeue did not schedule us */
+	if (!skb_queue_empty(&b->rxq))
+		netif_rx_schedule(poll_dev);
+
+	return 0;
+}
+
+
+static struct softnet_backlog *__backlog_lookup(struct net_device *dev)
+{
+	struct softnet_backlog *b;
+
+	list_for_each_entry(b, &backlogs, list)
+		if (b->dev == dev)
+			return b;
+
+	return NULL;
+}
+
+
+/**
+ * Get backlog of device, create it on first use
+ */
+static struct softnet_backlog *backlog_get(struct net_device *dev)
+{
+	struct softnet_backlog *b;
+	unsigned long flags;
+
+	spin_lock_irqsave(&backlogs_lock, flags);
+	b = __backlog_lookup(dev);
+	spin_unlock_irqrestore(&backlogs_lock, flags);
+
+	if (b) return b;
+
+	b = kzalloc(sizeof(*b), GFP_ATOMIC);
+	if (!b) return NULL;
+
+	b->dev = dev;
+	skb_queue_head_init(&b->rxq);
+	b->poll_dev.priv   = b;
+	b->poll_dev.poll   = backlog_poll;
+	b->poll_dev.weight = weight_p;
+	atomic_set(&b->poll_dev.refcnt, 1);
+	set_bit(__LINK_STATE_START, &b->poll_dev.state);
+
+	spin_lock_irqsave(&backlogs_lock, flags);
+	if (__backlog_lookup(dev)) {
+		spin_unlock_irqrestore(&backlogs_lock, flags);
+		kfree(b);
+		return backlog_get(dev);
+	}
+	list_add_tail(&b->list, &backlogs);
+	spin_unlock_irqrestore(&backlogs_lock, flags);
+
+	return b;
+}
+
+
+int dde_linux26_softnet_rx(struct sk_buff *skb)
+{
+	struct softnet_backlog *b = backlog_get(skb->dev);
+	unsigned long flags;
+
+	if (!b) {
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
+	spin_lock_irqsave(&b->rxq.lock, flags);
+	if (!b->throttle && skb_queue_len(&b->rxq) >= netdev_max_backlog) {
+		/* the device floods us - drop its packets until we caught up */
+		b->throttle = 1;
+		b->throttled++;
+	}
+	if (b->throttle) {
+		b->dropped++;
+		spin_unlock_irqrestore(&b->rxq.lock, flags);
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+	__skb_queue_tail(&b->rxq, skb);
+	b->received++;
+	spin_unlock_irqrestore(&b->rxq.lock, flags);
+
+	netif_rx_schedule(&b->poll_dev);
+
+	return NET_RX_SUCCESS;
+}
+
+
+void dde_linux26_softnet_schedule(void)
+{
+	set_bit(0, &softnet.pending);
+	wake_up(&softnet.wq);
+}
+
+
+void dde_linux26_softnet_squeeze(void)
+{
+	softnet.squeezed++;
+	dde_linux26_softnet_schedule();
+}
+
+
+static int softnet_thread(void *arg)
+{
+	for (;;) {
+		ktime_t start;
+
+		wait_event(softnet.wq, test_and_clear_bit(0, &softnet.pending));
+
+		/* a round takes far less than a jiffy, so use the TSC-based clock */
+		start = ktime_get();
+		softnet.action(NULL);
+		softnet.poll_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		softnet.polls++;
+
+		/* let other threads run if the budget was exhausted */
+		if (test_bit(0, &softnet.pending))
+			yield();
+	}
+
+	return 0;
+}
+
+
+void dde_linux26_softnet_init(void (*action)(struct softirq_action *))
+{
+	init_waitqueue_head(&softnet.wq);
+	softnet.action = action;
+
+	kernel_thread(softnet_thread, NULL, 0);
+}
+
+
+/***************
+ ** Interface **
+ ***************/
+
+void dde_linux26_net_set_budget(int budget)
+{
+	if (budget > 0)
+		netdev_budget = budget;
+}
+
+
+int dde_linux26_net_set_weight(unsigned if_index, int weight)
+{
+	struct net_device *dev;
+	struct softnet_backlog *b;
+	int err = 0;
+
+	if (weight <= 0) return -EINVAL;
+
+	dev = dev_get_by_index(if_index);
+	if (!dev) return -ENODEV;
+
+	if (dev->poll)
+		dev->weight = weight;
+	else if ((b = backlog_get(dev)))
+		b->poll_dev.weight = weight;
+	else
+		err = -ENOMEM;
+
+	dev_put(dev);
+	return err;
+}
+
+
+void dde_linux26_net_softnet_stats(struct dde_linux26_net_softnet_stats *stats)
+{
+	struct softnet_backlog *b;
+	unsigned long flags;
+	u64 poll_us = softnet.poll_ns;
+
+	memset(stats, 0, sizeof(*stats));
+
+	spin_lock_irqsave(&backlogs_lock, flags);
+	list_for_each_entry(b, &backlogs, list) {
+		stats->received   += b->received;
+		stats->dropped    += b->dropped;
+		stats->throttled  += b->throttled;
+	}
+	spin_unlock_irqrestore(&backlogs_lock, flags);
+
+	stats->polls    = softnet.polls;
+	stats->squeezed = softnet.squeezed;
+	do_div(poll_us, NSEC_PER_USEC);
+	stats->poll_us  = poll_us;
+}
@@ -0,0 +1,78 @@
+/*
+ * \brief  Slow path of the adaptive spin-then-block lock
+ * \date   2026-10-18
+ *
+ * Blocked waiters park on one of a fixed set of semaphores selected by the
+ * lock address, so locks need neither per-lock resources nor destruction.
+ * As waiters for different locks may share a semaphore, an unlocking
+ * thread wakes all waiters of the bucket and each of them retries its own
+ * lock. Collisions are rare with few contended locks at a time.
+ *
+ * This file depends on DDE kit only and is also built into the i915
+ * driver.
+ */
+
+#include <dde_kit/semaphore.h>
+
+#include <dde_linux26/spin_lock.h>
+
+enum { NUM_BUCKETS = 64 };
+
+static struct bucket
+{
+	struct dde_kit_sem *volatile sem;
+	volatile int                 waiters;  /* threads in lock_wait() */
+} buckets[NUM_BUCKETS];
+
+
+static struct bucket *bucket_of(struct dde_linux26_spin_lock *lock)
+{
+	unsigned long a = (unsigned long)lock;
+
+	return &buckets[((a >> 4) ^ (a >> 10)) % NUM_BUCKETS];
+}
+
+
+/**
+ * Get semaphore of bucket, allocate it on first use
+ */
+static struct dde_kit_sem *bucket_sem(struct bucket *b)
+{
+	struct dde_kit_sem *sem = b->sem;
+
+	if (sem)
+		return sem;
+
+	sem = dde_kit_sem_init(0);
+	if (!__sync_bool_compare_and_swap(&b->sem, 0, sem))
+		dde_kit_sem_deinit(sem);
+
+	return b->sem;
+}
+
+
+void dde_linux26_spin_lock_wait(struct dde_linux26_spin_lock *lock)
+{
+	struct bucket *b = bucket_of(lock);
+	struct dde_kit_sem *sem = bucket_sem(b);
+
+	/* register before marking the lock to not miss the unlock */
+	dde_linux26_atomic_add_return(1, &b->waiters);
+
+	while (dde_linux26_atomic_xchg(&lock->state, DDE_LINUX26_SPIN_LOCK_WAITERS)
+	       != DDE_LINUX26_SPIN_LOCK_FREE)
+		dde_kit_sem_down(sem);
+
+	dde_linux26_atomic_sub_return(1, &b->waiters);
+}
+
+
+void dde_linux26_spin_lock_wake(struct dde_linux26_spin_lock *lock)
+{
+	struct bucket *b = bucket_of(lock);
+	int n;
+
+	/* surplus wakeups only cause waiters to retry their lock */
+	for (n = dde_linux26_atomic_read(&b->waiters); n > 0; n--)
+		dde_kit_sem_up(bucket_sem(b));
+}
@@ -6,6 +6,7 @@
  */
 
 #include <linux/timer.h>
+#include <linux/delay.h>
 #include <linux/fs.h>
 
 #include "local.h"
@@ -37,6 +38,7 @@ struct tvec_t_base_s {
 	spinlock_t lock;
 	struct timer_list *running_timer;
 	unsigned long timer_jiffies;
+	unsigned long pending;            /* number of timers in the wheel */
 	tvec_root_t tv1;
 	tvec_t tv2;
 	tvec_t tv3;
@@ -46,22 +48,289 @@ struct tvec_t_base_s {
 
 typedef struct tvec_t_base_s tvec_base_t;
 
-tvec_base_t boot_tvec_bases __attribute__((unused));
+/*
+ * All timers live in one wheel, which is driven by a single DDE kit timer
+ * armed for the next expiry. Thereby, add/mod/del are list operations and
+ * only timers expiring before the armed one cost a DDE kit round trip.
+ */
+tvec_base_t boot_tvec_bases;
+
+static tvec_base_t * const base = &boot_tvec_bases;
+
+static DEFINE_SPINLOCK(tick_lock);
+static struct dde_kit_timer *tick_timer;   /* armed DDE kit timer */
+static unsigned long         tick_expires;
+static unsigned long         tick_gen;     /* identifies the armed timer */
+
+
+static void internal_add_timer(tvec_base_t *base, struct timer_list *timer)
+{
+	unsigned long expires = timer->expires;
+	unsigned long idx = expires - base->timer_jiffies;
+	struct list_head *vec;
+
+	if (idx < TVR_SIZE) {
+		int i = expires & TVR_MASK;
+		vec = base->tv1.vec + i;
+	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
+		int i = (expires >> TVR_BITS) & TVN_MASK;
+		vec = base->tv2.vec + i;
+	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
+		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
+		vec = base->tv3.vec + i;
+	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
+		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
+		vec = base->tv4.vec + i;
+	} else if ((signed long) idx < 0) {
+		/*
+		 * Can happen if you add a timer with expires == jiffies,
+		 * or you set a timer to go off in the past
+		 */
+		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
+	} else {
+		int i;
+		/* If the timeout is larger than 0xffffffff on 64-bit
+		 * architectures then we use the maximum timeout:
+		 */
+		if (idx > 0xffffffffUL) {
+			idx = 0xffffffffUL;
+			expires = idx + base->timer_jiffies;
+		}
+		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
+		vec = base->tv5.vec + i;
+	}
+	list_add_tail(&timer->entry, vec);
+}
+
+
+static inline void detach_timer(struct timer_list *timer)
+{
+	struct list_head *entry = &timer->entry;
+
+	__list_del(entry->prev, entry->next);
+	entry->next = NULL;
+	entry->prev = LIST_POISON2;
+	base->pending--;
+}
+
+
+static int cascade(tvec_base_t *base, tvec_t *tv, int index)
+{
+	/* cascade all the timers from tv up one level */
+	struct timer_list *timer, *tmp;
+	struct list_head tv_list;
+
+	list_replace_init(tv->vec + index, &tv_list);
+
+	list_for_each_entry_safe(timer, tmp, &tv_list, entry)
+		internal_add_timer(base, timer);
+
+	return index;
+}
+
+
+/*
+ * Find out when the next timer event is due to happen. The result may lie
+ * before the actual expiry of the timer if the timer needs to be cascaded.
+ * Must be called with base->lock held.
+ */
+static unsigned long __next_timer_interrupt(tvec_base_t *base)
+{
+	unsigned long timer_jiffies = base->timer_jiffies;
+	unsigned long expires = timer_jiffies + (LONG_MAX >> 1);
+	int index, slot, array, found = 0;
+	struct timer_list *nte;
+	tvec_t *varray[4];
+
+	/* Look for timer events in tv1. */
+	index = slot = timer_jiffies & TVR_MASK;
+	do {
+		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
+			found = 1;
+			expires = nte->expires;
+			/* Look at the cascade bucket(s)? */
+			if (!index || slot < index)
+				goto cascade;
+			return expires;
+		}
+		slot = (slot + 1) & TVR_MASK;
+	} while (slot != index);
+
+cascade:
+	/* Calculate the next cascade event */
+	if (index)
+		timer_jiffies += TVR_SIZE - index;
+	timer_jiffies >>= TVR_BITS;
+
+	/* Check tv2-tv5. */
+	varray[0] = &base->tv2;
+	varray[1] = &base->tv3;
+	varray[2] = &base->tv4;
+	varray[3] = &base->tv5;
+
+	for (array = 0; array < 4; array++) {
+		tvec_t *varp = varray[array];
+
+		index = slot = timer_jiffies & TVN_MASK;
+		do {
+			list_for_each_entry(nte, varp->vec + slot, entry) {
+				found = 1;
+				if (time_before(nte->expires, expires))
+					expires = nte->expires;
+			}
+			/*
+			 * Do we still search for the first timer or are
+			 * we looking up the cascade buckets ?
+			 */
+			if (found) {
+				/* Look at the cascade bucket(s)? */
+				if (!index || slot < index)
+					break;
+				return expires;
+			}
+			slot = (slot + 1) & TVN_MASK;
+		} while (slot != index);
+
+		if (index)
+			timer_jiffies += TVN_SIZE - index;
+		timer_jiffies >>= TVN_BITS;
+	}
+	return expires;
+}
+
+
+unsigned long next_timer_interrupt(void)
+{
+	unsigned long expires;
+
+	spin_lock(&base->lock);
+	expires = base->pending ? __next_timer_interrupt(base)
+	                        : jiffies + (LONG_MAX >> 1);
+	spin_unlock(&base->lock);
+
+	return expires;
+}
 
-static DEFINE_PER_CPU(tvec_base_t *, tvec_bases) __attribute__((unused)) = &boot_tvec_bases;
 
-void fastcall init_timer(struct timer_list *timer) { }
+static void tick(void *gen);
+
+/**
+ * Arm DDE kit timer unless it already expires at or before 'expires'
+ */
+static void tick_arm(unsigned long expires)
+{
+	struct dde_kit_timer *old;
+
+	spin_lock(&tick_lock);
+	if (tick_timer && !time_after(tick_expires, expires)) {
+		spin_unlock(&tick_lock);
+		return;
+	}
+
+	old          = tick_timer;
+	tick_expires = expires;
+	tick_timer   = dde_kit_timer_add(tick, (void *)++tick_gen, expires);
+	spin_unlock(&tick_lock);
+
+	if (old)
+		dde_kit_timer_del(old);
+}
+
+
+#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+
+/**
+ * Run all expired timers
+ */
+static void __run_timers(tvec_base_t *base)
+{
+	struct timer_list *timer;
+
+	spin_lock(&base->lock);
+
+	/* skip idle periods */
+	if (!base->pending && time_after(jiffies, base->timer_jiffies))
+		base->timer_jiffies = jiffies;
+
+	while (time_after_eq(jiffies, base->timer_jiffies)) {
+		struct list_head work_list;
+		struct list_head *head = &work_list;
+		int index = base->timer_jiffies & TVR_MASK;
+
+		/*
+		 * Cascade timers:
+		 */
+		if (!index &&
+			(!cascade(base, &base->tv2, INDEX(0))) &&
+				(!cascade(base, &base->tv3, INDEX(1))) &&
+					!cascade(base, &base->tv4, INDEX(2)))
+			cascade(base, &base->tv5, INDEX(3));
+		++base->timer_jiffies;
+		list_replace_init(base->tv1.vec + index, &work_list);
+		while (!list_empty(head)) {
+			void (*fn)(unsigned long);
+			unsigned long data;
+
+			timer = list_entry(head->next, struct timer_list, entry);
+			fn = timer->function;
+			data = timer->data;
+
+			base->running_timer = timer;
+			detach_timer(timer);
+			spin_unlock(&base->lock);
+			fn(data);
+			spin_lock(&base->lock);
+		}
+	}
+	base->running_timer = NULL;
+	spin_unlock(&base->lock);
+}
+
+
+/**
+ * DDE kit timer handler
+ */
+static void tick(void *gen)
+{
+	struct dde_kit_timer *fired = NULL;
+	unsigned long next = 0;
+	int pending;
+
+	/* forget about the fired DDE kit timer unless it was replaced */
+	spin_lock(&tick_lock);
+	if ((unsigned long)gen == tick_gen) {
+		fired      = tick_timer;
+		tick_timer = NULL;
+	}
+	spin_unlock(&tick_lock);
+
+	if (fired)
+		dde_kit_timer_del(fired);
+
+	__run_timers(base);
+
+	spin_lock(&base->lock);
+	pending = base->pending != 0;
+	if (pending)
+		next = __next_timer_interrupt(base);
+	spin_unlock(&base->lock);
+
+	if (pending)
+		tick_arm(next);
+}
+
+
+void fastcall init_timer(struct timer_list *timer)
+{
+	timer->entry.next = NULL;
+	timer->base       = base;
+}
+
 
 void add_timer(struct timer_list *timer)
 {
-	CHECK_INITVAR(dde_linux26_timer);
-	/*
-	 * The DDE kit provides jiffies and HZ. Therefore, we just need to hand
-	 * over the timeout.
-	 */
-	timer->dde_kit_timer = dde_kit_timer_add((void *)timer->function,
-	                                         (void *)timer->data,
-	                                         timer->expires);
+	BUG_ON(timer_pending(timer));
+	__mod_timer(timer, timer->expires);
 }
 
 
@@ -71,62 +340,99 @@ void add_timer_on(struct timer_list *timer, int cpu)
 }
 
 
-int del_timer(struct timer_list * timer)
+int del_timer(struct timer_list *timer)
 {
+	int ret = 0;
+
 	CHECK_INITVAR(dde_linux26_timer);
 
-	int pending = 0;
+	spin_lock(&base->lock);
+	if (timer_pending(timer)) {
+		detach_timer(timer);
+		ret = 1;
+	}
+	spin_unlock(&base->lock);
+
+	/* the DDE kit timer stays armed and finds nothing to do */
+	return ret;
+}
+
 
-	if (timer->dde_kit_timer) {
-		pending = dde_kit_timer_pending(timer->dde_kit_timer) ? 1 : 0;
-		dde_kit_timer_del(timer->dde_kit_timer);
-		timer->dde_kit_timer = 0;
+int try_to_del_timer_sync(struct timer_list *timer)
+{
+	int ret = -1;
+
+	spin_lock(&base->lock);
+	if (base->running_timer == timer)
+		goto out;
+
+	ret = 0;
+	if (timer_pending(timer)) {
+		detach_timer(timer);
+		ret = 1;
 	}
+out:
+	spin_unlock(&base->lock);
 
-	/* return 1 if timer was pending, 0 otherwise */
-	return pending;
+	return ret;
 }
 
+
 int del_timer_sync(struct timer_list *timer)
 {
-	return del_timer(timer);
+	for (;;) {
+		int ret = try_to_del_timer_sync(timer);
+		if (ret >= 0)
+			return ret;
+		yield();
+	}
 }
 
 
 int __mod_timer(struct timer_list *timer, unsigned long expires)
 {
-	/*
-	 * XXX: Naive implementation. If we really need to be fast with
-	 *      this function, we can implement a faster version inside
-	 *      the DDE kit. Bjoern just does not think that this is the
-	 *      case.
-	 */
-	int r;
-	
+	int ret = 0;
+
 	CHECK_INITVAR(dde_linux26_timer);
-	r = del_timer(timer);
+	BUG_ON(!timer->function);
+
+	spin_lock(&base->lock);
+
+	if (timer_pending(timer)) {
+		detach_timer(timer);
+		ret = 1;
+	}
+
+	/* the wheel may lag behind after an idle period */
+	if (!base->pending && time_after(jiffies, base->timer_jiffies))
+		base->timer_jiffies = jiffies;
 
 	timer->expires = expires;
-	add_timer(timer);
+	timer->base    = base;
+	internal_add_timer(base, timer);
+	base->pending++;
 
-	return (r > 0);
-}
+	spin_unlock(&base->lock);
 
+	tick_arm(expires);
 
-int mod_timer(struct timer_list *timer, unsigned long expires)
-{
-	return __mod_timer(timer, expires);
+	return ret;
 }
 
 
-int timer_pending(const struct timer_list *timer)
+int mod_timer(struct timer_list *timer, unsigned long expires)
 {
-	CHECK_INITVAR(dde_linux26_timer);
-	/* There must be a valid DDE kit timer in the timer field
-	 * *AND* it must be pending in the DDE kit.
+	BUG_ON(!timer->function);
+
+	/*
+	 * This is a common optimization triggered by the
+	 * networking code - if the timer is re-modified
+	 * to be the same thing then just return:
 	 */
-	return ((timer->dde_kit_timer != 0) 
-		    && dde_kit_timer_pending(timer->dde_kit_timer));
+	if (timer->expires == expires && timer_pending(timer))
+		return 1;
+
+	return __mod_timer(timer, expires);
 }
 
 
@@ -136,31 +442,39 @@ int timer_pending(const struct timer_list *timer)
  */
 void msleep(unsigned int msecs)
 {
-	dde_kit_thread_msleep(msecs);
+	dde_linux26_hrtimer_delay((s64)msecs * NSEC_PER_MSEC);
 }
 
-void msleep_interruptible(unsigned int msecs)
+unsigned long msleep_interruptible(unsigned int msecs)
 {
+	s64 left;
+
 	CHECK_INITVAR(dde_linux26_timer);
 	current->state = TASK_INTERRUPTIBLE;
-	schedule_timeout(msecs);
+	left = dde_linux26_schedule_hrtimeout((s64)msecs * NSEC_PER_MSEC);
+
+	/* round up to milliseconds like jiffies_to_msecs() */
+	return ((unsigned long)left + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
 }
 
+/*
+ * 'xloops' is usecs * 2^32 / 10^6 (see asm/delay.h)
+ */
 void __const_udelay(unsigned long xloops)
 {
-	WARN_UNIMPL;
+	dde_linux26_hrtimer_delay(((u64)xloops * NSEC_PER_SEC) >> 32);
 }
 
 
 void __udelay(unsigned long usecs)
 {
-	dde_kit_thread_usleep(usecs);
+	dde_linux26_hrtimer_delay((s64)usecs * NSEC_PER_USEC);
 }
 
 
 void __ndelay(unsigned long nsecs)
 {
-	dde_kit_thread_nsleep(nsecs);
+	dde_linux26_hrtimer_delay(nsecs);
 }
 
 
@@ -172,8 +486,25 @@ static void _init_timers(void *p)
 
 void dde_linux26_timer_init(void)
 {
+	int i;
+
+	spin_lock_init(&base->lock);
+	for (i = 0; i < TVN_SIZE; i++) {
+		INIT_LIST_HEAD(base->tv5.vec + i);
+		INIT_LIST_HEAD(base->tv4.vec + i);
+		INIT_LIST_HEAD(base->tv3.vec + i);
+		INIT_LIST_HEAD(base->tv2.vec + i);
+	}
+	for (i = 0; i < TVR_SIZE; i++)
+		INIT_LIST_HEAD(base->tv1.vec + i);
+
+	base->timer_jiffies = jiffies;
+
 	dde_kit_timer_init(_init_timers, 0);
 
+	/* needs running jiffies for calibration */
+	dde_linux26_hrtimer_init();
+
 	INITIALIZE_INITVAR(dde_linux26_timer);
 }
 
@@ -6,6 +6,8 @@
 
 #include <dde_linux26/block.h>
 
+#include <linux/blkdev.h>
+
 #include <scsi/scsi.h>
 #include <scsi/scsi_cmnd.h>
 #include <scsi/scsi_device.h>
@@ -13,19 +15,130 @@
 
 #include "local.h"
 
-enum {
-	MAX_USB_INDEX = 4
+/* retry period for a busy host without commands in flight */
+enum { HOST_BUSY_TIMEOUT = 1 };
+
+struct usb_stor;
+
+/**
+ * Command accounting of a SCSI host, shared by all of its LUNs
+ *
+ * The host driver's 'can_queue' limits the commands of the host, not of a
+ * single LUN. The lock also protects the request queues of the LUNs.
+ */
+struct stor_host
+{
+	struct list_head   list;
+	struct Scsi_Host  *shost;
+
+	spinlock_t         lock;
+	struct list_head   devices;    /* LUNs of the host */
+	struct usb_stor   *last;       /* LUN that issued the last command */
+	unsigned           in_flight;  /* commands passed to the host */
+	unsigned           depth;      /* maximum of commands in flight */
+	int                busy;       /* host rejected the last command */
+	wait_queue_head_t  wq;         /* wakeup of all LUN dispatchers */
+};
+
+/**
+ * Block request as queued at a device
+ */
+struct block_request
+{
+	struct list_head list;
+	struct usb_stor *dev;
+
+	unsigned long long block_nr;  /* next block to issue */
+	unsigned long      count;     /* blocks not issued yet */
+	void              *buffer;    /* buffer position of next block */
+	int                write;
+	int                pending;   /* issued but not completed commands */
+	int                error;
+
+	dde_linux26_block_complete_cb complete;
+	void                         *priv;
 };
 
 struct usb_stor
 {
 	unsigned int block_size;
-	unsigned long block_count;
+	unsigned long long block_count;
 	struct scsi_device *sdev;
+
+	/* request queue, protected by the host lock */
+	struct stor_host  *host;
+	struct list_head   host_list;  /* entry in 'host->devices' */
+	struct list_head   queued;     /* requests with blocks left to issue */
+	struct list_head   done;       /* completed requests */
 };
 
-static struct usb_stor usb_devices[MAX_USB_INDEX];
-static int init = 0;
+/*
+ * Device table, grows on demand
+ *
+ * Devices are never removed, so 'struct usb_stor' pointers stay valid
+ * outside of the table lock.
+ */
+static DEFINE_SPINLOCK(usb_devices_lock);
+static struct usb_stor **usb_devices;
+static int num_usb_devices;   /* used entries */
+static int max_usb_devices;   /* size of table */
+
+/* hosts of all devices, never removed either */
+static LIST_HEAD(stor_hosts);
+
+static void start_dispatcher(struct usb_stor *dev);
+
+
+static struct usb_stor *device(int usb_index)
+{
+	struct usb_stor *dev = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&usb_devices_lock, flags);
+	if (usb_index >= 0 && usb_index < num_usb_devices)
+		dev = usb_devices[usb_index];
+	spin_unlock_irqrestore(&usb_devices_lock, flags);
+
+	return dev;
+}
+
+
+/**
+ * Add device to table
+ *
+ * \return device index or negative value on error
+ */
+static int add_device(struct usb_stor *dev)
+{
+	unsigned long flags;
+	int index;
+
+	spin_lock_irqsave(&usb_devices_lock, flags);
+
+	if (num_usb_devices == max_usb_devices) {
+		int max = max_usb_devices ? 2 * max_usb_devices : 4;
+		struct usb_stor **table = kzalloc(max * sizeof(struct usb_stor *), GFP_ATOMIC);
+
+		if (!table) {
+			spin_unlock_irqrestore(&usb_devices_lock, flags);
+			return -EBLK_NOMEM;
+		}
+
+		if (usb_devices)
+			memcpy(table, usb_devices, num_usb_devices * sizeof(struct usb_stor *));
+		kfree(usb_devices);
+
+		usb_devices     = table;
+		max_usb_devices = max;
+	}
+
+	index = num_usb_devices++;
+	usb_devices[index] = dev;
+
+	spin_unlock_irqrestore(&usb_devices_lock, flags);
+
+	return index;
+}
 
 dde_linux26_block_plugin_cb current_plugin_callback = NULL;
 
@@ -49,146 +162,599 @@ static void scsi_done(struct scsi_cmnd *cmnd)
 	complete(cmnd->back);
 }
 
-static void capacity(int usb_index)
+/**
+ * Execute SCSI command synchronously
+ *
+ * \return SCSI result or -EBLK_NOMEM
+ */
+static int sync_command(struct scsi_device *sdev, unsigned char const *cdb,
+                        unsigned short cdb_len, void *buffer, unsigned len)
 {
-	struct scsi_device *sdev;
 	struct scsi_cmnd *cmnd;
-	void *result;
 	struct completion compl;
+	unsigned long flags;
+	int result;
 
-	sdev = usb_devices[usb_index].sdev;
 	cmnd = (struct scsi_cmnd *) kmalloc(sizeof(struct scsi_cmnd), GFP_KERNEL);
-	result = kmalloc(8, GFP_KERNEL);
+	if (!cmnd)
+		return -EBLK_NOMEM;
 
 	memset(cmnd->cmnd, 0, MAX_COMMAND_SIZE);
-	cmnd->cmnd[0] = READ_CAPACITY;
-	cmnd->cmd_len = 10;
-	cmnd->request_buffer = result;
-	cmnd->request_bufflen = 8;
+	memcpy(cmnd->cmnd, cdb, cdb_len);
+	cmnd->cmd_len = cdb_len;
+	cmnd->request_buffer = buffer;
+	cmnd->request_bufflen = len;
 	cmnd->device = sdev;
 	cmnd->sc_data_direction = DMA_FROM_DEVICE;
+	cmnd->result = 0;
 
 	init_completion(&compl);
 	cmnd->back = &compl;
 
+	spin_lock_irqsave(sdev->host->host_lock, flags);
 	sdev->host->hostt->queuecommand(cmnd, scsi_done);
+	spin_unlock_irqrestore(sdev->host->host_lock, flags);
 	wait_for_completion(&compl);
 
-	usb_devices[usb_index].block_count = be32_to_cpu(*(__be32*)result);
-	usb_devices[usb_index].block_size = be32_to_cpu(*(__be32*)(result + 4));
+	result = cmnd->result;
+	kfree(cmnd);
+	return result;
+}
+
+
+static int capacity(struct usb_stor *dev)
+{
+	struct scsi_device *sdev = dev->sdev;
+	unsigned char cdb[16];
+	unsigned long long last;
+	void *result;
+	int ret = 0, err;
+
+	result = kmalloc(32, GFP_KERNEL);
+	if (!result)
+		return -EBLK_NOMEM;
+
+	memset(cdb, 0, sizeof(cdb));
+	cdb[0] = READ_CAPACITY;
+	err = sync_command(sdev, cdb, 10, result, 8);
+
+	/* e.g., no medium in card reader slot */
+	if (err) {
+		DEBUG_MSG("LUN %u: READ CAPACITY failed (result 0x%x)", sdev->lun, err);
+		ret = err == -EBLK_NOMEM ? err : -EBLK_NODEV;
+		goto out;
+	}
+
+	last            = be32_to_cpu(*(__be32*)result);
+	dev->block_size = be32_to_cpu(*(__be32*)(result + 4));
+
+	/* the last block number does not fit into 32 bit */
+	if (last == 0xffffffffULL) {
+		__be32 alloc_len = cpu_to_be32(32);
+
+		memset(cdb, 0, sizeof(cdb));
+		cdb[0] = SERVICE_ACTION_IN;
+		cdb[1] = SAI_READ_CAPACITY_16;
+		memcpy(&cdb[10], &alloc_len, 4);
+
+		err = sync_command(sdev, cdb, 16, result, 32);
+		if (err) {
+			DEBUG_MSG("LUN %u: READ CAPACITY(16) failed (result 0x%x)", sdev->lun, err);
+			ret = err == -EBLK_NOMEM ? err : -EBLK_NODEV;
+			goto out;
+		}
+
+		last            = be64_to_cpu(*(__be64*)result);
+		dev->block_size = be32_to_cpu(*(__be32*)(result + 8));
+	}
+
+	dev->block_count = last;
 
 	/* if device returns the highest block number */
 	if (!sdev->fix_capacity)
-		usb_devices[usb_index].block_count++;
+		dev->block_count++;
 
-	DEBUG_MSG("block size: %u (0x%x) block count: %lu (0x%lx)", usb_devices[usb_index].block_size,
-	                                                            usb_devices[usb_index].block_size,
-	                                                            usb_devices[usb_index].block_count,
-	                                                            usb_devices[usb_index].block_count);
+	DEBUG_MSG("LUN %u block size: %u (0x%x) block count: %llu (0x%llx)", sdev->lun,
+	                                                              dev->block_size,
+	                                                              dev->block_size,
+	                                                              dev->block_count,
+	                                                              dev->block_count);
 
-	kfree(cmnd);
+out:
 	kfree(result);
+	return ret;
 }
 
+/**
+ * Look up accounting of SCSI host, create it on first use
+ */
+static struct stor_host *lookup_host(struct Scsi_Host *shost)
+{
+	struct stor_host *host, *new_host;
+	unsigned long flags;
+
+	new_host = (struct stor_host *) kzalloc(sizeof(struct stor_host), GFP_KERNEL);
+	if (!new_host)
+		return NULL;
+
+	spin_lock_irqsave(&usb_devices_lock, flags);
+
+	list_for_each_entry(host, &stor_hosts, list)
+		if (host->shost == shost) {
+			spin_unlock_irqrestore(&usb_devices_lock, flags);
+			kfree(new_host);
+			return host;
+		}
+
+	new_host->shost = shost;
+	new_host->depth = max(1, shost->hostt->can_queue);
+	spin_lock_init(&new_host->lock);
+	INIT_LIST_HEAD(&new_host->devices);
+	init_waitqueue_head(&new_host->wq);
+	list_add_tail(&new_host->list, &stor_hosts);
+
+	spin_unlock_irqrestore(&usb_devices_lock, flags);
+
+	return new_host;
+}
+
+
 int dde_linux26_block_dev_add(struct scsi_device *sdev)
 {
-	int i;
+	struct usb_stor *dev;
+	int index, ret;
 
-	if (!init) {
-		memset(usb_devices, 0, MAX_USB_INDEX * sizeof(struct usb_stor));
-		init = 1;
+	dev = (struct usb_stor *) kzalloc(sizeof(struct usb_stor), GFP_KERNEL);
+	if (!dev)
+		return -EBLK_NOMEM;
+
+	dev->sdev = sdev;
+	if ((ret = capacity(dev))) {
+		kfree(dev);
+		return ret;
 	}
 
-	for (i = 0; i < MAX_USB_INDEX; i++) {
-		if (!usb_devices[i].sdev) {
-			usb_devices[i].sdev = sdev;
-			break;
-		}
+	dev->host = lookup_host(sdev->host);
+	if (!dev->host) {
+		kfree(dev);
+		return -EBLK_NOMEM;
 	}
 
-	if (i == MAX_USB_INDEX) {
+	start_dispatcher(dev);
+
+	/* make device visible only after it is fully initialized */
+	index = add_device(dev);
+	if (index < 0) {
 		DEBUG_MSG("Failed to add USB device %p", sdev);
-		return -EBLK_NOMEM;
+		return index;
 	}
 
-	capacity(i);
-	dde_linux26_plugin_rx_callback(i);
+	dde_linux26_plugin_rx_callback(index);
 	return 0;
 }
 
-int dde_linux26_block_count(int usb_index)
+long long dde_linux26_block_count(int usb_index)
 {
-	if (!dde_linux26_block_present(usb_index))
+	struct usb_stor *dev = device(usb_index);
+
+	if (!dev)
 		return -EBLK_NODEV;
 
-	return usb_devices[usb_index].block_count;
+	return dev->block_count;
 }
 
-int dde_linux26_block_size(usb_index)
+int dde_linux26_block_size(int usb_index)
 {
-	if (!dde_linux26_block_present(usb_index))
+	struct usb_stor *dev = device(usb_index);
+
+	if (!dev)
 		return -EBLK_NODEV;
 
-	return usb_devices[usb_index].block_size;
+	return dev->block_size;
 }
 
-static int block_io(int usb_index, unsigned long block_nr, void *buffer, char opcode,
-             enum dma_data_direction sc_data_direction)
+int dde_linux26_block_lun(int usb_index)
 {
-	struct scsi_cmnd *cmnd;
-	struct completion compl;
-	__be32 be_block_nr;
+	struct usb_stor *dev = device(usb_index);
 
-	if (!dde_linux26_block_present(usb_index))
+	if (!dev)
 		return -EBLK_NODEV;
 
-	if (block_nr > usb_devices[usb_index].block_count)
-		return -EBLK_FAULT;
+	return dev->sdev->lun;
+}
 
-	cmnd = (struct scsi_cmnd *) kmalloc(sizeof(struct scsi_cmnd), GFP_KERNEL);
+/**
+ * Maximum number of blocks per SCSI command as configured by the host driver
+ */
+static unsigned long max_blocks(struct usb_stor *dev)
+{
+	unsigned long max_sectors = dev->sdev->request_queue->max_sectors;
+
+	/* 'max_sectors' is given in 512-byte units */
+	max_sectors = max(1UL, (max_sectors * 512) / dev->block_size);
+
+	/* READ_10/WRITE_10 limit the transfer length to 16 bit */
+	return min(max_sectors, 0xffffUL);
+}
+
+
+static void io_done(struct scsi_cmnd *cmnd)
+{
+	struct block_request *req = cmnd->back;
+	struct usb_stor      *dev = req->dev;
+	struct stor_host     *host = dev->host;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+
+	if (cmnd->result && !req->error)
+		req->error = -EBLK_FAULT;
+
+	host->in_flight--;
+	host->busy = 0;
+
+	/* the request is done after its last command completed */
+	if (--req->pending == 0 && req->count == 0)
+		list_add_tail(&req->list, &dev->done);
+
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	kfree(cmnd);
+
+	/* the free slot may be taken by any LUN of the host */
+	wake_up(&host->wq);
+}
+
+
+static void setup_cmnd(struct scsi_cmnd *cmnd, struct usb_stor *dev,
+                       unsigned long long block_nr, unsigned long count,
+                       void *buffer, int write)
+{
 	memset(cmnd->cmnd, 0, MAX_COMMAND_SIZE);
 
-	cmnd->cmnd[0] = opcode;
-	cmnd->request_bufflen = usb_devices[usb_index].block_size;
+	/* use 16-byte commands only if the LBA does not fit into 32 bit */
+	if (block_nr + count - 1 > 0xffffffffULL) {
+		__be64 be_block_nr = cpu_to_be64(block_nr);
+		__be32 be_count    = cpu_to_be32(count);
+
+		cmnd->cmnd[0] = write ? WRITE_16 : READ_16;
+		cmnd->cmd_len = 16;
+		memcpy(&cmnd->cmnd[2],  &be_block_nr, 8);
+		memcpy(&cmnd->cmnd[10], &be_count,    4);
+	} else {
+		__be32 be_block_nr = cpu_to_be32(block_nr);
+		__be16 be_count    = cpu_to_be16(count);
+
+		cmnd->cmnd[0] = write ? WRITE_10 : READ_10;
+		cmnd->cmd_len = 10;
+		memcpy(&cmnd->cmnd[2], &be_block_nr, 4);
+		memcpy(&cmnd->cmnd[7], &be_count,    2);
+	}
+
+	cmnd->request_bufflen = count * dev->block_size;
 	cmnd->request_buffer = buffer;
-	cmnd->cmd_len = 10;
-	cmnd->device = usb_devices[usb_index].sdev;
-	be_block_nr = cpu_to_be32(block_nr);
-	memcpy(&cmnd->cmnd[2], &be_block_nr, 4);
-	cmnd->cmnd[8] = 1;
-	cmnd->sc_data_direction = sc_data_direction;
+	cmnd->device = dev->sdev;
+	cmnd->sc_data_direction = write ? DMA_TO_DEVICE : DMA_FROM_DEVICE;
+	cmnd->result = 0;
+}
 
-	init_completion(&compl);
-	cmnd->back = &compl;
 
-	if (usb_devices[usb_index].sdev->host->hostt->queuecommand(cmnd, scsi_done)) {
+/**
+ * Check if the device may pass its next command to the host
+ *
+ * LUNs with queued requests take turns, so a LUN that keeps its queue
+ * filled cannot starve its siblings. Must be called with the host lock
+ * held.
+ */
+static int may_issue(struct usb_stor *dev)
+{
+	struct stor_host *host = dev->host;
+	struct usb_stor  *other;
+
+	if (list_empty(&dev->queued) || host->in_flight >= host->depth || host->busy)
+		return 0;
+
+	if (host->last != dev)
+		return 1;
+
+	list_for_each_entry(other, &host->devices, host_list)
+		if (other != dev && !list_empty(&other->queued))
+			return 0;
+
+	return 1;
+}
+
+
+/**
+ * Pass as many commands to the host as the queue depth permits
+ */
+static void issue_requests(struct usb_stor *dev)
+{
+	struct stor_host *host  = dev->host;
+	struct Scsi_Host *shost = dev->sdev->host;
+	unsigned long chunk = max_blocks(dev);
+	unsigned long flags;
+	int busy, issued = 0;
+
+	for (;;) {
+		struct block_request *req;
+		struct scsi_cmnd     *cmnd;
+		unsigned long         n;
+
+		cmnd = (struct scsi_cmnd *) kmalloc(sizeof(struct scsi_cmnd), GFP_KERNEL);
+		if (!cmnd)
+			break;
+
+		spin_lock_irqsave(&host->lock, flags);
+
+		if (!may_issue(dev)) {
+			spin_unlock_irqrestore(&host->lock, flags);
+			kfree(cmnd);
+			break;
+		}
+
+		/* take the next chunk of the oldest request */
+		req = list_entry(dev->queued.next, struct block_request, list);
+		n   = min(req->count, chunk);
+
+		setup_cmnd(cmnd, dev, req->block_nr, n, req->buffer, req->write);
+		cmnd->back = req;
+
+		req->block_nr += n;
+		req->count    -= n;
+		req->buffer   += n * dev->block_size;
+		req->pending++;
+		host->in_flight++;
+
+		if (req->count == 0)
+			list_del(&req->list);
+
+		spin_unlock_irqrestore(&host->lock, flags);
+
+		/*
+		 * Like the SCSI mid layer, we hold the host lock, under which the
+		 * host's control thread completes a command and becomes idle.
+		 */
+		spin_lock_irqsave(shost->host_lock, flags);
+		busy = shost->hostt->queuecommand(cmnd, io_done);
+		spin_unlock_irqrestore(shost->host_lock, flags);
+
+		if (!busy) {
+			spin_lock_irqsave(&host->lock, flags);
+			host->last = dev;
+			spin_unlock_irqrestore(&host->lock, flags);
+
+			issued = 1;
+			continue;
+		}
+
+		/* revert and retry after the next completion */
+		spin_lock_irqsave(&host->lock, flags);
+
+		if (req->count == 0)
+			list_add(&req->list, &dev->queued);
+
+		req->block_nr -= n;
+		req->count    += n;
+		req->buffer   -= n * dev->block_size;
+		req->pending--;
+		host->in_flight--;
+		host->busy = 1;
+
+		spin_unlock_irqrestore(&host->lock, flags);
+
 		kfree(cmnd);
-		return -EBLK_BUSY;
+		break;
+	}
+
+	/* after our turn, sibling LUNs may use the remaining slots */
+	if (issued)
+		wake_up(&host->wq);
+}
+
+
+/**
+ * Call completion callbacks of finished requests
+ */
+static void complete_requests(struct usb_stor *dev)
+{
+	struct block_request *req, *tmp;
+	unsigned long flags;
+	LIST_HEAD(done);
+
+	spin_lock_irqsave(&dev->host->lock, flags);
+	list_splice_init(&dev->done, &done);
+	spin_unlock_irqrestore(&dev->host->lock, flags);
+
+	list_for_each_entry_safe(req, tmp, &done, list) {
+		list_del(&req->list);
+		req->complete(req->priv, req->error);
+		kfree(req);
+	}
+}
+
+
+static int dispatcher_work_pending(struct usb_stor *dev)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&dev->host->lock, flags);
+	ret = !list_empty(&dev->done) || may_issue(dev);
+	spin_unlock_irqrestore(&dev->host->lock, flags);
+
+	return ret;
+}
+
+
+/**
+ * Request dispatcher, one per device
+ *
+ * Completions are reaped before issuing new commands so that clients get
+ * acknowledgements as early as possible. The dispatchers of all LUNs of a
+ * host wait on the host's wait queue, which is woken on each completion.
+ * After the host rejected a command, the dispatchers wait for the next
+ * completion. If none is in flight, they retry after HOST_BUSY_TIMEOUT.
+ */
+static int dispatcher(void *arg)
+{
+	struct usb_stor  *dev  = arg;
+	struct stor_host *host = dev->host;
+	unsigned long flags;
+
+	for (;;) {
+		if (!host->busy)
+			wait_event(host->wq, dispatcher_work_pending(dev));
+		else if (!wait_event_timeout(host->wq, dispatcher_work_pending(dev),
+		                             HOST_BUSY_TIMEOUT)) {
+			spin_lock_irqsave(&host->lock, flags);
+			host->busy = 0;
+			spin_unlock_irqrestore(&host->lock, flags);
+		}
+
+		complete_requests(dev);
+		issue_requests(dev);
 	}
-	wait_for_completion(&compl);
-	kfree(cmnd);
 
 	return 0;
 }
 
 
+static void start_dispatcher(struct usb_stor *dev)
+{
+	unsigned long flags;
+
+	INIT_LIST_HEAD(&dev->queued);
+	INIT_LIST_HEAD(&dev->done);
+
+	spin_lock_irqsave(&dev->host->lock, flags);
+	list_add_tail(&dev->host_list, &dev->host->devices);
+	spin_unlock_irqrestore(&dev->host->lock, flags);
+
+	kernel_thread(dispatcher, dev, 0);
+}
+
+
+int dde_linux26_block_submit(int usb_index, unsigned long long block_nr,
+                             unsigned long count, void *buffer, int write,
+                             dde_linux26_block_complete_cb complete, void *priv)
+{
+	struct usb_stor *dev = device(usb_index);
+	struct block_request *req;
+	unsigned long flags;
+
+	if (!dev)
+		return -EBLK_NODEV;
+
+	if (!count || block_nr + count > dev->block_count)
+		return -EBLK_FAULT;
+
+	req = (struct block_request *) kmalloc(sizeof(struct block_request), GFP_KERNEL);
+	if (!req)
+		return -EBLK_NOMEM;
+
+	req->dev      = dev;
+	req->block_nr = block_nr;
+	req->count    = count;
+	req->buffer   = buffer;
+	req->write    = write;
+	req->pending  = 0;
+	req->error    = 0;
+	req->complete = complete;
+	req->priv     = priv;
+
+	spin_lock_irqsave(&dev->host->lock, flags);
+	list_add_tail(&req->list, &dev->queued);
+	spin_unlock_irqrestore(&dev->host->lock, flags);
+
+	wake_up(&dev->host->wq);
+	return 0;
+}
+
+
+/**
+ * Synchronous I/O on top of the request queue
+ */
+struct sync_request
+{
+	struct completion compl;
+	int               error;
+};
+
+
+static void sync_complete(void *priv, int error)
+{
+	struct sync_request *sync = priv;
+
+	sync->error = error;
+	complete(&sync->compl);
+}
+
+
+static int block_io_range(int usb_index, unsigned long long block_nr, unsigned long count,
+                          void *buffer, int write)
+{
+	struct sync_request sync;
+	int ret;
+
+	init_completion(&sync.compl);
+
+	ret = dde_linux26_block_submit(usb_index, block_nr, count, buffer, write,
+	                               sync_complete, &sync);
+	if (ret)
+		return ret;
+
+	wait_for_completion(&sync.compl);
+	return sync.error;
+}
+
 int dde_linux26_block_read(int usb_index, unsigned long block_nr, void *buffer)
 {
-	return block_io(usb_index, block_nr, buffer, READ_10, DMA_FROM_DEVICE);
+	return block_io_range(usb_index, block_nr, 1, buffer, 0);
 }
 
 
 int dde_linux26_block_write(int usb_index, unsigned long block_nr, void *buffer)
 {
-	return block_io(usb_index, block_nr, buffer, WRITE_10, DMA_TO_DEVICE);
+	return block_io_range(usb_index, block_nr, 1, buffer, 1);
+}
+
+
+int dde_linux26_block_read_range(int usb_index, unsigned long long block_nr,
+                                 unsigned long count, void *buffer)
+{
+	return block_io_range(usb_index, block_nr, count, buffer, 0);
+}
+
+
+int dde_linux26_block_write_range(int usb_index, unsigned long long block_nr,
+                                  unsigned long count, void *buffer)
+{
+	return block_io_range(usb_index, block_nr, count, buffer, 1);
 }
 
 int dde_linux26_block_present(int usb_index)
 {
-	if (usb_index < 0 && usb_index >= MAX_USB_INDEX)
+	return device(usb_index) != NULL;
+}
+
+int dde_linux26_block_dma_capable(int usb_index, void *buffer, unsigned long size)
+{
+	struct usb_stor *dev = device(usb_index);
+	dde_kit_addr_t phys;
+
+	if (!dev || !size)
+		return 0;
+
+	if ((unsigned long)buffer & queue_dma_alignment(dev->sdev->request_queue))
+		return 0;
+
+	/* the buffer must be known to the page table and physically contiguous */
+	phys = dde_kit_pgtab_get_physaddr(buffer);
+	if (!phys)
 		return 0;
 
-	return (usb_devices[usb_index].sdev != NULL);
+	return dde_kit_pgtab_get_physaddr(buffer + size - 1) == phys + size - 1;
 }
 
 void * dde_linux26_block_malloc(unsigned long size)
@@ -1113,6 +1113,11 @@ static void dev_queue_xmit_nit(struct sk_buff *skb, struct net_device *dev)
 
 void __netif_schedule(struct net_device *dev)
 {
+#ifdef DDE_LINUX
+	/* resume senders blocked in dde_linux26_net_tx() */
+	dde_linux26_net_tx_wake(dev);
+#endif
+
 	if (!test_and_set_bit(__LINK_STATE_SCHED, &dev->state)) {
 		unsigned long flags;
 		struct softnet_data *sd;
@@ -1138,7 +1143,11 @@ void __netif_rx_schedule(struct net_device *dev)
 		dev->quota += dev->weight;
 	else
 		dev->quota = dev->weight;
+#ifndef DDE_LINUX
 	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
+#else
+	dde_linux26_softnet_schedule();
+#endif
 	local_irq_restore(flags);
 }
 EXPORT_SYMBOL(__netif_rx_schedule);
@@ -1626,8 +1635,8 @@ enqueue:
 	kfree_skb(skb);
 	return NET_RX_DROP;
 #else /* DDE_LINUX */
-	/* call our callback fn */
-	return dde_linux26_do_rx_callback(skb);
+	/* queue packet for the softnet thread */
+	return dde_linux26_softnet_rx(skb);
 #endif
 }
 
@@ -1976,11 +1985,19 @@ out:
 	}
 #endif
 	local_irq_enable();
+#ifdef DDE_LINUX
+	/* hand out packets received during this poll round */
+	dde_linux26_net_rx_flush();
+#endif
 	return;
 
 softnet_break:
 	__get_cpu_var(netdev_rx_stat).time_squeeze++;
+#ifndef DDE_LINUX
 	__raise_softirq_irqoff(NET_RX_SOFTIRQ);
+#else
+	dde_linux26_softnet_squeeze();
+#endif
 	goto out;
 }
 
@@ -3544,7 +3561,12 @@ static int __init net_dev_init(void)
 	dev_boot_phase = 0;
 
 	open_softirq(NET_TX_SOFTIRQ, net_tx_action, NULL);
+#ifndef DDE_LINUX
 	open_softirq(NET_RX_SOFTIRQ, net_rx_action, NULL);
+#else
+	/* packet reception is polled by the softnet thread */
+	dde_linux26_softnet_init(net_rx_action);
+#endif
 
 	hotcpu_notifier(dev_cpu_callback, 0);
 #ifndef DDE_LINUX
@@ -25,6 +25,10 @@
 #include <linux/bitops.h>
 #include <asm/types.h>
 
+#ifdef DDE_LINUX
+#include "local.h"
+#endif
+
 
 enum lw_bits {
 	LW_RUNNING = 0,
@@ -153,7 +157,10 @@ static void linkwatch_event(struct work_struct *dummy)
 
 void linkwatch_fire_event(struct net_device *dev)
 {
-#ifndef DDE_LINUX
+#ifdef DDE_LINUX
+	/* no link policy in DDE - just tell the server */
+	dde_linux26_net_link_event(dev);
+#else
 	if (!test_and_set_bit(__LINK_STATE_LINKWATCH_PENDING, &dev->state)) {
 		unsigned long flags;
 		struct lw_event *event;
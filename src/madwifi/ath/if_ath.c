@@ -93,6 +93,10 @@
 #include "ath_tx99.h"
 #endif
 
+#ifdef DDE_LINUX
+#include <dde_linux26/net.h>
+#endif
+
 /* unaligned little endian access */
 #define LE_READ_2(p)							\
 	((u_int16_t)							\
@@ -5278,12 +5282,17 @@ ath_node_move_data(const struct ieee80211_node *ni)
 #endif
 
 static struct sk_buff *
-ath_alloc_skb(u_int size, u_int align)
+ath_alloc_skb(struct net_device *dev, u_int size, u_int align)
 {
 	struct sk_buff *skb;
 	u_int off;
 
+#ifdef DDE_LINUX
+	/* receive into buffers provided by the client if possible */
+	skb = dde_linux26_net_alloc_rx_skb(dev, size + align - 1);
+#else
 	skb = dev_alloc_skb(size + align - 1);
+#endif
 	if (skb != NULL) {
 		off = ((unsigned long) skb->data) % align;
 		if (off != 0)
@@ -5335,7 +5344,7 @@ ath_rxbuf_init(struct ath_softc *sc, struct ath_buf *bf)
 			 * 5210 at least) as not doing so causes bogus data
 			 * in rx'd frames.
 			 */
-			skb = ath_alloc_skb(sc->sc_rxbufsize, sc->sc_cachelsz);
+			skb = ath_alloc_skb(sc->sc_dev, sc->sc_rxbufsize, sc->sc_cachelsz);
 			if (skb == NULL) {
 				DPRINTF(sc, ATH_DEBUG_ANY,
 					"%s: skbuff alloc of size %u failed\n",
@@ -9,6 +9,7 @@
 #include <net/iw_handler.h>
 
 #include <dde_kit/printf.h>
+#include <dde_linux26/net.h>
 #include <dde_linux26/wifi.h>
 
 
@@ -19,6 +20,16 @@ int dde_linux26_wifi_atheros_idx()
 }
 
 
+int dde_linux26_wifi_atheros_phy_idx()
+{
+	struct net_device *dev = dev_get_by_name("wifi0");
+	int idx = dev ? dev->ifindex : -1;
+
+	if (dev) dev_put(dev);
+	return idx;
+}
+
+
 void dde_linux26_wifi_set_essid(int idx, const char *essid)
 {
 	struct net_device *dev  = dev_get_by_index(idx);
@@ -28,6 +39,18 @@ void dde_linux26_wifi_set_essid(int idx, const char *essid)
 	request.u.essid.length  = strlen(essid);
 	strncpy(request.ifr_ifrn.ifrn_name, dev->name, IFNAMSIZ);
 
+	/*
+	 * The station has no carrier until net80211 reports the association
+	 * with the new network by netif_carrier_on().
+	 */
+	netif_carrier_off(dev);
+
 	if (wireless_process_ioctl((struct ifreq *)&request, SIOCSIWESSID))
 		dde_kit_printf("Failed to set ESSID %s\n", essid);
 }
+
+
+int dde_linux26_wifi_wait_for_association(int idx, unsigned timeout_ms)
+{
+	return dde_linux26_net_wait_for_link(idx, timeout_ms);
+}
@@ -8,6 +8,21 @@
 #define _DDE__WIFI_H_
 
 int  dde_linux26_wifi_atheros_idx(void);
+int  dde_linux26_wifi_atheros_phy_idx(void);
 void dde_linux26_wifi_set_essid(int idx, const char *essid);
 
+/**
+ * Wait until the station associated with the network set by
+ * dde_linux26_wifi_set_essid()
+ *
+ * \param idx         index of the wifi device
+ * \param timeout_ms  maximum time to wait
+ *
+ * \return 0 on association, negative error code on timeout
+ *
+ * Association and disassociation are reported as link up and down by the
+ * link-state callback of dde_linux26/net.h.
+ */
+int  dde_linux26_wifi_wait_for_association(int idx, unsigned timeout_ms);
+
 #endif /* _DDE__WIFI_H_ */
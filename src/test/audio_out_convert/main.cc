@@ -0,0 +1,170 @@
+/*
+ * \brief  Benchmark of the audio_out sample-conversion and mixing kernels
+ * \date   2026-10-18
+ *
+ * Every kernel supported by the CPU converts the same test signal, which
+ * contains full-scale, clipping and NaN samples, with and without dither
+ * at 1, 2, 6 and 8 channels. The output is compared against the scalar
+ * reference and the throughput is reported in frames per second. The
+ * mixing kernels are checked and measured the same way.
+ */
+
+#include <base/printf.h>
+#include <base/sleep.h>
+#include <timer_session/connection.h>
+#include <util/string.h>
+
+#include <convert.h>
+
+using namespace Genode;
+using namespace Audio_out;
+
+enum {
+	FRAMES = 1024,   /* audio_out period */
+	ROUNDS = 2000,
+};
+
+static float src_buf[MAX_CONVERT_CHANNELS][FRAMES];
+static short ref_buf[MAX_CONVERT_CHANNELS * FRAMES];
+static short dst_buf[MAX_CONVERT_CHANNELS * FRAMES];
+static float ref_mix[FRAMES];
+static float dst_mix[FRAMES];
+
+
+static inline unsigned long long rdtsc()
+{
+	unsigned lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+
+static void fill_signal()
+{
+	unsigned s = 12345;
+	union { unsigned u; float f; } nan = { 0x7fc00000 };
+
+	for (unsigned c = 0; c < MAX_CONVERT_CHANNELS; c++)
+		for (unsigned i = 0; i < FRAMES; i++) {
+			s = s * 1103515245 + 12345;
+
+			/* mostly in range, some samples clip by up to 25% */
+			float v = (float)(int)(s >> 8) / (float)(1 << 23) * 1.25f - 1.25f;
+			if (i % 251 == 0) v = nan.f;
+			if (i % 127 == 0) v = (i & 128) ? 1.0f : -1.0f;
+			src_buf[c][i] = v;
+		}
+}
+
+
+int main(int argc, char **argv)
+{
+	static Timer::Connection timer;
+
+	static const struct { const char *name; Convert_kernel kernel; } kernels[] = {
+		{ "scalar", convert_scalar }, { "SSE2", convert_sse2 }, { "AVX2", convert_avx2 } };
+	static const unsigned channels[] = { 1, 2, 6, 8 };
+
+	printf("--- audio_out conversion benchmark ---\n");
+	printf("fastest supported kernel: %s\n", convert_kernel_name(convert_kernel()));
+	if (!convert_simd_compiled())
+		printf("SIMD kernels compiled out, SSE2 and AVX2 run scalar code\n");
+
+	/* calibrate TSC */
+	unsigned long long start = rdtsc();
+	timer.msleep(100);
+	unsigned long long tsc_khz = (rdtsc() - start) / 100;
+
+	fill_signal();
+
+	float const *src[MAX_CONVERT_CHANNELS];
+	for (unsigned c = 0; c < MAX_CONVERT_CHANNELS; c++)
+		src[c] = src_buf[c];
+
+	Convert_kernel fastest = convert_kernel();
+	bool failed = false;
+
+	for (unsigned k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++) {
+
+		/* skip kernels the CPU does not support */
+		if (kernels[k].kernel == convert_avx2 && fastest != convert_avx2)
+			continue;
+		if (kernels[k].kernel == convert_sse2 && fastest == convert_scalar)
+			continue;
+
+		for (unsigned i = 0; i < sizeof(channels)/sizeof(channels[0]); i++)
+			for (int dither = 0; dither < 2; dither++) {
+				unsigned n = channels[i];
+				Dither ref_dither, dst_dither;
+				bool exact = true;
+
+				/* several periods to cover the dither-state hand-over */
+				for (unsigned r = 0; r < 4; r++) {
+					convert_scalar(ref_buf, src, n, FRAMES - r, dither ? &ref_dither : 0);
+					kernels[k].kernel(dst_buf, src, n, FRAMES - r, dither ? &dst_dither : 0);
+					if (memcmp(ref_buf, dst_buf, n * (FRAMES - r) * sizeof(short)))
+						exact = false;
+				}
+
+				start = rdtsc();
+				for (unsigned r = 0; r < ROUNDS; r++)
+					kernels[k].kernel(dst_buf, src, n, FRAMES, dither ? &dst_dither : 0);
+				unsigned long long cycles = rdtsc() - start;
+
+				unsigned long long frames = (unsigned long long)FRAMES * ROUNDS;
+				unsigned long kfps = cycles ? (unsigned long)(frames * tsc_khz / cycles) : 0;
+
+				printf("%s, %u channel(s), %s: %lu kframes/s, %s\n",
+				       kernels[k].name, n, dither ? "dither" : "no dither",
+				       kfps, exact ? "bit-exact" : "MISMATCH");
+
+				failed |= !exact;
+			}
+	}
+
+	static const struct { const char *name; Mix_kernel kernel; } mixers[] = {
+		{ "scalar", mix_scalar }, { "SSE2", mix_sse2 }, { "AVX2", mix_avx2 } };
+
+	Mix_kernel fastest_mix = mix_kernel();
+
+	for (unsigned k = 0; k < sizeof(mixers)/sizeof(mixers[0]); k++) {
+
+		if (mixers[k].kernel == mix_avx2 && fastest_mix != mix_avx2)
+			continue;
+		if (mixers[k].kernel == mix_sse2 && fastest_mix == mix_scalar)
+			continue;
+
+		/* mix 'FRAMES - r' frames of four sources with different gains */
+		bool exact = true;
+		for (unsigned r = 0; r < 4; r++) {
+			memset(ref_mix, 0, sizeof(ref_mix));
+			memset(dst_mix, 0, sizeof(dst_mix));
+			for (unsigned c = 0; c < 4; c++) {
+				mix_scalar(ref_mix, src[c], 0.25f * (c + 1), FRAMES - r);
+				mixers[k].kernel(dst_mix, src[c], 0.25f * (c + 1), FRAMES - r);
+			}
+			/* compare bit patterns, the signal contains NaN */
+			if (memcmp(ref_mix, dst_mix, sizeof(ref_mix)))
+				exact = false;
+		}
+
+		start = rdtsc();
+		for (unsigned r = 0; r < ROUNDS; r++)
+			mixers[k].kernel(dst_mix, src[r % MAX_CONVERT_CHANNELS], 0.5f, FRAMES);
+		unsigned long long cycles = rdtsc() - start;
+
+		unsigned long long frames = (unsigned long long)FRAMES * ROUNDS;
+		unsigned long kfps = cycles ? (unsigned long)(frames * tsc_khz / cycles) : 0;
+
+		printf("mix %s: %lu kframes/s, %s\n", mixers[k].name, kfps,
+		       exact ? "bit-exact" : "MISMATCH");
+
+		failed |= !exact;
+	}
+
+	printf("--- audio_out conversion benchmark %s ---\n",
+	       failed ? "failed" : "finished");
+
+	sleep_forever();
+	return 0;
+}
@@ -0,0 +1,6 @@
+TARGET   = test-audio_out_convert
+SRC_CC   = main.cc convert.cc
+LIBS     = cxx env
+INC_DIR += $(REP_DIR)/src/drivers/audio_out
+
+vpath convert.cc $(REP_DIR)/src/drivers/audio_out
@@ -0,0 +1,246 @@
+/*
+ * \brief  Quality test and benchmark of the audio_out resampler
+ * \date   2026-10-18
+ *
+ * For every quality level, sines of several frequencies are converted
+ * between common rates. A sine of the known output frequency is fitted to
+ * the result by least squares. Everything else is noise and distortion,
+ * whose power relative to the sine yields the THD+N. The throughput is
+ * reported in frames per second for stereo input.
+ */
+
+#include <base/env.h>
+#include <base/printf.h>
+#include <base/sleep.h>
+#include <util/misc_math.h>
+#include <timer_session/connection.h>
+
+#include <resample.h>
+
+using namespace Genode;
+using namespace Audio_out;
+
+enum {
+	FRAMES = 1024,   /* audio_out period */
+	CHUNKS = 48,
+	ROUNDS = 200,
+};
+
+static float in_buf[Resampler::MAX_CHANNELS][FRAMES * CHUNKS];
+static float out_buf[Resampler::MAX_CHANNELS][FRAMES * CHUNKS * Resampler::MAX_RATIO];
+
+static const double PI = 3.14159265358979323846;
+
+
+static inline unsigned long long rdtsc()
+{
+	unsigned lo, hi;
+	asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((unsigned long long)hi << 32) | lo;
+}
+
+
+/**
+ * Return '10 * log10(x)' for 'x' > 0
+ */
+static double decibel(double x)
+{
+	/* x = m * 2^e with m in [0.75, 1.5) */
+	int e = 0;
+	while (x >= 1.5)  { x /= 2; e++; }
+	while (x <  0.75) { x *= 2; e--; }
+
+	/* ln(m) = 2 atanh((m - 1) / (m + 1)) */
+	double y = (x - 1) / (x + 1), y2 = y * y, term = y, sum = 0;
+	for (unsigned i = 1; i < 40; i += 2) {
+		sum  += term / i;
+		term *= y2;
+	}
+
+	double const LN2 = 0.69314718055994530942, LN10 = 2.30258509299404568402;
+	return 10 * (2 * sum + e * LN2) / LN10;
+}
+
+
+/**
+ * Solve 3x3 linear system 'a * x = b' by Gaussian elimination
+ */
+static void solve3(double a[3][3], double b[3], double x[3])
+{
+	for (unsigned i = 0; i < 3; i++)
+		for (unsigned j = i + 1; j < 3; j++) {
+			double f = a[j][i] / a[i][i];
+			for (unsigned k = i; k < 3; k++)
+				a[j][k] -= f * a[i][k];
+			b[j] -= f * b[i];
+		}
+
+	for (int i = 2; i >= 0; i--) {
+		double s = b[i];
+		for (unsigned k = i + 1; k < 3; k++)
+			s -= a[i][k] * x[k];
+		x[i] = s / a[i][i];
+	}
+}
+
+
+/**
+ * Fit 'a sin(wn) + b cos(wn) + c' to the signal
+ *
+ * \return  THD+N in dB
+ */
+static double thd_n(float const *sig, unsigned n, double w)
+{
+	double a[3][3] = { { 0 } }, b[3] = { 0 }, x[3];
+	double s = 0, c = 1, sw = sine(w), cw = sine(w + PI / 2);
+
+	for (unsigned i = 0; i < n; i++) {
+		double basis[3] = { s, c, 1 };
+		for (unsigned j = 0; j < 3; j++) {
+			for (unsigned k = 0; k < 3; k++)
+				a[j][k] += basis[j] * basis[k];
+			b[j] += basis[j] * sig[i];
+		}
+
+		/* rotate the phasor by w */
+		double t = s * cw + c * sw;
+		c = c * cw - s * sw;
+		s = t;
+	}
+	solve3(a, b, x);
+
+	double signal = 0, residual = 0;
+	s = 0; c = 1;
+	for (unsigned i = 0; i < n; i++) {
+		double fit = x[0] * s + x[1] * c;
+		double r   = sig[i] - fit - x[2];
+		signal   += fit * fit;
+		residual += r * r;
+
+		double t = s * cw + c * sw;
+		c = c * cw - s * sw;
+		s = t;
+	}
+
+	return residual > 0 ? decibel(residual / signal) : -400;
+}
+
+
+/**
+ * Convert test signal in chunks of one period
+ *
+ * \return  number of output frames
+ */
+static unsigned convert(Resampler *resampler, unsigned chunks)
+{
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < chunks; i++) {
+		float const *src[Resampler::MAX_CHANNELS];
+		float       *dst[Resampler::MAX_CHANNELS];
+		for (unsigned c = 0; c < Resampler::MAX_CHANNELS; c++) {
+			src[c] = in_buf[c]  + i * FRAMES;
+			dst[c] = out_buf[c] + n;
+		}
+		n += resampler->process(dst, src, FRAMES);
+	}
+
+	return n;
+}
+
+
+int main(int argc, char **argv)
+{
+	static Timer::Connection timer;
+
+	static const struct { unsigned in, out; } rates[] = {
+		{ 44100, 48000 }, { 48000, 44100 }, { 44100, 96000 }, { 44100, 32000 } };
+	static const unsigned freqs[] = { 1000, 5000, 12000 };
+	static const struct { const char *name; double max_thd_n; } levels[] = {
+		{ "low", -50 }, { "medium", -75 }, { "high", -95 } };
+
+	printf("--- audio_out resampler test ---\n");
+	printf("dot-product kernel: %s\n",
+	       dot_kernel() == dot_avx2 ? "AVX2" : dot_kernel() == dot_sse2 ? "SSE2" : "scalar");
+	if (!convert_simd_compiled())
+		printf("SIMD kernels compiled out, SSE2 and AVX2 run scalar code\n");
+
+	/* calibrate TSC */
+	unsigned long long start = rdtsc();
+	timer.msleep(100);
+	unsigned long long tsc_khz = (rdtsc() - start) / 100;
+
+	bool failed = false;
+
+	for (unsigned q = 0; q < sizeof(levels)/sizeof(levels[0]); q++)
+		for (unsigned r = 0; r < sizeof(rates)/sizeof(rates[0]); r++) {
+
+			Resampler::Quality quality = (Resampler::Quality)q;
+
+			Resampler *resampler = 0;
+
+			for (unsigned f = 0; f < sizeof(freqs)/sizeof(freqs[0]); f++) {
+
+				/* the lower rate limits the passband */
+				unsigned min_rate = min(rates[r].in, rates[r].out);
+				if (freqs[f] * 8 > min_rate * 3)
+					continue;
+
+				double w = 2 * PI * freqs[f] / rates[r].in;
+				for (unsigned c = 0; c < Resampler::MAX_CHANNELS; c++)
+					for (unsigned i = 0; i < FRAMES * CHUNKS; i++)
+						in_buf[c][i] = (float)(0.5 * sine(w * i));
+
+				/* start with empty filter history */
+				if (resampler)
+					destroy(env()->heap(), resampler);
+				resampler = new (env()->heap())
+					Resampler(rates[r].in, rates[r].out, quality,
+					          Resampler::MAX_CHANNELS);
+
+				if (!resampler->valid()) {
+					printf("%u -> %u Hz unsupported\n", rates[r].in, rates[r].out);
+					destroy(env()->heap(), resampler);
+					resampler = 0;
+					failed = true;
+					break;
+				}
+
+				unsigned n = convert(resampler, CHUNKS);
+
+				/* skip the filter transient */
+				unsigned skip = resampler->taps() * Resampler::MAX_RATIO;
+				double db = thd_n(out_buf[0] + skip, n - skip,
+				                  2 * PI * freqs[f] / rates[r].out);
+
+				bool ok = db <= levels[q].max_thd_n;
+				printf("%s, %u -> %u Hz, %u Hz: THD+N %d.%d dB, %s\n",
+				       levels[q].name, rates[r].in, rates[r].out, freqs[f],
+				       (int)db, (int)(db < 0 ? -db * 10 : db * 10) % 10,
+				       ok ? "ok" : "FAILED");
+				failed |= !ok;
+			}
+
+			if (!resampler)
+				continue;
+
+			/* throughput for stereo */
+			start = rdtsc();
+			for (unsigned i = 0; i < ROUNDS; i++)
+				convert(resampler, 1);
+			unsigned long long cycles = rdtsc() - start;
+
+			destroy(env()->heap(), resampler);
+
+			unsigned long long frames = (unsigned long long)FRAMES * ROUNDS;
+			unsigned long kfps = cycles ? (unsigned long)(frames * tsc_khz / cycles) : 0;
+
+			printf("%s, %u -> %u Hz: %lu kframes/s\n",
+			       levels[q].name, rates[r].in, rates[r].out, kfps);
+		}
+
+	printf("--- audio_out resampler test %s ---\n", failed ? "failed" : "finished");
+
+	sleep_forever();
+	return 0;
+}
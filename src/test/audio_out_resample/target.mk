@@ -0,0 +1,7 @@
+TARGET   = test-audio_out_resample
+SRC_CC   = main.cc resample.cc convert.cc
+LIBS     = cxx env
+INC_DIR += $(REP_DIR)/src/drivers/audio_out
+
+vpath resample.cc $(REP_DIR)/src/drivers/audio_out
+vpath convert.cc  $(REP_DIR)/src/drivers/audio_out
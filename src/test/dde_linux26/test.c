@@ -16,8 +16,23 @@
 #include <linux/workqueue.h>
 #include <linux/interrupt.h>
 #include <linux/pci.h>
+#include <linux/mm.h>
+#include <linux/blkdev.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+
+#include <scsi/scsi.h>
+#include <scsi/scsi_cmnd.h>
+#include <scsi/scsi_device.h>
+#include <scsi/scsi_host.h>
 
 #include <dde_linux26/general.h>
+#include <dde_linux26/block.h>
+#include <dde_linux26/net.h>
+#include <dde_linux26/atomic.h>
+
+#include <dde_kit/lock.h>
+#include <dde_kit/spin_lock.h>
 
 
 /*
@@ -151,8 +166,33 @@ static DECLARE_TASKLET(hi1, tasklet_func, 11);
 static DECLARE_TASKLET_DISABLED(hi2, tasklet_func, 12);
 
 
+enum { TASKLET_ORDER_COUNT = 8 };
+
+static struct tasklet_struct tasklet_order[TASKLET_ORDER_COUNT];
+static int                   tasklet_order_seen[TASKLET_ORDER_COUNT];
+static int                   tasklet_order_pos;
+
+
+static void tasklet_order_func(unsigned long i)
+{
+	tasklet_order_seen[tasklet_order_pos++] = i;
+}
+
+
+static void tasklet_stats_print(const char *name, unsigned nr)
+{
+	struct dde_linux26_softirq_stats stats;
+
+	dde_linux26_softirq_stats(nr, &stats);
+	printk("%s: raised %lu run %lu time %llu us\n",
+	       name, stats.raised, stats.run, stats.time_us);
+}
+
+
 static void tasklet_test(void)
 {
+	int i;
+
 	printk("BEGIN TASKLET TEST\n");
 
 	printk("sleep 1000 msec\n");
@@ -185,6 +225,21 @@ static void tasklet_test(void)
 
 	msleep(1000);
 
+	printk("Scheduling %d tasklets - should run in order.\n", TASKLET_ORDER_COUNT);
+	for (i = 0; i < TASKLET_ORDER_COUNT; i++)
+		tasklet_init(&tasklet_order[i], tasklet_order_func, i);
+	for (i = 0; i < TASKLET_ORDER_COUNT; i++)
+		tasklet_schedule(&tasklet_order[i]);
+
+	msleep(1000);
+	for (i = 0; i < tasklet_order_pos; i++)
+		if (tasklet_order_seen[i] != i)
+			break;
+	printk("%d of %d tasklets ran in order\n", i, TASKLET_ORDER_COUNT);
+
+	tasklet_stats_print("HI_SOFTIRQ", HI_SOFTIRQ);
+	tasklet_stats_print("TASKLET_SOFTIRQ", TASKLET_SOFTIRQ);
+
 	printk("END TASKLET TEST\n");
 }
 
@@ -230,6 +285,59 @@ static void timer_func(unsigned long d)
 }
 
 
+/*
+ * The benchmark arms TIMER_BENCH_TIMERS timers with spread-out timeouts,
+ * re-arms each of them TIMER_BENCH_ROUNDS times like a retransmit timer
+ * and finally lets a batch of short timers expire.
+ */
+
+enum {
+	TIMER_BENCH_TIMERS = 1024,
+	TIMER_BENCH_ROUNDS = 100,
+};
+
+static struct timer_list timer_bench[TIMER_BENCH_TIMERS];
+static atomic_t          timer_bench_fired;
+
+
+static void timer_bench_func(unsigned long d)
+{
+	atomic_inc(&timer_bench_fired);
+}
+
+
+static void timer_bench_run(void)
+{
+	unsigned long start, elapsed, ops;
+	int i, r;
+
+	for (i = 0; i < TIMER_BENCH_TIMERS; i++)
+		setup_timer(&timer_bench[i], timer_bench_func, i);
+
+	start = jiffies;
+	for (r = 0; r < TIMER_BENCH_ROUNDS; r++)
+		for (i = 0; i < TIMER_BENCH_TIMERS; i++)
+			mod_timer(&timer_bench[i], jiffies + 10*HZ + (i * 37 + r) % (60*HZ));
+	for (i = 0; i < TIMER_BENCH_TIMERS; i++)
+		del_timer(&timer_bench[i]);
+	elapsed = max(1UL, jiffies - start);
+
+	ops = (unsigned long)TIMER_BENCH_ROUNDS * TIMER_BENCH_TIMERS + TIMER_BENCH_TIMERS;
+	printk("timer mod/del: %lu ops in %lu ms -> %lu ops/s\n",
+	       ops, elapsed * 1000 / HZ, ops * HZ / elapsed);
+
+	atomic_set(&timer_bench_fired, 0);
+	start = jiffies;
+	for (i = 0; i < TIMER_BENCH_TIMERS; i++)
+		mod_timer(&timer_bench[i], start + 1 + i % HZ);
+	while (atomic_read(&timer_bench_fired) < TIMER_BENCH_TIMERS)
+		msleep(10);
+
+	printk("timer expiry: %d timers within %lu ms (expected %d ms)\n",
+	       TIMER_BENCH_TIMERS, (jiffies - start) * 1000 / HZ, 1000);
+}
+
+
 static void timer_test(void)
 {
 	printk("BEGIN TIMER TEST\n");
@@ -257,14 +365,161 @@ static void timer_test(void)
 	add_timer(&_timer25);
 
 	msleep(30000);
+
+	timer_bench_run();
 	printk("END TIMER TEST\n");
 }
 
 
+/*
+ * The delay benchmark measures each requested delay DELAY_BENCH_SAMPLES
+ * times and reports the distribution of the achieved delays.
+ */
+
+enum { DELAY_BENCH_SAMPLES = 64 };
+
+static unsigned long delay_bench_ns[DELAY_BENCH_SAMPLES];
+
+
+/* nanosecond timestamp, wraps but differences below 4 s are fine */
+static unsigned long delay_bench_now(void)
+{
+	struct timespec ts;
+
+	ktime_get_ts(&ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+static void delay_bench_report(const char *what, unsigned long requested_ns)
+{
+	unsigned long sum = 0;
+	int i, j;
+
+	/* insertion sort for the percentiles */
+	for (i = 1; i < DELAY_BENCH_SAMPLES; i++) {
+		unsigned long v = delay_bench_ns[i];
+		for (j = i; j > 0 && delay_bench_ns[j - 1] > v; j--)
+			delay_bench_ns[j] = delay_bench_ns[j - 1];
+		delay_bench_ns[j] = v;
+	}
+	for (i = 0; i < DELAY_BENCH_SAMPLES; i++)
+		sum += delay_bench_ns[i] / 1000;
+
+	printk("%-24s %8lu us: min %8lu med %8lu p99 %8lu max %8lu avg %8lu us\n",
+	       what, requested_ns / 1000,
+	       delay_bench_ns[0] / 1000,
+	       delay_bench_ns[DELAY_BENCH_SAMPLES / 2] / 1000,
+	       delay_bench_ns[DELAY_BENCH_SAMPLES * 99 / 100] / 1000,
+	       delay_bench_ns[DELAY_BENCH_SAMPLES - 1] / 1000,
+	       sum / DELAY_BENCH_SAMPLES);
+}
+
+
+static void delay_test(void)
+{
+	static const unsigned long udelays[] = { 1, 5, 10, 50, 100, 1000, 5000 };
+	static const unsigned int  msleeps[] = { 1, 2, 10, 20 };
+	static const long          timeouts[] = { 1, 2, 5 };
+	unsigned i;
+	int s;
+
+	printk("BEGIN DELAY TEST\n");
+
+	for (i = 0; i < ARRAY_SIZE(udelays); i++) {
+		for (s = 0; s < DELAY_BENCH_SAMPLES; s++) {
+			unsigned long start = delay_bench_now();
+			udelay(udelays[i]);
+			delay_bench_ns[s] = delay_bench_now() - start;
+		}
+		delay_bench_report("udelay", udelays[i] * 1000);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(msleeps); i++) {
+		for (s = 0; s < DELAY_BENCH_SAMPLES; s++) {
+			unsigned long start = delay_bench_now();
+			msleep(msleeps[i]);
+			delay_bench_ns[s] = delay_bench_now() - start;
+		}
+		delay_bench_report("msleep", msleeps[i] * 1000000UL);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(timeouts); i++) {
+		for (s = 0; s < DELAY_BENCH_SAMPLES; s++) {
+			unsigned long start = delay_bench_now();
+			schedule_timeout_uninterruptible(timeouts[i]);
+			delay_bench_ns[s] = delay_bench_now() - start;
+		}
+		delay_bench_report("schedule_timeout", timeouts[i] * (NSEC_PER_SEC / HZ));
+	}
+
+	printk("END DELAY TEST\n");
+}
+
+
 /******************************
  ** Test 6: Memory subsystem **
  ******************************/
 
+/*
+ * The benchmark runs 1..KMEM_BENCH_THREADS threads, each allocating and
+ * freeing batches of skb-sized objects like a busy network driver.
+ */
+
+enum {
+	KMEM_BENCH_THREADS = 8,
+	KMEM_BENCH_BATCH   = 32,
+	KMEM_BENCH_ROUNDS  = 20000,
+};
+
+static struct kmem_cache *kmem_bench_cache;
+static struct completion  kmem_bench_done[KMEM_BENCH_THREADS];
+
+
+static int kmem_bench_thread(void *arg)
+{
+	int   id = (int)arg;
+	void *obj[KMEM_BENCH_BATCH];
+	int   r, i;
+
+	for (r = 0; r < KMEM_BENCH_ROUNDS; r++) {
+		for (i = 0; i < KMEM_BENCH_BATCH; i++)
+			obj[i] = kmem_cache_alloc(kmem_bench_cache, GFP_KERNEL);
+		for (i = KMEM_BENCH_BATCH; i > 0; i--)
+			kmem_cache_free(kmem_bench_cache, obj[i-1]);
+	}
+
+	complete_and_exit(&kmem_bench_done[id], 0);
+}
+
+
+static void memory_kmem_cache_bench(void)
+{
+	int threads, i;
+
+	kmem_bench_cache = kmem_cache_create("bench", 192, 0, 0, 0, 0);
+
+	for (threads = 1; threads <= KMEM_BENCH_THREADS; threads *= 2) {
+		unsigned long start, elapsed;
+		unsigned long ops = 2UL * KMEM_BENCH_BATCH * KMEM_BENCH_ROUNDS * threads;
+
+		start = jiffies;
+		for (i = 0; i < threads; i++) {
+			init_completion(&kmem_bench_done[i]);
+			kernel_thread(kmem_bench_thread, (void *)i, 0);
+		}
+		for (i = 0; i < threads; i++)
+			wait_for_completion(&kmem_bench_done[i]);
+		elapsed = max(1UL, jiffies - start);
+
+		printk("kmem_cache %d thread(s): %lu ops in %lu ms -> %lu ops/s\n",
+		       threads, ops, elapsed * 1000 / HZ, ops * HZ / elapsed);
+	}
+
+	kmem_cache_destroy(kmem_bench_cache);
+}
+
+
 static void memory_kmem_cache_test(void)
 {
 	struct kmem_cache *cache0;
@@ -301,6 +556,8 @@ static void memory_kmem_cache_test(void)
 
 	kmem_cache_destroy(cache1);
 	kmem_cache_destroy(cache0);
+
+	memory_kmem_cache_bench();
 }
 
 
@@ -424,6 +681,920 @@ void pci_test(void)
 }
 
 
+/*****************************************
+ ** Test 10: Block request queue (IOPS) **
+ *****************************************/
+
+/*
+ * A simulated SCSI host completes every command after SIM_DELAY jiffies.
+ * For each queue depth, a device is attached and a batch of single-block
+ * reads is submitted at once. With a working request queue, IOPS scale
+ * with the queue depth.
+ */
+
+enum {
+	SIM_HOSTS    = 4,        /* queue depths 1, 2, 4, 8 */
+	SIM_BLOCKS   = 1 << 16,
+	SIM_DELAY    = 1,        /* jiffies */
+	SIM_REQUESTS = 200,
+};
+
+/**
+ * Simulated host state, stored in the host's 'hostdata'
+ */
+struct sim_host
+{
+	atomic_t      in_flight;
+	unsigned long delay;      /* jiffies */
+	unsigned int  luns;
+};
+
+struct sim_cmnd
+{
+	struct timer_list  timer;
+	struct scsi_cmnd  *cmnd;
+	void             (*done)(struct scsi_cmnd *);
+	struct sim_host   *sim;
+};
+
+static struct scsi_host_template sim_template[SIM_HOSTS];
+static int                       sim_first;  /* first device of last scan */
+static int                       sim_found;  /* devices found by last scan */
+
+static void sim_complete(unsigned long data)
+{
+	struct sim_cmnd *sc = (struct sim_cmnd *)data;
+
+	atomic_dec(&sc->sim->in_flight);
+	sc->cmnd->result = 0;
+	sc->done(sc->cmnd);
+	kfree(sc);
+}
+
+
+static int sim_queuecommand(struct scsi_cmnd *cmnd, void (*done)(struct scsi_cmnd *))
+{
+	struct Scsi_Host *host = cmnd->device->host;
+	struct sim_host  *sim  = (struct sim_host *)host->hostdata;
+	struct sim_cmnd  *sc;
+
+	switch (cmnd->cmnd[0]) {
+	case INQUIRY:
+		/* direct-access device for all existing LUNs */
+		memset(cmnd->request_buffer, 0, cmnd->request_bufflen);
+		cmnd->result = cmnd->device->lun < sim->luns ? 0 : DID_BAD_TARGET << 16;
+		done(cmnd);
+		return 0;
+
+	case READ_CAPACITY:
+		((__be32 *)cmnd->request_buffer)[0] = cpu_to_be32(SIM_BLOCKS - 1);
+		((__be32 *)cmnd->request_buffer)[1] = cpu_to_be32(512);
+		cmnd->result = 0;
+		done(cmnd);
+		return 0;
+	}
+
+	/* the queue depth is shared by all LUNs of the host */
+	if (atomic_read(&sim->in_flight) >= host->hostt->can_queue)
+		return SCSI_MLQUEUE_HOST_BUSY;
+
+	sc = kmalloc(sizeof(*sc), GFP_ATOMIC);
+	sc->cmnd = cmnd;
+	sc->done = done;
+	sc->sim  = sim;
+	atomic_inc(&sim->in_flight);
+
+	setup_timer(&sc->timer, sim_complete, (unsigned long)sc);
+	sc->timer.expires = jiffies + sim->delay;
+	add_timer(&sc->timer);
+	return 0;
+}
+
+
+static void sim_plugin(int usb_index)
+{
+	if (sim_found++ == 0)
+		sim_first = usb_index;
+}
+
+
+/**
+ * Create simulated host and scan its LUNs
+ *
+ * \return device index of the first LUN found
+ */
+static int sim_create_host(struct scsi_host_template *t, int can_queue,
+                           unsigned long delay, unsigned luns)
+{
+	struct Scsi_Host *host;
+	struct sim_host  *sim;
+
+	dde_linux26_block_register_plugin_callback(sim_plugin);
+
+	t->name         = "sim";
+	t->queuecommand = sim_queuecommand;
+	t->can_queue    = can_queue;
+	t->max_sectors  = 128;
+
+	host = scsi_host_alloc(t, sizeof(struct sim_host));
+	sim  = (struct sim_host *)host->hostdata;
+	atomic_set(&sim->in_flight, 0);
+	sim->delay = delay;
+	sim->luns  = luns;
+
+	sim_first = -1;
+	sim_found = 0;
+	scsi_scan_host(host);
+
+	if (sim_first < 0)
+		printk("could not add simulated device\n");
+
+	return sim_first;
+}
+
+
+/**
+ * Attach simulated device with queue depth 2^i
+ *
+ * \return device index
+ */
+static int sim_device(int i)
+{
+	static int sim_dev[SIM_HOSTS] = { -1, -1, -1, -1 };
+
+	if (sim_dev[i] < 0)
+		sim_dev[i] = sim_create_host(&sim_template[i], 1 << i, SIM_DELAY, 1);
+
+	return sim_dev[i];
+}
+
+
+static atomic_t          sim_completed;
+static struct completion sim_batch_done;
+
+static void sim_request_done(void *priv, int error)
+{
+	if (error)
+		printk("request %p failed (%d)\n", priv, error);
+
+	if (atomic_inc_return(&sim_completed) == SIM_REQUESTS)
+		complete(&sim_batch_done);
+}
+
+
+static void block_queue_test(void)
+{
+	static char buffer[512];
+	int i;
+
+	printk("BEGIN BLOCK QUEUE TEST\n");
+
+	for (i = 0; i < SIM_HOSTS; i++) {
+		int index = sim_device(i);
+		unsigned long start, elapsed;
+		int r;
+
+		if (index < 0)
+			break;
+
+		atomic_set(&sim_completed, 0);
+		init_completion(&sim_batch_done);
+
+		start = jiffies;
+		for (r = 0; r < SIM_REQUESTS; r++)
+			dde_linux26_block_submit(index, r, 1, buffer, 0,
+			                         sim_request_done, (void *)r);
+
+		wait_for_completion(&sim_batch_done);
+		elapsed = max(1UL, jiffies - start);
+
+		printk("queue depth %2d: %d requests in %lu ms -> %lu IOPS\n",
+		       sim_template[i].can_queue, SIM_REQUESTS,
+		       elapsed * 1000 / HZ, SIM_REQUESTS * HZ / elapsed);
+	}
+
+	printk("END BLOCK QUEUE TEST\n");
+}
+
+
+/*****************************************
+ ** Test 11: Block cache (trace replay) **
+ *****************************************/
+
+/*
+ * The trace resembles a FAT client reading a file: small sequential reads
+ * of file data, interleaved with FAT lookups and directory updates.
+ */
+
+enum {
+	TRACE_FAT_START  = 32,
+	TRACE_DIR_START  = 64,
+	TRACE_DATA_START = 1024,
+	TRACE_DATA_SIZE  = 1024,  /* blocks */
+	TRACE_CHUNK      = 2,     /* blocks per data read */
+};
+
+static int trace_replay(int index, int cached)
+{
+	static char buffer[TRACE_CHUNK * 512];
+	unsigned long b;
+	int ret = 0;
+
+	for (b = 0; b < TRACE_DATA_SIZE && !ret; b += TRACE_CHUNK) {
+
+		/* FAT lookup for every cluster of 8 blocks */
+		if (b % 8 == 0)
+			ret = cached
+			    ? dde_linux26_block_cache_read(index, TRACE_FAT_START + b / 1024, 1, buffer)
+			    : dde_linux26_block_read_range(index, TRACE_FAT_START + b / 1024, 1, buffer);
+
+		/* file data */
+		if (!ret)
+			ret = cached
+			    ? dde_linux26_block_cache_read(index, TRACE_DATA_START + b, TRACE_CHUNK, buffer)
+			    : dde_linux26_block_read_range(index, TRACE_DATA_START + b, TRACE_CHUNK, buffer);
+
+		/* access-time update of the directory entry */
+		if (!ret && b % 64 == 0)
+			ret = cached
+			    ? dde_linux26_block_cache_write(index, TRACE_DIR_START, 1, buffer)
+			    : dde_linux26_block_write_range(index, TRACE_DIR_START, 1, buffer);
+	}
+
+	if (!ret && cached)
+		ret = dde_linux26_block_cache_flush(index);
+
+	return ret;
+}
+
+
+static void block_cache_test(void)
+{
+	struct dde_linux26_block_cache_stats stats;
+	int index = sim_device(0);
+	unsigned long start, elapsed[2];
+	int cached;
+
+	printk("BEGIN BLOCK CACHE TEST\n");
+
+	if (index < 0)
+		return;
+
+	for (cached = 0; cached < 2; cached++) {
+		int ret;
+
+		if (cached)
+			dde_linux26_block_cache_init(index, 1024*1024, 128);
+
+		start = jiffies;
+		ret = trace_replay(index, cached);
+		elapsed[cached] = jiffies - start;
+
+		printk("%s: trace replayed in %lu ms (%d)\n",
+		       cached ? "cached" : "uncached",
+		       elapsed[cached] * 1000 / HZ, ret);
+
+		if (ret) {
+			printk("FAILED: %s trace replay returned %d\n",
+			       cached ? "cached" : "uncached", ret);
+			return;
+		}
+	}
+
+	dde_linux26_block_cache_stats(index, &stats);
+	printk("%lu hits, %lu misses, %lu blocks read ahead, %lu writes, %lu write-backs\n",
+	       stats.hits, stats.misses, stats.readahead, stats.writes, stats.writebacks);
+
+	if (elapsed[1] >= elapsed[0])
+		printk("FAILED: cached replay not faster than uncached\n");
+	else if (!stats.hits)
+		printk("FAILED: no cache hits\n");
+
+	printk("END BLOCK CACHE TEST\n");
+}
+
+
+/**********************************************
+ ** Test 12: Parallel multi-LUN block access **
+ **********************************************/
+
+/*
+ * A slow card reader with two LUNs and a fast stick are accessed by one
+ * thread per device. The stick must not be stalled by the card reader, and
+ * both LUNs of the card reader must be detected. The LUNs of the card reader
+ * share a queue depth of one and must make progress concurrently, i.e., each
+ * LUN completes half of its reads before the other LUN is done.
+ */
+
+enum {
+	LUN_READER_DELAY = 10,  /* jiffies */
+	LUN_STICK_DELAY  = 1,
+	LUN_REQUESTS     = 20,
+	LUN_DEVICES      = 3,
+};
+
+static struct scsi_host_template lun_template[2];
+static int                       lun_devices[LUN_DEVICES];
+static unsigned long             lun_elapsed[LUN_DEVICES];
+static unsigned long             lun_half[LUN_DEVICES];  /* jiffies */
+static unsigned long             lun_end[LUN_DEVICES];   /* jiffies */
+static struct completion         lun_done[LUN_DEVICES];
+
+
+static int lun_thread(void *arg)
+{
+	static char buffer[LUN_DEVICES][512];
+	int i = (int)arg;
+	unsigned long start = jiffies;
+	int r;
+
+	for (r = 0; r < LUN_REQUESTS; r++) {
+		dde_linux26_block_read(lun_devices[i], r, buffer[i]);
+
+		if (r == LUN_REQUESTS / 2 - 1)
+			lun_half[i] = jiffies;
+	}
+
+	lun_end[i]     = jiffies;
+	lun_elapsed[i] = lun_end[i] - start;
+	complete_and_exit(&lun_done[i], 0);
+	return 0;
+}
+
+
+static void block_lun_test(void)
+{
+	unsigned long stick_expected = LUN_REQUESTS * LUN_STICK_DELAY;
+	int i;
+
+	printk("BEGIN BLOCK LUN TEST\n");
+
+	lun_devices[0] = sim_create_host(&lun_template[0], 1, LUN_READER_DELAY, 2);
+	lun_devices[1] = lun_devices[0] + 1;
+	if (sim_found != 2) {
+		printk("FAILED: found %d LUNs of card reader, expected 2\n", sim_found);
+		return;
+	}
+
+	lun_devices[2] = sim_create_host(&lun_template[1], 1, LUN_STICK_DELAY, 1);
+	if (lun_devices[2] < 0)
+		return;
+
+	for (i = 0; i < LUN_DEVICES; i++) {
+		init_completion(&lun_done[i]);
+		kernel_thread(lun_thread, (void *)i, 0);
+	}
+
+	for (i = 0; i < LUN_DEVICES; i++) {
+		wait_for_completion(&lun_done[i]);
+		printk("device %d (LUN %d): %d reads in %lu ms\n",
+		       lun_devices[i], dde_linux26_block_lun(lun_devices[i]),
+		       LUN_REQUESTS, lun_elapsed[i] * 1000 / HZ);
+	}
+
+	/* allow some scheduling slack but no serialization behind the reader */
+	if (lun_elapsed[LUN_DEVICES - 1] > 2 * stick_expected + HZ / 10)
+		printk("FAILED: stick stalled by card reader\n");
+	else
+		printk("stick ran in parallel to card reader\n");
+
+	/* a LUN starved by its sibling reaches half of its reads too late */
+	if (time_after_eq(lun_half[0], lun_end[1])
+	 || time_after_eq(lun_half[1], lun_end[0]))
+		printk("FAILED: card reader LUNs serialized\n");
+	else
+		printk("card reader LUNs ran concurrently\n");
+
+	printk("END BLOCK LUN TEST\n");
+}
+
+
+/**********************************
+ ** Test 13: Page lookup scaling **
+ **********************************/
+
+/*
+ * Churn order-0 pages through a live set of growing size and measure
+ * virt_to_page() throughput, which must not degrade with the live set.
+ */
+
+enum {
+	PAGE_LIVE_MAX    = 4096,
+	PAGE_CHURN       = 1000000,
+	PAGE_LOOKUPS     = 1000000,
+};
+
+static unsigned long page_live[PAGE_LIVE_MAX];
+
+
+static void page_lookup_test(void)
+{
+	unsigned long first_rate = 0;
+	unsigned      live, i;
+
+	printk("BEGIN PAGE LOOKUP TEST\n");
+
+	for (live = 16; live <= PAGE_LIVE_MAX; live *= 4) {
+		unsigned long start, elapsed, rate;
+		unsigned long n;
+
+		for (i = 0; i < live; i++)
+			page_live[i] = __get_free_page(GFP_KERNEL);
+
+		/* replace pages round-robin */
+		start = jiffies;
+		for (n = 0; n < PAGE_CHURN; n++) {
+			i = n % live;
+			free_page(page_live[i]);
+			page_live[i] = __get_free_page(GFP_KERNEL);
+		}
+		elapsed = max(1UL, jiffies - start);
+		printk("live %4u: %lu alloc/free pairs in %lu ms\n",
+		       live, (unsigned long)PAGE_CHURN, elapsed * 1000 / HZ);
+
+		start = jiffies;
+		for (n = 0; n < PAGE_LOOKUPS; n++) {
+			unsigned long va = page_live[(n * 7919) % live] + (n & (PAGE_SIZE - 1));
+			struct page  *p  = virt_to_page((void *)va);
+
+			if (!p || (unsigned long)p->virtual != (va & PAGE_MASK)) {
+				printk("FAILED: lookup of %lx returned %p\n", va, p);
+				return;
+			}
+		}
+		elapsed = max(1UL, jiffies - start);
+		rate    = PAGE_LOOKUPS * HZ / elapsed;
+		printk("live %4u: %lu lookups/s\n", live, rate);
+
+		for (i = 0; i < live; i++)
+			free_page(page_live[i]);
+
+		if (virt_to_page((void *)page_live[0]))
+			printk("FAILED: freed page still in page table\n");
+
+		if (!first_rate)
+			first_rate = rate;
+		else if (rate < first_rate / 2)
+			printk("FAILED: lookup rate dropped from %lu to %lu\n", first_rate, rate);
+	}
+
+	printk("END PAGE LOOKUP TEST\n");
+}
+
+
+/************************************************
+ ** Test 14: Network skb pool (loopback device) **
+ ************************************************/
+
+/*
+ * The loopback device hands every transmitted frame directly back to
+ * netif_rx(), so the benchmark measures the DDE network path only.
+ */
+
+enum {
+	NET_BENCH_PACKETS = 200000,
+	NET_BENCH_LEN     = 1514,
+};
+
+static struct net_device *net_bench_dev;
+static unsigned long      net_bench_received;
+
+
+static int net_bench_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	skb->protocol = eth_type_trans(skb, dev);
+	netif_rx(skb);
+	return 0;
+}
+
+
+static void net_bench_rx(unsigned if_index, const unsigned char *packet,
+                         unsigned packet_len)
+{
+	net_bench_received++;
+}
+
+
+/**
+ * Create and open loopback device
+ *
+ * \return interface index, or -1 on error
+ */
+static int net_bench_device(void)
+{
+	if (net_bench_dev)
+		return net_bench_dev->ifindex;
+
+	net_bench_dev = alloc_etherdev(0);
+	if (!net_bench_dev)
+		return -1;
+
+	net_bench_dev->hard_start_xmit = net_bench_xmit;
+	random_ether_addr(net_bench_dev->dev_addr);
+
+	if (register_netdev(net_bench_dev)) {
+		free_netdev(net_bench_dev);
+		net_bench_dev = NULL;
+		return -1;
+	}
+
+	dde_linux26_net_init();
+	return net_bench_dev->ifindex;
+}
+
+
+/**
+ * Wait until the softnet thread delivered all sent packets
+ */
+static void net_bench_wait(unsigned long sent)
+{
+	unsigned long timeout = jiffies + HZ;
+
+	while (net_bench_received < sent && time_before(jiffies, timeout))
+		msleep(1);
+}
+
+
+static void net_skb_pool_test(void)
+{
+	static unsigned char packet[NET_BENCH_LEN];
+	int if_index = net_bench_device();
+	int pool;
+
+	printk("BEGIN NET SKB POOL TEST\n");
+
+	if (if_index < 0) {
+		printk("FAILED: could not create loopback device\n");
+		return;
+	}
+
+	dde_linux26_net_register_rx_callback(net_bench_rx);
+	memset(packet, 0xff, ETH_ALEN);
+
+	for (pool = 0; pool <= 1; pool++) {
+		struct dde_linux26_net_skb_pool_stats before, after;
+		unsigned long start, elapsed, n, hits, misses;
+
+		dde_linux26_net_skb_pool_enable(pool);
+		dde_linux26_net_skb_pool_stats(&before);
+		net_bench_received = 0;
+
+		start = jiffies;
+		for (n = 0; n < NET_BENCH_PACKETS; n++)
+			dde_linux26_net_tx(if_index, packet, NET_BENCH_LEN);
+		net_bench_wait(n);
+		elapsed = max(1UL, jiffies - start);
+
+		dde_linux26_net_skb_pool_stats(&after);
+		hits   = after.hits - before.hits;
+		misses = after.misses - before.misses;
+
+		printk("pool %s: %lu packets in %lu ms -> %lu pps, hit rate %lu%%\n",
+		       pool ? "on " : "off", net_bench_received, elapsed * 1000 / HZ,
+		       net_bench_received * HZ / elapsed,
+		       hits + misses ? hits * 100 / (hits + misses) : 0);
+	}
+
+	dde_linux26_net_register_rx_callback(NULL);
+	printk("END NET SKB POOL TEST\n");
+}
+
+
+/*******************************************
+ ** Test 15: Network burst tx/rx (loopback) **
+ *******************************************/
+
+static void net_bench_rx_burst(unsigned if_index,
+                               const struct dde_linux26_net_iovec *iov,
+                               unsigned n)
+{
+	net_bench_received += n;
+}
+
+
+static void net_burst_test(void)
+{
+	static unsigned char packet[NET_BENCH_LEN];
+	static struct dde_linux26_net_iovec iov[DDE_LINUX26_NET_BURST_MAX];
+	int if_index = net_bench_device();
+	unsigned burst, i;
+
+	printk("BEGIN NET BURST TEST\n");
+
+	if (if_index < 0) {
+		printk("FAILED: could not create loopback device\n");
+		return;
+	}
+
+	memset(packet, 0xff, ETH_ALEN);
+	for (i = 0; i < DDE_LINUX26_NET_BURST_MAX; i++) {
+		iov[i].packet     = packet;
+		iov[i].packet_len = NET_BENCH_LEN;
+	}
+
+	dde_linux26_net_skb_pool_enable(1);
+
+	for (burst = 1; burst <= DDE_LINUX26_NET_BURST_MAX; burst *= 2) {
+		unsigned long start, elapsed, sent = 0;
+
+		if (burst == 1) {
+			dde_linux26_net_register_rx_burst_callback(NULL);
+			dde_linux26_net_register_rx_callback(net_bench_rx);
+		} else
+			dde_linux26_net_register_rx_burst_callback(net_bench_rx_burst);
+
+		net_bench_received = 0;
+
+		start = jiffies;
+		if (burst == 1)
+			for (; sent < NET_BENCH_PACKETS; sent++)
+				dde_linux26_net_tx(if_index, packet, NET_BENCH_LEN);
+		else
+			while (sent < NET_BENCH_PACKETS) {
+				int n = dde_linux26_net_tx_burst(if_index, iov, burst);
+				if (n <= 0) break;
+				sent += n;
+			}
+
+		net_bench_wait(sent);
+		elapsed = max(1UL, jiffies - start);
+
+		printk("burst %2u: %lu/%lu packets in %lu ms -> %lu pps\n",
+		       burst, net_bench_received, sent, elapsed * 1000 / HZ,
+		       net_bench_received * HZ / elapsed);
+	}
+
+	dde_linux26_net_register_rx_burst_callback(NULL);
+	dde_linux26_net_register_rx_callback(NULL);
+	printk("END NET BURST TEST\n");
+}
+
+
+/****************************************
+ ** Test 16: Softnet budget under load **
+ ****************************************/
+
+/*
+ * The sender floods the loopback device while the softnet thread polls the
+ * device backlog with different budgets. Packets exceeding the backlog are
+ * dropped and counted.
+ */
+static void net_softnet_test(void)
+{
+	static unsigned char packet[NET_BENCH_LEN];
+	static const int budgets[] = { 8, 64, 300 };
+	int if_index = net_bench_device();
+	unsigned i;
+
+	printk("BEGIN NET SOFTNET TEST\n");
+
+	if (if_index < 0) {
+		printk("FAILED: could not create loopback device\n");
+		return;
+	}
+
+	dde_linux26_net_register_rx_callback(net_bench_rx);
+	memset(packet, 0xff, ETH_ALEN);
+
+	for (i = 0; i < ARRAY_SIZE(budgets); i++) {
+		struct dde_linux26_net_softnet_stats before, after;
+		unsigned long start, elapsed, n, timeout;
+
+		dde_linux26_net_set_budget(budgets[i]);
+		dde_linux26_net_set_weight(if_index, min(budgets[i], 64));
+		dde_linux26_net_softnet_stats(&before);
+		net_bench_received = 0;
+
+		start = jiffies;
+		for (n = 0; n < NET_BENCH_PACKETS; n++)
+			dde_linux26_net_tx(if_index, packet, NET_BENCH_LEN);
+		elapsed = max(1UL, jiffies - start);
+
+		/* wait until all packets were received or dropped */
+		timeout = jiffies + HZ;
+		do {
+			msleep(1);
+			dde_linux26_net_softnet_stats(&after);
+		} while (net_bench_received + after.dropped - before.dropped < n
+		         && time_before(jiffies, timeout));
+
+		printk("budget %3d: sent %lu pps, received %lu, dropped %lu, "
+		       "%lu polls (%lu squeezed) in %lu us\n",
+		       budgets[i], n * HZ / elapsed, net_bench_received,
+		       after.dropped - before.dropped,
+		       after.polls - before.polls,
+		       after.squeezed - before.squeezed,
+		       after.poll_us - before.poll_us);
+	}
+
+	dde_linux26_net_set_budget(300);
+	dde_linux26_net_set_weight(if_index, 64);
+	dde_linux26_net_register_rx_callback(NULL);
+	printk("END NET SOFTNET TEST\n");
+}
+
+
+/**********************************
+ ** Test 17: Spinlock contention **
+ *********************************/
+
+/*
+ * 1..SPIN_BENCH_THREADS threads increment a shared counter in a short
+ * critical section. The benchmark compares the former mappings of
+ * spinlock_t (DDE kit lock and DDE kit spin lock) with the adaptive lock
+ * that spinlock_t maps to now. The final counter value checks mutual
+ * exclusion.
+ */
+
+enum {
+	SPIN_BENCH_THREADS = 8,
+	SPIN_BENCH_ROUNDS  = 100000,
+};
+
+static struct dde_kit_lock *spin_bench_kit_lock;
+static dde_kit_spin_lock    spin_bench_kit_spin_lock;
+static DEFINE_SPINLOCK(spin_bench_lock);
+
+static void spin_bench_lock_kit(void)        { dde_kit_lock_lock(spin_bench_kit_lock); }
+static void spin_bench_unlock_kit(void)      { dde_kit_lock_unlock(spin_bench_kit_lock); }
+static void spin_bench_lock_kit_spin(void)   { dde_kit_spin_lock_lock(&spin_bench_kit_spin_lock); }
+static void spin_bench_unlock_kit_spin(void) { dde_kit_spin_lock_unlock(&spin_bench_kit_spin_lock); }
+static void spin_bench_lock_adaptive(void)   { spin_lock(&spin_bench_lock); }
+static void spin_bench_unlock_adaptive(void) { spin_unlock(&spin_bench_lock); }
+
+static struct spin_bench_variant
+{
+	const char *name;
+	void      (*lock)(void);
+	void      (*unlock)(void);
+} spin_bench_variants[] = {
+	{ "dde_kit_lock",      spin_bench_lock_kit,      spin_bench_unlock_kit },
+	{ "dde_kit_spin_lock", spin_bench_lock_kit_spin, spin_bench_unlock_kit_spin },
+	{ "spinlock_t",        spin_bench_lock_adaptive, spin_bench_unlock_adaptive },
+};
+
+static struct spin_bench_variant *spin_bench_variant;
+static volatile unsigned long     spin_bench_counter;
+static struct completion          spin_bench_done[SPIN_BENCH_THREADS];
+
+
+static int spin_bench_thread(void *arg)
+{
+	int id = (int)arg;
+	int r;
+
+	for (r = 0; r < SPIN_BENCH_ROUNDS; r++) {
+		spin_bench_variant->lock();
+		spin_bench_counter++;
+		spin_bench_variant->unlock();
+	}
+
+	complete_and_exit(&spin_bench_done[id], 0);
+}
+
+
+static void spinlock_test(void)
+{
+	unsigned v;
+	int threads, i;
+
+	printk("BEGIN SPINLOCK TEST\n");
+
+	dde_kit_lock_init(&spin_bench_kit_lock);
+	dde_kit_spin_lock_init(&spin_bench_kit_spin_lock);
+
+	for (v = 0; v < ARRAY_SIZE(spin_bench_variants); v++) {
+		spin_bench_variant = &spin_bench_variants[v];
+
+		for (threads = 1; threads <= SPIN_BENCH_THREADS; threads *= 2) {
+			unsigned long start, elapsed;
+			unsigned long ops = (unsigned long)SPIN_BENCH_ROUNDS * threads;
+
+			spin_bench_counter = 0;
+			start = jiffies;
+			for (i = 0; i < threads; i++) {
+				init_completion(&spin_bench_done[i]);
+				kernel_thread(spin_bench_thread, (void *)i, 0);
+			}
+			for (i = 0; i < threads; i++)
+				wait_for_completion(&spin_bench_done[i]);
+			elapsed = max(1UL, jiffies - start);
+
+			printk("%-17s %d thread(s): %lu ops in %lu ms -> %lu ops/s%s\n",
+			       spin_bench_variant->name, threads, ops,
+			       elapsed * 1000 / HZ, ops * HZ / elapsed,
+			       spin_bench_counter == ops ? "" : " FAILED: lost updates");
+		}
+	}
+
+	dde_kit_lock_deinit(spin_bench_kit_lock);
+	printk("END SPINLOCK TEST\n");
+}
+
+
+/***************************************
+ ** Test 18: Atomic operations stress **
+ **************************************/
+
+/*
+ * ATOMIC_STRESS_THREADS threads hammer shared counters and a shared bitmap
+ * with the lock-free operations of <dde_linux26/atomic.h>. Each thread
+ * owns every ATOMIC_STRESS_THREADS-th bit, so neighbouring bits in a word
+ * belong to other threads and a non-atomic read-modify-write would lose
+ * their updates.
+ */
+
+enum {
+	ATOMIC_STRESS_THREADS = 8,
+	ATOMIC_STRESS_ROUNDS  = 200000,
+	ATOMIC_STRESS_BITS    = 4 * DDE_LINUX26_BITS_PER_LONG,
+};
+
+static volatile int           atomic_stress_counter;
+static volatile int           atomic_stress_cmpxchg;
+static volatile unsigned long atomic_stress_bitmap[ATOMIC_STRESS_BITS / DDE_LINUX26_BITS_PER_LONG];
+static atomic_t               atomic_stress_errors;
+static struct completion      atomic_stress_done[ATOMIC_STRESS_THREADS];
+
+
+static int atomic_stress_thread(void *arg)
+{
+	int id = (int)arg;
+	int r;
+
+	for (r = 0; r < ATOMIC_STRESS_ROUNDS; r++) {
+		int bit = (id + r * ATOMIC_STRESS_THREADS) % ATOMIC_STRESS_BITS;
+		int old;
+
+		dde_linux26_atomic_add_return(2, &atomic_stress_counter);
+		dde_linux26_atomic_sub_return(1, &atomic_stress_counter);
+
+		do
+			old = dde_linux26_atomic_read(&atomic_stress_cmpxchg);
+		while (dde_linux26_atomic_cmpxchg(&atomic_stress_cmpxchg, old, old + 1) != old);
+
+		if (dde_linux26_test_and_set_bit(bit, atomic_stress_bitmap))
+			atomic_inc(&atomic_stress_errors);
+		dde_linux26_change_bit(bit, atomic_stress_bitmap);
+		dde_linux26_change_bit(bit, atomic_stress_bitmap);
+		if (!dde_linux26_test_and_clear_bit(bit, atomic_stress_bitmap))
+			atomic_inc(&atomic_stress_errors);
+	}
+
+	complete_and_exit(&atomic_stress_done[id], 0);
+}
+
+
+static void atomic_test(void)
+{
+	static unsigned long bitmap[2];
+	unsigned long expected = (unsigned long)ATOMIC_STRESS_THREADS * ATOMIC_STRESS_ROUNDS;
+	unsigned long start, elapsed;
+	int i, ok = 1;
+
+	printk("BEGIN ATOMIC TEST\n");
+
+	/* bit search */
+	bitmap[0] = ~0UL;
+	bitmap[1] = ~0UL ^ (1UL << 5);
+	ok &= dde_linux26_find_first_zero_bit(bitmap, 2 * BITS_PER_LONG) == BITS_PER_LONG + 5;
+	ok &= dde_linux26_find_first_zero_bit(bitmap, BITS_PER_LONG + 3) == BITS_PER_LONG + 3;
+	bitmap[0] = bitmap[1] = 0;
+	dde_linux26_set_bit(BITS_PER_LONG + 7, bitmap);
+	ok &= dde_linux26_find_first_bit(bitmap, 2 * BITS_PER_LONG) == BITS_PER_LONG + 7;
+	ok &= dde_linux26_test_bit(BITS_PER_LONG + 7, bitmap) && !dde_linux26_test_bit(7, bitmap);
+	ok &= dde_linux26_ffs(0) == 0 && dde_linux26_ffs(0x50) == 5;
+	printk("bit search: %s\n", ok ? "ok" : "FAILED");
+
+	/* stress */
+	atomic_stress_counter = atomic_stress_cmpxchg = 0;
+	atomic_set(&atomic_stress_errors, 0);
+
+	start = jiffies;
+	for (i = 0; i < ATOMIC_STRESS_THREADS; i++) {
+		init_completion(&atomic_stress_done[i]);
+		kernel_thread(atomic_stress_thread, (void *)i, 0);
+	}
+	for (i = 0; i < ATOMIC_STRESS_THREADS; i++)
+		wait_for_completion(&atomic_stress_done[i]);
+	elapsed = max(1UL, jiffies - start);
+
+	ok = atomic_stress_counter == expected
+	  && atomic_stress_cmpxchg == expected
+	  && !atomic_read(&atomic_stress_errors)
+	  && dde_linux26_find_first_bit((unsigned long *)atomic_stress_bitmap,
+	                                ATOMIC_STRESS_BITS) == ATOMIC_STRESS_BITS;
+
+	printk("%d threads x %d rounds in %lu ms: counter %d, cmpxchg %d, "
+	       "bit errors %d -> %s\n",
+	       ATOMIC_STRESS_THREADS, ATOMIC_STRESS_ROUNDS, elapsed * 1000 / HZ,
+	       atomic_stress_counter, atomic_stress_cmpxchg,
+	       atomic_read(&atomic_stress_errors), ok ? "ok" : "FAILED");
+
+	printk("END ATOMIC TEST\n");
+}
+
+
 /***********************
  ** Test main routine **
  ***********************/
@@ -435,10 +1606,20 @@ void test_main(void)
 	if (0) wq_test();
 	if (0) tasklet_test();
 	if (0) timer_test();
+	if (0) delay_test();
 	if (0) memory_test();
 	if (0) kthread_test();
 	if (0) work_queue_test();
 	if (1) pci_test();
+	if (0) block_queue_test();
+	if (0) block_cache_test();
+	if (0) block_lun_test();
+	if (0) page_lookup_test();
+	if (0) net_skb_pool_test();
+	if (0) net_burst_test();
+	if (0) net_softnet_test();
+	if (0) spinlock_test();
+	if (0) atomic_test();
 
 	printk("Tests finished.\n");
 }